@@ -0,0 +1,620 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* This solution uses a linked list                   *
+* to store the each states processes, except for the *
+* ready queue which is a heap ordered by absolute    *
+* deadline. They are scheduled Earliest Deadline     *
+* First with preemption.                             *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "minHeap.h"
+#include "burstPool.h"
+#include "simTime.h"
+
+// Macro to return the min of a and b
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+// Deadline of a process that did not give one, it only runs when nothing with a deadline is ready
+#define NO_DEADLINE SIM_TIME_MAX
+
+// An enumerator (enum for short) to represent the state
+enum STATE {
+    STATE_NEW,
+    STATE_READY,
+    STATE_RUNNING,
+    STATE_WAITING,
+    STATE_TERMINATED
+};
+static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATED"};
+
+// A structure containing all the relovant meta data for a process, this is the PCB like struct
+// The io_time_remaining is used in two ways:
+// it counts how long until the next io call and how long until a current io call is complete
+// The deadline is relative to the arrival time, abs_deadline is the time the process must be done by
+// A period (0 if the process is not periodic) is only used for the schedulability analysis
+struct process {
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time;
+    int cpu_time_remaining;
+    int io_frequency;
+    int io_duration;
+    int io_time_remaining;
+    // The sequences of the I/O Frequency and I/O Duration columns, burst counts the I/O done
+    struct burst_seq cpu_bursts;
+    struct burst_seq io_bursts;
+    int burst;
+    int deadline;
+    int period;
+    sim_time_t abs_deadline;
+    sim_time_t finish_time;
+    enum STATE s;
+};
+
+// This structure is a linked list of processes
+struct node {
+    struct process *p;
+    struct node *next;
+};
+
+// typedefs are a short hand to make the code more legible
+typedef struct process *proc_t;
+typedef struct node *node_t;
+
+/* FUNCTION DESCRIPTION: create_proc
+* This function creates a new process structure.
+* The parameters are self descriptive:
+*    -pid
+*    -arrival_time
+*    -total_cpu_time
+*    -io_frequency
+*    -io_duration
+*    -deadline, relative to the arrival, 0 when the process has none
+*    -period, 0 when the process is not periodic
+* The return value is a pointer to new process structure
+*/
+proc_t create_proc(sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration, int deadline, int period){
+    // Initialize memory
+    proc_t temp;
+    temp = (proc_t) malloc(sizeof(struct process));
+    assert(temp != NULL);
+
+    // Initialize contents
+    // A periodic process without an explicit deadline must finish within its period
+    temp->pid = pid;
+    temp->arrival_time = arrival_time;
+    temp->total_cpu_time = total_cpu_time;
+    temp->cpu_time_remaining = total_cpu_time;
+    temp->io_frequency = io_frequency;
+    temp->io_duration = io_duration;
+    temp->io_time_remaining = io_frequency;
+    temp->cpu_bursts.chunk = temp->io_bursts.chunk = NULL;
+    temp->cpu_bursts.count = temp->io_bursts.count = 1;
+    temp->burst = 0;
+    temp->period = period;
+    temp->deadline = (deadline == 0) ? period : deadline;
+    temp->abs_deadline = (temp->deadline > 0) ? arrival_time + temp->deadline : NO_DEADLINE;
+    temp->finish_time = -1;
+    temp->s = STATE_NEW;
+    return temp;
+}
+
+/* FUNCTION DESCRIPTION: create_node
+* This function creates a new  list node.
+* The parameters are:
+*    -p, a pointer to the process structure to be stored in this node
+* The return value is a pointer to the new node
+*/
+node_t create_node(proc_t p){
+    // Initialize memory
+    node_t temp;
+    temp = (node_t) malloc(sizeof(struct node));
+    assert(temp != NULL);
+
+    // Initialize contents
+    temp->next = NULL;
+    temp->p = p;
+
+    return temp;
+}
+
+/* FUNCTION DESCRIPTION: print_proc
+* Prints a single process, along with its time remaining, deadline and current state
+*/
+void print_proc(proc_t p){
+    printf("Process ID: %lld\n", p->pid);
+    printf("CPU Arrival Time: %lldms\n", p->arrival_time);
+    printf("Time Remaining: %dms of %dms\n", p->cpu_time_remaining, p->total_cpu_time);
+    printf("IO Duration: %dms\n", p->io_duration);
+    printf("IO Frequency: %dms\n", p->io_frequency);
+    if(p->abs_deadline == NO_DEADLINE){
+        printf("Deadline: none\n");
+    } else {
+        printf("Deadline: %lldms\n", p->abs_deadline);
+    }
+    printf("Current state: %s\n", STATES[p->s]);
+    printf("Time until next IO event: %dms\n", p->io_time_remaining);
+    printf("\n");
+}
+
+/* FUNCTION DESCRIPTION: print_nodes
+* Prints all the nodes in head, along with their time remaining and current states
+*/
+void print_nodes(node_t head) {
+    node_t current = head;
+
+    if(head == NULL){
+        printf("EMPTY\n");
+        return;
+    }
+
+    while (current != NULL) {
+        print_proc(current->p);
+        current = current->next;
+    }
+}
+
+/* FUNCTION DESCRIPTION: print_heap
+* Prints all the nodes in the ready heap. They are printed in heap order, only the first is the next to run.
+*/
+void print_heap(heap_t ready){
+    if(heap_empty(ready)){
+        printf("EMPTY\n");
+        return;
+    }
+
+    for(int i = 0; i < ready->size; i++){
+        print_proc(((node_t) ready->entries[i].item)->p);
+    }
+}
+
+/* FUNCTION DESCRIPTION: push_node
+* This function adds a node to the back of the list (as though its a queue).
+* The parameters are:
+*    -head points to the head in the list
+*    -temp is the node to be added
+* The return value is a pointer to the list
+*/
+node_t push_node(node_t head, node_t temp){
+    node_t prev;
+
+    // If the list is empty then we return a list with only the new node
+    if(head == NULL){
+        head = temp;
+    } else {
+        // The last node always points to NULL, so we get the next nodes until this happens
+        prev = head;
+
+        while(prev->next != NULL){
+            prev = prev->next;
+        }
+
+        prev->next = temp;
+    }
+    temp->next = NULL;
+    return head;
+}
+
+/* FUNCTION DESCRIPTION: remove_node
+* This function removes a node from within the linked list.
+* IT DOES NOT FREE THE MEMORY ALLOCATED FOR THE NODE.
+* The parameters are:
+*    -head points to the pointer that is the front of the list
+*    -to_be_removed points to the node that is to be removed
+* The return value is an int indicating success or failure
+*/
+int remove_node(node_t *head, node_t to_be_removed){
+    node_t temp, prev;
+    if(to_be_removed == *head){
+        *head = (*head)->next;
+        to_be_removed->next = NULL;
+        return 1;
+    } else {
+        temp = *head;
+        // Itterate through the list until we've checked every node
+        while(temp->next != NULL){
+            prev = temp;
+            temp = temp->next;
+            if(temp == to_be_removed){
+                prev->next = temp->next;
+                to_be_removed->next = NULL;
+                return 1;
+            }
+        }
+    }
+    return -1;
+}
+
+/* FUNCTION DESCRIPTION: next_token
+* Reads the next comma separated column of the row being tokenized, a duration from 0 to SIM_DURATION_MAX,
+* or gives the default value when the row has no more columns (optional columns)
+* The return value is 0, or -1 after printing why the column is not valid
+*/
+int next_token(const char *column, int default_value, int *value){
+    char *token = strtok(NULL, ",");
+    long long number;
+
+    *value = default_value;
+    if(token == NULL) return 0;
+    if(sim_parse_field(token, column, 0, SIM_DURATION_MAX, &number) != 0) return -1;
+    *value = (int) number;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: next_bursts
+* Returns the first burst of the next column of the row being tokenized, which holds one value
+* or a sequence of bursts that is stored in seq, or the default value when the row has no more columns
+*/
+int next_bursts(int default_value, struct burst_seq *seq){
+    char *token = strtok(NULL, ",");
+
+    seq->chunk = NULL;
+    seq->count = 1;
+    if(token == NULL) return default_value;
+    return burst_parse(token, seq);
+}
+
+/* FUNCTION DESCRIPTION: read_proc_from_file
+* Parse the CSV input file and load its contents into a list
+* The Deadline and Period columns are optional, a row without them has no deadline
+* The parameters are:
+*    -input_file, the name of the CSV file
+* The return value is a list of the new processes
+*/
+node_t read_proc_from_file(char *input_file){
+    char *row = NULL, *fields[3];
+    size_t size = 0;
+    node_t new_list=NULL, node;
+    proc_t proc;
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time, io_frequency, io_duration, deadline, period;
+    struct burst_seq cpu_bursts, io_bursts;
+
+    FILE* f = fopen(input_file, "r");
+    if(f == NULL){
+        // file not opened, fail gracefully
+        perror("Cannot open the input file");
+        return NULL;
+    }
+    // Get the first row, which has the header values
+    //Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration[,Deadline[,Period]]
+    // getline reads the rows whole, however long their burst sequences are
+    if(getline(&row, &size, f) == -1){
+        free(row);
+        fclose(f);
+        return NULL;
+    }
+    // Read the remainder of the rows until you get to the end of the file
+    while(getline(&row, &size, f) != -1){
+        // make sure it has at least enough char to be valid
+        if(strlen(row)<10) continue;
+        // The columns are range checked (see simTime.h), a row with one out of range is skipped
+        fields[0] = strtok(row, ",");
+        fields[1] = strtok(NULL, ",");
+        fields[2] = strtok(NULL, ",");
+        if(fields[2] == NULL || sim_parse_columns(fields, &pid, &arrival_time, &total_cpu_time) != 0) continue;
+        io_frequency = next_bursts(0, &cpu_bursts);
+        io_duration = next_bursts(0, &io_bursts);
+        if(sim_check_columns(pid, arrival_time, total_cpu_time, io_frequency, io_duration) != 0
+            || next_token("Deadline", 0, &deadline) != 0 || next_token("Period", 0, &period) != 0){
+            burst_free(&cpu_bursts);
+            burst_free(&io_bursts);
+            continue;
+        }
+
+        proc = create_proc(pid, arrival_time, total_cpu_time, io_frequency, io_duration, deadline, period);
+        proc->cpu_bursts = cpu_bursts;
+        proc->io_bursts = io_bursts;
+        node = create_node(proc);
+        new_list = push_node(new_list, node);
+    }
+
+    free(row);
+    fclose(f);
+    burst_pool_free();
+    return new_list;
+}
+
+/* FUNCTION DESCRIPTION: get_time_to_next_event
+* This function returns the amount of simulation time until the next event occurs
+* The parameters are:
+*    - cpu_clock: Time since the start of the simulation
+*    - running: The node containing the currently running process
+*    - new queue: The list of precess that have yet to arrive in the cpu
+*    - waiting_list: The list of processes that are waiting for io
+* The return value is the time until the next event
+*/
+sim_time_t get_time_to_next_event(sim_time_t cpu_clock, node_t running, node_t new_list, node_t waiting_list){
+    node_t temp;
+    sim_time_t next_exit=SIM_TIME_MAX, next_block=SIM_TIME_MAX, next_arrival=SIM_TIME_MAX, next_io=SIM_TIME_MAX;
+
+    if(running != NULL){
+        next_exit = running->p->cpu_time_remaining;
+        next_block = running->p->io_time_remaining;
+    }
+
+    // Search the new queue for the time until its next event
+    temp = new_list;
+    while(temp != NULL){
+        next_arrival = min(temp->p->arrival_time - cpu_clock, next_arrival);
+        temp = temp->next;
+    }
+
+    // Search the waiting queue for the time until its next event
+    temp = waiting_list;
+    while(temp != NULL){
+        next_io = min((sim_time_t) temp->p->io_time_remaining, next_io);
+        temp = temp->next;
+    }
+
+    sim_time_t min_time = min(min(next_exit, next_block), min(next_arrival, next_io));
+    return (min_time == 0) ? 1 : min_time;
+}
+
+/* FUNCTION DESCRIPTION: print_transition
+* Prints one state transition in the output format shared by all the simulators
+*/
+void print_transition(sim_time_t cpu_clock, proc_t p, enum STATE old_state, enum STATE new_state){
+    printf("%lld,%lld,%s,%s\n", cpu_clock, p->pid, STATES[old_state], STATES[new_state]);
+}
+
+/* FUNCTION DESCRIPTION: make_ready
+* Moves a node into the ready heap, keyed on its absolute deadline
+*/
+void make_ready(heap_t ready, node_t node){
+    node->p->s = STATE_READY;
+    heap_push(ready, node->p->abs_deadline, node);
+}
+
+/* FUNCTION DESCRIPTION: dispatch
+* Takes the process with the earliest deadline out of the ready heap and runs it
+* The return value is the new running node, or NULL if the CPU is idle
+*/
+node_t dispatch(sim_time_t cpu_clock, heap_t ready, int verbose){
+    node_t running = (node_t) heap_pop(ready);
+
+    if(running != NULL){
+        running->p->s = STATE_RUNNING;
+        print_transition(cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+    } else {
+        if(verbose) printf("%lld: CPU is idle\n", cpu_clock);
+    }
+    return running;
+}
+
+/* FUNCTION DESCRIPTION: compare_time
+* qsort comparator for the lateness values
+*/
+int compare_time(const void *a, const void *b){
+    sim_time_t x = *(const sim_time_t *) a, y = *(const sim_time_t *) b;
+    return (x > y) - (x < y);
+}
+
+/* FUNCTION DESCRIPTION: print_deadline_report
+* Prints the deadline misses, the lateness distribution and the schedulability of the run on stderr,
+* so the transitions on stdout keep the same format as the other simulators.
+* Lateness is the finish time minus the absolute deadline; it is negative when a process finished early.
+* The parameters are:
+*    - terminated: the list of all the processes once the simulation is done
+*    - cpu_clock: the time the simulation completed
+*/
+void print_deadline_report(node_t terminated, sim_time_t cpu_clock){
+    node_t temp;
+    int count = 0, misses = 0, i;
+    sim_time_t *lateness;
+    long long sum = 0;
+    double utilization = 0.0, density = 0.0;
+
+    for(temp = terminated; temp != NULL; temp = temp->next){
+        if(temp->p->abs_deadline != NO_DEADLINE) count++;
+        if(temp->p->period > 0){
+            // Liu and Layland utilization, and the density when a deadline is shorter than the period
+            utilization += (double) temp->p->total_cpu_time / temp->p->period;
+            density += (double) temp->p->total_cpu_time / min(temp->p->deadline, temp->p->period);
+        }
+    }
+
+    fprintf(stderr, "Deadline report after %lldms:\n", cpu_clock);
+    if(count == 0){
+        fprintf(stderr, "No process has a deadline\n");
+        return;
+    }
+
+    lateness = (sim_time_t *) malloc(count * sizeof(sim_time_t));
+    assert(lateness != NULL);
+    i = 0;
+    for(temp = terminated; temp != NULL; temp = temp->next){
+        if(temp->p->abs_deadline == NO_DEADLINE) continue;
+        lateness[i] = temp->p->finish_time - temp->p->abs_deadline;
+        if(lateness[i] > 0){
+            misses++;
+            fprintf(stderr, "PID %lld missed its deadline %lldms by %lldms\n", temp->p->pid, temp->p->abs_deadline, lateness[i]);
+        }
+        sum += lateness[i];
+        i++;
+    }
+    qsort(lateness, count, sizeof(sim_time_t), compare_time);
+
+    fprintf(stderr, "Deadline misses: %d of %d (%.1f%%)\n", misses, count, 100.0 * misses / count);
+    fprintf(stderr, "Lateness: min %lldms, mean %.1fms, p50 %lldms, p90 %lldms, p99 %lldms, max %lldms\n",
+        lateness[0], (double) sum / count, lateness[count / 2], lateness[(count * 9) / 10],
+        lateness[(count * 99) / 100], lateness[count - 1]);
+    if(utilization > 0.0){
+        fprintf(stderr, "Periodic utilization: %.3f (%s under EDF)\n", utilization,
+            (utilization <= 1.0) ? "schedulable" : "not schedulable");
+        fprintf(stderr, "Periodic density: %.3f (%s)\n", density,
+            (density <= 1.0) ? "sufficient for schedulability" : "schedulability not guaranteed");
+    }
+    fprintf(stderr, "Observed: %s\n", (misses == 0) ? "all deadlines met" : "deadlines missed");
+
+    free(lateness);
+}
+
+/* FUNCTION DESCRIPTION: clean_up
+* This function frees all the dynamically allocated heap memory
+* The parameters are:
+*    - list: the list of nodes to free
+*/
+void clean_up(node_t list){
+    node_t temp;
+    while(list != NULL){
+        temp = list;
+        list = list->next;
+        burst_free(&temp->p->cpu_bursts);
+        burst_free(&temp->p->io_bursts);
+        free(temp->p);
+        free(temp);
+    }
+}
+
+int main( int argc, char *argv[]) {
+    sim_time_t next_step = 0, cpu_clock = 0;
+    bool simulation_completed = false;
+    node_t new_list = NULL, waiting_list = NULL, terminated = NULL, temp, node;
+    node_t running = NULL;
+    heap_t ready;
+    char *input_file;
+    int verbose;
+
+    if(argc == 2){
+        input_file = argv[1];
+        verbose = 0;
+    } else if( argc == 3 ) {
+        input_file = argv[1];
+        verbose = atoi(argv[2]);
+    } else {
+        printf("Two or three args expected.\n");
+        return -1;
+    }
+
+    // Process meta data should be read from a text file
+    if(verbose) printf("------------------------------- Loading all processes -------------------------------\n");
+    new_list = read_proc_from_file(input_file);
+    if(verbose) print_nodes(new_list);
+    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(verbose) printf("Starting simulation...\n");
+
+    ready = heap_create(64);
+
+    // print the headers
+    printf("Time of transition,PID,Old State,New State\n");
+    // Simulation loop
+    do {
+        // Advance the cpu clock time
+        cpu_clock += next_step;
+        // Advance all the io timers for processes in waiting state
+        node = waiting_list;
+        while(node != NULL){
+            // The step ends at the earliest I/O completion at the latest, it fits in the int timer
+            node->p->io_time_remaining -= (int) next_step;
+            if(node->p->io_time_remaining <= 0){
+                // This process is ready, update the time of next io event to its next CPU burst
+                node->p->burst++;
+                node->p->io_time_remaining = burst_at(&node->p->cpu_bursts, node->p->burst, node->p->io_frequency);
+
+                temp = node->next;
+                remove_node(&waiting_list, node);
+                make_ready(ready, node);
+                print_transition(cpu_clock, node->p, STATE_WAITING, STATE_READY);
+
+                node = temp;
+            } else {
+                node = node->next;
+            }
+        }
+
+        // Check if any of the items in new queue should be moved to the ready queue
+        node = new_list;
+        while(node!= NULL) {
+            if(node->p->arrival_time == cpu_clock){
+                temp = node->next;
+                remove_node(&new_list, node);
+                make_ready(ready, node);
+                print_transition(cpu_clock, node->p, STATE_NEW, STATE_READY);
+
+                node = temp;
+            } else {
+                node = node->next;
+            }
+        }
+
+        // Make sure the CPU is running a process
+        if(running == NULL){
+            running = dispatch(cpu_clock, ready, verbose);
+        } else {
+            // Remove the time step from remaining time until process completetion and next io event
+            running->p->cpu_time_remaining -= (int) next_step;
+            running->p->io_time_remaining -= (int) next_step;
+
+            if(running->p->cpu_time_remaining <= 0){
+                // The process is finished running, terminate it
+                running->p->s = STATE_TERMINATED;
+                running->p->finish_time = cpu_clock;
+                terminated = push_node(terminated, running);
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_TERMINATED);
+
+                running = dispatch(cpu_clock, ready, verbose);
+            } else if(running->p->io_time_remaining <= 0){
+                // The process is blocked by io, update the timer and set state to waiting
+                running->p->io_time_remaining = burst_at(&running->p->io_bursts, running->p->burst, running->p->io_duration);
+                running->p->s = STATE_WAITING;
+                waiting_list = push_node(waiting_list, running);
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_WAITING);
+
+                running = dispatch(cpu_clock, ready, verbose);
+            } else if(!heap_empty(ready) && heap_peek_key(ready) < running->p->abs_deadline){
+                // A process with an earlier deadline became ready, it preempts the running one
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_READY);
+                make_ready(ready, running);
+
+                running = dispatch(cpu_clock, ready, verbose);
+            }
+        }
+
+        // Set the simulation time advance
+        next_step = get_time_to_next_event(cpu_clock, running, new_list, waiting_list);
+
+        if(verbose){
+            printf("-------------------------------------------------------------------------------------\n");
+            printf("At CPU time %lldms...\n", cpu_clock);
+            printf("-------------------------------\n");
+            printf("The CPU is currently running:\n");
+            print_nodes(running);
+            printf("-------------------------------\n");
+            printf("The new process list is:\n");
+            print_nodes(new_list);
+            printf("-------------------------------\n");
+            printf("The ready queue is:\n");
+            print_heap(ready);
+            printf("-------------------------------\n");
+            printf("The waiting list is:\n");
+            print_nodes(waiting_list);
+            printf("-------------------------------\n");
+            printf("The terminated list is:\n");
+            print_nodes(terminated);
+            printf("-------------------------------------------------------------------------------------\n");
+        }
+
+        // The simulation is completed when all the queues are empty, in otherwords, all programs have run to completion
+        simulation_completed = heap_empty(ready) && (new_list == NULL) && (waiting_list == NULL) && (running == NULL);
+    } while(!simulation_completed);
+    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(verbose) printf("Simulation completed in %lld ms.\n", cpu_clock);
+
+    print_deadline_report(terminated, cpu_clock);
+
+    // The simulation is done, all the nodes are in the terminated list, free them
+    heap_free(ready);
+    clean_up(terminated);
+    return 0;
+}
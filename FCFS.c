@@ -13,15 +13,27 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <unistd.h>
+#include "ioDevice.h"
+#include "switchCost.h"
+#include "traceExport.h"
+#include "workloadStream.h"
+#include "liveStats.h"
+#include "burstPool.h"
 
 typedef struct PCB {
-    int PID;               // a unique identifier for the process
-    int arrivalTime;       // in milliseconds
+    sim_pid_t PID;         // a unique identifier for the process, 64 bit like the times (see simTime.h)
+    sim_time_t arrivalTime; // in milliseconds
     int CPUTime;           // total time the process needs to complete in milliseconds (excluding I/O)
     int freq;              // the processes make a call to an event and wait with this frequency
     int duration;          // duration the process must wait before the event completion
     int remainingCPUTime;  // remaining time to complete CPU processing
-    int waitStartTime;     //time when the process enters the waiting queue
+    sim_time_t waitStartTime; //time when the process enters the waiting queue, it is done waiting at waitStartTime + duration
+    struct burst_seq cpuBursts; // the sequences of the I/O Frequency and I/O Duration columns, freq and duration are their first bursts
+    struct burst_seq ioBursts;
+    int burst;             // the number of I/O requests made so far
+    struct io_request io;  // the request of the process when it blocks on an I/O device
+    struct cache_state cache; // when and where the process last left the CPU
     struct PCB *next;
 } PCB;
 
@@ -49,6 +61,9 @@ queue_t *new_queue(void) {
 }
 
 void enqueue(queue_t *queue, PCB *pcb) {
+    // The PCB may still point to the node that followed it in the queue it came from
+    pcb->next = NULL;
+
     // If the queue is empty, add the PCB node at the front; else, add it to the end
     if (queue->front == NULL) {
         queue->front = pcb;
@@ -67,38 +82,71 @@ PCB *dequeue(queue_t *queue) {
     } else {
         PCB *temp = queue->front;
         queue->front = queue->front->next;
+        if (queue->front == NULL) {
+            queue->rear = NULL;
+        }
         queue->size -= 1;
+        temp->next = NULL;
         return temp;
     }
 }
 
 // for debugging to view transitions
-void printQueues(queue_t *ready, queue_t *waiting, queue_t *terminated) {
+void printQueues(queue_t *ready, heap_t waiting, queue_t *terminated) {
     printf("Ready Queue: ");
     PCB *current = ready->front;
     while (current != NULL) {
-        printf("PID %d, ", current->PID);
+        printf("PID %lld, ", current->PID);
         current = current->next;
     }
     printf("\n");
 
+    // The waiting queue is printed in heap order, only the first one is the next to complete
     printf("Waiting Queue: ");
-    current = waiting->front;
-    while (current != NULL) {
-        printf("PID %d, ", current->PID);
-        current = current->next;
+    for (int i = 0; i < waiting->size; i++) {
+        printf("PID %lld, ", ((PCB *)waiting->entries[i].item)->PID);
     }
     printf("\n");
 
     printf("Terminated Queue: ");
     current = terminated->front;
     while (current != NULL) {
-        printf("PID %d, ", current->PID);
+        printf("PID %lld, ", current->PID);
         current = current->next;
     }
     printf("\n");
 }
 
+// Sets up the PCB of a row of the input
+void fillPCB(PCB *pcb, const struct workload_row *row) {
+    pcb->PID = row->pid;
+    pcb->arrivalTime = row->arrival_time;
+    pcb->CPUTime = row->total_cpu_time;
+    pcb->freq = row->io_frequency;
+    pcb->duration = row->io_duration;
+    pcb->cpuBursts = row->cpu_bursts;
+    pcb->ioBursts = row->io_bursts;
+    pcb->burst = 0;
+    pcb->remainingCPUTime = pcb->CPUTime;
+    cache_state_init(&pcb->cache);
+    pcb->next = NULL;
+}
+
+// In streaming mode, create the PCB of a row when it arrives
+PCB *newPCB(const struct workload_row *row) {
+    PCB *pcb = (PCB *)malloc(sizeof(PCB));
+    assert(pcb != NULL);
+
+    fillPCB(pcb, row);
+    return pcb;
+}
+
+// Frees the burst sequences of a PCB, before the PCB itself
+void freeBursts(PCB *pcb) {
+    burst_free(&pcb->cpuBursts);
+    burst_free(&pcb->ioBursts);
+}
+
 // get input data from the input file and put it in an array of PCB structs
 int getData(char fileName[], PCB **processes) {
     FILE *csvFile;
@@ -144,30 +192,53 @@ int getData(char fileName[], PCB **processes) {
     //     processes[i]->remainingCPUTime = processes[i]->CPUTime;
     //     printf("process: %d, PID: %d\n", i, processes[i]->PID);
     // }
-    for (int i = 0; i < num_processes; i++) {
-        if (fscanf(csvFile, "%d, %d, %d, %d, %d", &(*processes)[i].PID, &(*processes)[i].arrivalTime, &(*processes)[i].CPUTime, &(*processes)[i].freq, &(*processes)[i].duration) != 5) {
-            perror("Error reading data from the file");
-            free(*processes);
-            fclose(csvFile);
-            return -1;
-        }
-        (*processes)[i].remainingCPUTime = (*processes)[i].CPUTime;
-        printf("process: %d, PID: %d\n", i, (*processes)[i].PID);
+    // The rows are read like the streaming input, the I/O columns can hold burst sequences
+    // Rows with a column out of range are skipped, so there can be fewer processes than lines
+    struct workload_row row;
+    int i = 0;
+    while (i < num_processes && stream_read_row(csvFile, 0, 1, &row) > 0) {
+        fillPCB(&(*processes)[i], &row);
+        printf("process: %d, PID: %lld\n", i, (*processes)[i].PID);
+        i++;
     }
 
     fclose(csvFile);
-    return num_processes;
+    burst_pool_free();
+    return i;
 }
 
-void outputTransition(FILE *outputFile, int clk, int PID, const char *oldState, const char *newState) {
-    fprintf(outputFile, "%d %d %s %s\n", clk, PID, oldState, newState);
+void outputTransition(FILE *outputFile, trace_t trace, sim_time_t clk, sim_pid_t PID, const char *oldState, const char *newState) {
+    fprintf(outputFile, "%lld %lld %s %s\n", clk, PID, oldState, newState);
+    // Add it to the trace when one is being written
+    if (trace != NULL) {
+        trace_transition(trace, clk, PID, 0, trace_state_from_name(oldState), trace_state_from_name(newState));
+    }
     // printf("%d %d %s %s\n", clk, PID, oldState, newState);
 }
 
-void kernelSim(PCB *processes, int num_processes, const char *outputFileName) {
-    int clk = 0;
+// Orders the PCBs by arrival time, then by their place in the input (the array they are in)
+int compareArrival(const void *a, const void *b) {
+    const PCB *p = *(const PCB **)a;
+    const PCB *q = *(const PCB **)b;
+
+    if (p->arrivalTime != q->arrivalTime) {
+        return (p->arrivalTime < q->arrivalTime) ? -1 : 1;
+    }
+    return (p < q) ? -1 : (p > q);
+}
+
+void kernelSim(PCB *processes, int num_processes, stream_t stream, const char *outputFileName, io_system_t devices, struct switch_model *costs, trace_t trace, live_t live) {
+    sim_time_t clk = 0;
+    // The number of processes that arrived and the ticks a process held the CPU, for the live statistics
+    int arrived = 0;
+    long long busyTime = 0;
+    // The process the CPU is switching to, it runs once the switch is done at switchDoneAt
+    PCB *switching = NULL;
+    sim_time_t switchDoneAt = 0;
     queue_t *ready = new_queue();
-    queue_t *waiting = new_queue();
+    // The waiting processes are kept in a heap on the time their I/O completes
+    heap_t waiting = heap_create(num_processes);
+    struct workload_row row;
     queue_t *terminated = new_queue();
 
     // printf("Ready size: %d", ready->size);
@@ -181,49 +252,117 @@ void kernelSim(PCB *processes, int num_processes, const char *outputFileName) {
 
     fprintf(outputFile, "Time PID OldState NewState\n");
 
-    while (terminated->size < num_processes) {
+    // The processes in order of arrival, so that a tick only looks at the next one to arrive
+    PCB **arrivalOrder = (PCB **)malloc((num_processes > 0 ? num_processes : 1) * sizeof(PCB *));
+    int nextArrival = 0;
+    assert(arrivalOrder != NULL);
+    for (int i = 0; i < num_processes; i++) {
+        arrivalOrder[i] = &processes[i];
+    }
+    qsort(arrivalOrder, num_processes, sizeof(PCB *), compareArrival);
+
+    // In streaming mode the simulation goes on until every row was read and every process it created terminated
+    while (terminated->size < num_processes || (stream != NULL && (!stream_done(stream) || stream->retired < stream->loaded))) {
         // Check for processes arriving at the current time and move them to the ready queue
-        for (int i = 0; i < num_processes; i++) {
-            if (processes[i].arrivalTime == clk) { 
-                outputTransition(outputFile, clk, processes[i].PID, "New", "Ready");
-                enqueue(ready, &processes[i]);
-            }
+        while (nextArrival < num_processes && arrivalOrder[nextArrival]->arrivalTime <= clk) {
+            PCB *pcb = arrivalOrder[nextArrival++];
+            outputTransition(outputFile, trace, clk, pcb->PID, "New", "Ready");
+            enqueue(ready, pcb);
+            arrived++;
+        }
+        // In streaming mode the PCB is created when the process arrives
+        while (stream_peek(stream) != NULL && stream_peek(stream)->arrival_time <= clk) {
+            stream_take(stream, &row);
+            PCB *pcb = newPCB(&row);
+            outputTransition(outputFile, trace, clk, pcb->PID, "New", "Ready");
+            enqueue(ready, pcb);
         }
 
-        // Execute the processes in the ready queue
-        PCB *currentProcess = dequeue(ready);
+        // Execute the processes in the ready queue, once the CPU is done switching to it
+        PCB *currentProcess = NULL;
+        if (switching != NULL) {
+            if (clk >= switchDoneAt) {
+                currentProcess = switching;
+                switching = NULL;
+            }
+        } else {
+            currentProcess = dequeue(ready);
+            if (currentProcess != NULL) {
+                outputTransition(outputFile, trace, clk, currentProcess->PID, "Ready", "Running");
+                int overhead = switch_dispatch(costs, &currentProcess->cache, currentProcess->PID, 0, clk);
+                if (overhead > 0) {
+                    // The process holds the CPU without making progress until the switch is done
+                    switching = currentProcess;
+                    switchDoneAt = clk + overhead;
+                    currentProcess = NULL;
+                }
+            }
+        }
         if (currentProcess != NULL) {
-            outputTransition(outputFile, clk, currentProcess->PID, "Ready", "Running");
-            if (currentProcess->remainingCPUTime <= currentProcess->freq) {
+            switch_leave(&currentProcess->cache, 0, clk);
+            // The CPU burst of the process, the same every time unless its I/O Frequency is a sequence
+            int cpuBurst = burst_at(&currentProcess->cpuBursts, currentProcess->burst, currentProcess->freq);
+            if (currentProcess->remainingCPUTime <= cpuBurst) {
                 // Process finishes its CPU burst
-                outputTransition(outputFile, clk /*+ currentProcess->remainingCPUTime*/, currentProcess->PID, "Running", "Terminated");
+                outputTransition(outputFile, trace, clk /*+ currentProcess->remainingCPUTime*/, currentProcess->PID, "Running", "Terminated");
                 currentProcess->remainingCPUTime = 0;
-                enqueue(terminated, currentProcess);
+                if (stream != NULL) {
+                    // Keep its metrics and free it, nothing refers to it anymore
+                    stream_retire(stream, currentProcess->PID, currentProcess->arrivalTime, clk);
+                    freeBursts(currentProcess);
+                    free(currentProcess);
+                } else {
+                    enqueue(terminated, currentProcess);
+                }
             } else {
                 // Process needs to perform I/O
-                outputTransition(outputFile, clk /*+ currentProcess->freq*/, currentProcess->PID, "Running", "Waiting");
+                outputTransition(outputFile, trace, clk /*+ currentProcess->freq*/, currentProcess->PID, "Running", "Waiting");
                 currentProcess->waitStartTime = clk;
-                currentProcess->remainingCPUTime -= currentProcess->freq;
+                currentProcess->remainingCPUTime -= cpuBurst;
                 // currentProcess->arrivalTime = clk + currentProcess->freq + currentProcess->duration;
-                enqueue(waiting, currentProcess);
+                int ioBurst = burst_at(&currentProcess->ioBursts, currentProcess->burst, currentProcess->duration);
+                currentProcess->burst++;
+                if (devices != NULL) {
+                    // The process waits for its I/O device instead of the waiting queue
+                    io_submit(devices, &currentProcess->io, currentProcess, currentProcess->PID, ioBurst, clk);
+                } else {
+                    heap_push(waiting, clk + ioBurst, currentProcess);
+                }
             }
         }
 
+        if (currentProcess != NULL || switching != NULL) busyTime++;
+        if (live_due(live)) {
+            PCB *onCPU = (switching != NULL) ? switching : currentProcess;
+            live_update(live, clk, (stream != NULL) ? stream->retired : terminated->size, busyTime, (onCPU != NULL) ? onCPU->PID : -1,
+                ready->size, waiting->size, io_outstanding(devices), (stream != NULL) ? !stream_done(stream) : num_processes - arrived);
+        }
+
+        // With nothing ready and the CPU free, the ticks until the next arrival or I/O completion do nothing
+        if (ready->size == 0 && switching == NULL) {
+            sim_time_t next = io_next_completion(devices);
+            if (!heap_empty(waiting) && heap_peek_key(waiting) < next) next = heap_peek_key(waiting);
+            if (nextArrival < num_processes && arrivalOrder[nextArrival]->arrivalTime < next) next = arrivalOrder[nextArrival]->arrivalTime;
+            if (stream_peek(stream) != NULL && stream_peek(stream)->arrival_time < next) next = stream_peek(stream)->arrival_time;
+            if (next != SIM_TIME_MAX && next > clk + 1) clk = next - 1;
+        }
+
         // Increment the simulation time (clk) and handle I/O completion
         clk++;
 
-        // Check for I/O completions
-        PCB *currentIOProcess = waiting->front;
-        while (currentIOProcess != NULL) {
-            if ((clk - currentIOProcess->waitStartTime) == currentIOProcess->duration){
-                outputTransition(outputFile, clk, currentIOProcess->PID, "Waiting", "Ready");
-                enqueue(ready, currentIOProcess);
-                currentIOProcess = dequeue(waiting);
+        // Check for I/O completions on the devices
+        void *completed;
+        while ((completed = io_complete(devices, clk)) != NULL) {
+            outputTransition(outputFile, trace, clk, ((PCB *)completed)->PID, "Waiting", "Ready");
+            enqueue(ready, (PCB *)completed);
+        }
 
-            } else {
-                break;
-            }
-            currentIOProcess = waiting->front;
+        // Check for I/O completions, every process whose I/O is done by now in O(log n) each.
+        // Processes completing at the same time become ready in the order they started waiting.
+        while (!heap_empty(waiting) && heap_peek_key(waiting) <= clk) {
+            PCB *currentIOProcess = (PCB *)heap_pop(waiting);
+            outputTransition(outputFile, trace, clk, currentIOProcess->PID, "Waiting", "Ready");
+            enqueue(ready, currentIOProcess);
         }
 
         // Print the state of queues for debugging and monitoring
@@ -231,30 +370,109 @@ void kernelSim(PCB *processes, int num_processes, const char *outputFileName) {
     }
 
     fclose(outputFile);
+    if (live != NULL) {
+        live_update(live, clk, (stream != NULL) ? stream->retired : terminated->size, busyTime, -1, 0, 0, 0, 0);
+    }
+
+    stream_print_report(stream, stderr);
+    io_print_report(devices, clk, stderr);
+    switch_print_report(costs, "FCFS", clk, stderr);
 
     // Free the memory for the queues
+    free(arrivalOrder);
     free(ready);
-    free(waiting);
+    heap_free(waiting);
     free(terminated);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: %s <input_file.csv>\n", argv[0]);
+    io_system_t devices = NULL;
+    struct switch_model costs;
+    trace_t trace = NULL;
+    char *traceFileName = NULL;
+    live_t live = NULL;
+    char *liveName = NULL;
+    bool streaming = false, pipelined = false;
+    int opt;
+
+    // -d <devices.csv>: processes block on I/O devices with a limited concurrency
+    // -c <ms>: fixed cost of a context switch
+    // -w <penalty>,<decay>[,<migration>]: cache refill penalty of a process that was off the CPU
+    // -t <trace.json>: stream the transitions as a Chrome trace event file
+    // -s: read the input as the simulation goes and free the terminated processes, the input must be sorted by arrival time
+    // -P: like -s, with the input decoded on a parser thread
+    // -L <name>: publish the progress in the shared memory segment <name> for liveMonitor
+    switch_model_init(&costs);
+    while ((opt = getopt(argc, argv, "d:c:w:t:sPL:")) != -1) {
+        if (opt == 'd') {
+            devices = io_system_load(optarg);
+            if (devices == NULL) {
+                return 1;
+            }
+        } else if (opt == 'c') {
+            costs.switch_cost = atoi(optarg);
+        } else if (opt == 'w') {
+            if (switch_model_parse_cache(&costs, optarg) != 0) {
+                return 1;
+            }
+        } else if (opt == 't') {
+            traceFileName = optarg;
+        } else if (opt == 's') {
+            streaming = true;
+        } else if (opt == 'P') {
+            streaming = true;
+            pipelined = true;
+        } else if (opt == 'L') {
+            liveName = optarg;
+        } else {
+            printf("Usage: %s [-d devices.csv] [-c switch_ms] [-w penalty,decay[,migration]] [-t trace.json] [-s|-P] [-L shm_name] <input_file.csv>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 1) {
+        printf("Usage: %s [-d devices.csv] [-c switch_ms] [-w penalty,decay[,migration]] [-t trace.json] [-s|-P] [-L shm_name] <input_file.csv>\n", argv[0]);
         return 1;
     }
 
-    char *inputFileName = argv[1];
+    // The devices are known once all the options are parsed
+    if (traceFileName != NULL) {
+        trace = trace_open(traceFileName, 1, devices);
+        if (trace == NULL) {
+            return 1;
+        }
+    }
+    if (liveName != NULL) {
+        live = live_open(liveName, "fcfs");
+        if (live == NULL) {
+            return 1;
+        }
+    }
+
+    char *inputFileName = argv[optind];
     PCB *processes = NULL;
 
-    int num_processes = getData(inputFileName, &processes);
-    if (num_processes > 0) {
-        // Generate an output file name based on the input file name
-        char outputFileName[200];
-        snprintf(outputFileName, sizeof(outputFileName), "output_%s.txt", inputFileName);
+    // Generate an output file name based on the input file name
+    char outputFileName[200];
+    snprintf(outputFileName, sizeof(outputFileName), "output_%s.txt", inputFileName);
 
-        kernelSim(processes, num_processes, outputFileName);
+    if (streaming) {
+        stream_t stream = stream_open(inputFileName, pipelined);
+        if (stream != NULL) {
+            kernelSim(NULL, 0, stream, outputFileName, devices, &costs, trace, live);
+            stream_close(stream);
+        }
+    } else {
+        int num_processes = getData(inputFileName, &processes);
+        if (num_processes > 0) {
+            kernelSim(processes, num_processes, NULL, outputFileName, devices, &costs, trace, live);
+        }
+        for (int i = 0; i < num_processes; i++) {
+            freeBursts(&processes[i]);
+        }
         free(processes);
     }
+    trace_close(trace);
+    live_close(live);
+    io_system_free(devices);
     return 0;
 }
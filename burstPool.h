@@ -0,0 +1,162 @@
+/*****************************************************
+* CPU and I/O burst sequences shared by simulators   *
+******************************************************
+* The I/O Frequency and I/O Duration columns take    *
+* either one value, the same for every burst, or a   *
+* sequence like 5;12;3: the CPU bursts between two   *
+* I/O requests and the durations of the requests, in *
+* order. A sequence shorter than the life of the     *
+* process repeats, and the process still terminates  *
+* once it used its Total CPU Time. Every sequence is *
+* stored in one pool of burst lengths shared by all  *
+* the processes, a process only keeps the offset and *
+* the length of its sequences and the number of      *
+* bursts it completed. One value is not stored.      *
+* The pool is a list of chunks filled in the order   *
+* the rows are parsed. A chunk counts the sequences  *
+* still alive in it and is freed once the last one   *
+* is, so as processes retire the memory follows the  *
+* processes that are alive. The counts are atomic:   *
+* the -P parser thread adds the sequences while the  *
+* simulation frees them.                             *
+******************************************************/
+
+#ifndef BURST_POOL_H
+#define BURST_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+#include <stdatomic.h>
+
+#define BURST_SEPARATOR ';'
+// Bursts per chunk, a longer sequence gets a chunk of its own
+#define BURST_CHUNK 4096
+
+// A chunk of the pool. refs is the number of sequences alive in it, plus one while the pool still appends to it.
+struct burst_chunk {
+    atomic_int refs;
+    int size;
+    int bursts[];
+};
+
+// A sequence of count bursts starting at offset in a chunk of the pool, chunk is NULL and count is 1 for a single value
+struct burst_seq {
+    struct burst_chunk *chunk;
+    int offset;
+    int count;
+};
+
+struct burst_pool {
+    // The chunk the sequences are appended to, and how much of it is used
+    struct burst_chunk *current;
+    int used;
+};
+
+// The pool of the simulator, the simulators are single programs and only one thread parses at a time
+static struct burst_pool burst_pool = { NULL, 0 };
+
+// Drops one reference to a chunk, the last one frees it
+static inline void burst_chunk_release(struct burst_chunk *chunk){
+    if(atomic_fetch_sub_explicit(&chunk->refs, 1, memory_order_acq_rel) == 1) free(chunk);
+}
+
+/* FUNCTION DESCRIPTION: burst_pool_reserve
+* Finds room for count bursts in the pool, starting a new chunk when the current one is full
+* The return value is the chunk, with the reference of the new sequence taken, and offset is set to where it starts
+*/
+static inline struct burst_chunk *burst_pool_reserve(int count, int *offset){
+    struct burst_chunk *chunk;
+    int size = (count > BURST_CHUNK) ? count : BURST_CHUNK;
+
+    if(burst_pool.current == NULL || burst_pool.used + count > burst_pool.current->size){
+        chunk = (struct burst_chunk *) malloc(sizeof(struct burst_chunk) + size * sizeof(int));
+        assert(chunk != NULL);
+        chunk->size = size;
+        atomic_init(&chunk->refs, 1);
+        // The pool gives up the previous chunk, it is freed with the last of its sequences
+        if(burst_pool.current != NULL) burst_chunk_release(burst_pool.current);
+        burst_pool.current = chunk;
+        burst_pool.used = 0;
+    }
+    chunk = burst_pool.current;
+    atomic_fetch_add_explicit(&chunk->refs, 1, memory_order_relaxed);
+    *offset = burst_pool.used;
+    burst_pool.used += count;
+    return chunk;
+}
+
+/* FUNCTION DESCRIPTION: burst_parse
+* Reads a column that holds one value or a sequence of bursts separated by ;
+* A sequence is added to the pool and the caller frees it with burst_free, its bursts must be positive
+* (the others count as 1ms)
+* Bursts longer than INT_MAX ms are cut to INT_MAX, the timers of the processes are 32 bit
+* The parameters are:
+*    -field, the text of the column
+*    -seq, set to the sequence
+* The return value is the first burst, which is the value of a column without a sequence
+*/
+static inline int burst_parse(const char *field, struct burst_seq *seq){
+    const char *c;
+    char *end;
+    long long length = strtoll(field, &end, 10);
+
+    seq->chunk = NULL;
+    seq->offset = 0;
+    seq->count = 1;
+    if(*end != BURST_SEPARATOR){
+        if(length > INT_MAX){
+            fprintf(stderr, "\"%.*s\" is longer than %dms, it lasts %dms\n", (int) (end - field), field, INT_MAX, INT_MAX);
+            length = INT_MAX;
+        }
+        return (int) length;
+    }
+
+    // One burst more than separators, the sequence ends at the first character that is not a number
+    for(c = end; *c == BURST_SEPARATOR; c++){
+        strtoll(c + 1, &end, 10);
+        seq->count++;
+        c = end - 1;
+    }
+    seq->chunk = burst_pool_reserve(seq->count, &seq->offset);
+    for(int i = 0; i < seq->count; i++){
+        length = strtoll(field, &end, 10);
+        if(length <= 0){
+            fprintf(stderr, "Burst %d of \"%s\" is not positive, it lasts 1ms\n", i + 1, field);
+            length = 1;
+        } else if(length > INT_MAX){
+            fprintf(stderr, "Burst %d of \"%s\" is longer than %dms, it lasts %dms\n", i + 1, field, INT_MAX, INT_MAX);
+            length = INT_MAX;
+        }
+        seq->chunk->bursts[seq->offset + i] = (int) length;
+        field = end + 1;
+    }
+    return seq->chunk->bursts[seq->offset];
+}
+
+/* FUNCTION DESCRIPTION: burst_at
+* The length of burst number k of a sequence, counted from 0 and repeating the sequence
+* value is the length of every burst of a sequence of one
+*/
+static inline int burst_at(const struct burst_seq *seq, int k, int value){
+    if(seq->count <= 1) return value;
+    return seq->chunk->bursts[seq->offset + k % seq->count];
+}
+
+// Frees a sequence when its process is freed, its chunk goes with its last sequence
+static inline void burst_free(struct burst_seq *seq){
+    if(seq->chunk != NULL) burst_chunk_release(seq->chunk);
+    seq->chunk = NULL;
+    seq->offset = 0;
+    seq->count = 1;
+}
+
+// Gives up the chunk the pool appends to, once the input is read
+static inline void burst_pool_free(void){
+    if(burst_pool.current != NULL) burst_chunk_release(burst_pool.current);
+    burst_pool.current = NULL;
+    burst_pool.used = 0;
+}
+
+#endif
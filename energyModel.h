@@ -0,0 +1,379 @@
+/*****************************************************
+* Energy and frequency scaling of the CPU            *
+******************************************************
+* The CPU runs at one of its frequency states, each  *
+* with the power it draws while busy. A process      *
+* makes progress in proportion to the frequency:     *
+* the CPU times of the input are ms at the highest   *
+* frequency, so at half of it a burst takes twice as *
+* long. A governor picks the frequency from the load *
+* of the last sampling period, like cpufreq:         *
+*    - performance: always the highest frequency     *
+*    - powersave: always the lowest                  *
+*    - ondemand: the highest above 80% of load,      *
+*      otherwise the lowest frequency that serves    *
+*      the load                                      *
+*    - conservative: one state up above 80% of load, *
+*      one state down below 20%                      *
+* While idle the CPU goes down its idle states: an   *
+* idle period starts in the first one and enters a   *
+* deeper state once it lasted its target residency.  *
+* The energy is the power of the current state times *
+* the time spent in it. The model has a table of     *
+* states per CPU, the simulators have one CPU.       *
+* Switching to a process runs at the current         *
+* frequency but its length does not scale.           *
+******************************************************/
+
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "simTime.h"
+
+#define ENERGY_MAX_STATES 16
+
+enum GOVERNOR {
+    GOVERNOR_PERFORMANCE,
+    GOVERNOR_POWERSAVE,
+    GOVERNOR_ONDEMAND,
+    GOVERNOR_CONSERVATIVE
+};
+static const char *GOVERNORS[] = { "performance", "powersave", "ondemand", "conservative" };
+
+// The load thresholds of the governors, in percent, and the default sampling period in ms
+#define GOVERNOR_UP_THRESHOLD 80
+#define GOVERNOR_DOWN_THRESHOLD 20
+#define GOVERNOR_SAMPLING 10
+
+// A frequency state (frequency > 0) or an idle state, with what the CPU spent in it
+struct power_state {
+    char name[16];
+    int frequency;
+    double power;
+    int residency;
+    // statistics
+    long long time;
+    long long entries;
+};
+
+struct energy_model {
+    // sorted by frequency, and the idle states by target residency
+    struct power_state freqs[ENERGY_MAX_STATES];
+    int freq_count;
+    struct power_state idles[ENERGY_MAX_STATES];
+    int idle_count;
+    int current;
+    enum GOVERNOR governor;
+    int sampling;
+    sim_time_t next_sample;
+    long long window_busy;
+    // The progress of the running process below 1ms, in MHz ms, and the process it belongs to
+    long long carry;
+    sim_pid_t carry_pid;
+    // When the current idle period started, -1 while busy
+    sim_time_t idle_since;
+    // statistics
+    double busy_energy;
+    double idle_energy;
+    long long changes;
+};
+
+typedef struct energy_model *energy_t;
+
+// The states used without a state file: a laptop CPU with four frequencies and three idle states
+static const struct power_state ENERGY_DEFAULT_STATES[] = {
+    { "P3", 800, 1.2, 0, 0, 0 }, { "P2", 1600, 3.5, 0, 0, 0 }, { "P1", 2400, 8.0, 0, 0, 0 }, { "P0", 3200, 15.0, 0, 0, 0 },
+    { "C1", 0, 1.0, 0, 0, 0 }, { "C3", 0, 0.4, 2, 0, 0 }, { "C6", 0, 0.05, 10, 0, 0 }
+};
+
+// Orders the frequency states by frequency and the idle states by target residency
+static inline int energy_compare_states(const void *a, const void *b){
+    const struct power_state *x = (const struct power_state *) a, *y = (const struct power_state *) b;
+
+    if(x->frequency != y->frequency) return (x->frequency > y->frequency) - (x->frequency < y->frequency);
+    return (x->residency > y->residency) - (x->residency < y->residency);
+}
+
+// Adds a state to the table it belongs to
+// The return value is 0, or -1 if the table is full
+static inline int energy_add_state(energy_t e, const struct power_state *state){
+    struct power_state *table = (state->frequency > 0) ? e->freqs : e->idles;
+    int *count = (state->frequency > 0) ? &e->freq_count : &e->idle_count;
+
+    if(*count == ENERGY_MAX_STATES){
+        fprintf(stderr, "At most %d frequency states and %d idle states\n", ENERGY_MAX_STATES, ENERGY_MAX_STATES);
+        return -1;
+    }
+    table[(*count)++] = *state;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: energy_parse_column
+* Reads a column of the state file: a number that is not negative, with nothing after it,
+* and a whole number up to INT_MAX when integer is set
+* The return value is 0, or -1 if the column is missing or is not such a number
+*/
+static inline int energy_parse_column(const char *field, int integer, double *value){
+    char *end;
+
+    if(field == NULL) return -1;
+    *value = strtod(field, &end);
+    while(*end == ' ' || *end == '\t') end++;
+    if(end == field || *end != '\0' || !(*value >= 0)) return -1;
+    if(integer && (*value > INT_MAX || *value != (double) (int) *value)) return -1;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: energy_open
+* Creates the energy model of the CPU
+* The parameters are:
+*    -state_file, the CSV of the states with one row per state: State,Frequency,Power,Residency
+*     where the frequency is in MHz (0 for an idle state), the power in W and the target residency of an
+*     idle state in ms. NULL for the default states.
+*    -governor, "<governor>[,<sampling_ms>]", NULL for performance
+* The return value is the model, or NULL if the file cannot be read, has a malformed row, has no frequency state
+* or the governor is unknown
+*/
+static inline energy_t energy_open(const char *state_file, const char *governor){
+    char row[128], name[32], *field;
+    struct power_state state;
+    energy_t e;
+    int found = 0, sampling = GOVERNOR_SAMPLING, ok = 1, line = 1;
+    double frequency, power, residency;
+    FILE *f;
+
+    e = (energy_t) calloc(1, sizeof(struct energy_model));
+    assert(e != NULL);
+    e->governor = GOVERNOR_PERFORMANCE;
+    if(governor != NULL){
+        if(sscanf(governor, "%31[^,],%d", name, &sampling) < 1 || sampling <= 0) name[0] = '\0';
+        for(int i = GOVERNOR_PERFORMANCE; i <= GOVERNOR_CONSERVATIVE; i++){
+            if(strcmp(name, GOVERNORS[i]) == 0){
+                e->governor = (enum GOVERNOR) i;
+                found = 1;
+            }
+        }
+        if(!found){
+            fprintf(stderr, "Expected performance|powersave|ondemand|conservative[,<sampling_ms>] for the governor, got %s\n", governor);
+            free(e);
+            return NULL;
+        }
+    }
+    e->sampling = sampling;
+
+    if(state_file == NULL){
+        for(size_t i = 0; i < sizeof(ENERGY_DEFAULT_STATES) / sizeof(ENERGY_DEFAULT_STATES[0]); i++){
+            energy_add_state(e, &ENERGY_DEFAULT_STATES[i]);
+        }
+    } else {
+        f = fopen(state_file, "r");
+        if(f == NULL){
+            perror("Cannot open the state file");
+            free(e);
+            return NULL;
+        }
+        //State,Frequency,Power,Residency
+        fgets(row, sizeof(row), f);
+        while(ok && fgets(row, sizeof(row), f) != NULL){
+            line++;
+            field = strtok(row, ",\r\n");
+            if(field == NULL) continue;
+            memset(&state, 0, sizeof(state));
+            snprintf(state.name, sizeof(state.name), "%s", field);
+            // The frequency and the power are needed, the residency is optional, 0 when it is missing
+            ok = energy_parse_column(strtok(NULL, ",\r\n"), 1, &frequency) == 0 &&
+                energy_parse_column(strtok(NULL, ",\r\n"), 0, &power) == 0;
+            field = strtok(NULL, ",\r\n");
+            residency = 0;
+            if(ok && field != NULL) ok = energy_parse_column(field, 1, &residency) == 0;
+            if(!ok){
+                fprintf(stderr, "Line %d of %s is not State,Frequency,Power[,Residency] with numbers that are not negative\n",
+                    line, state_file);
+                break;
+            }
+            state.frequency = (int) frequency;
+            state.power = power;
+            state.residency = (int) residency;
+            ok = energy_add_state(e, &state) == 0;
+        }
+        fclose(f);
+        if(!ok || e->freq_count == 0){
+            if(ok) fprintf(stderr, "The state file has no frequency state\n");
+            free(e);
+            return NULL;
+        }
+    }
+    qsort(e->freqs, e->freq_count, sizeof(struct power_state), energy_compare_states);
+    qsort(e->idles, e->idle_count, sizeof(struct power_state), energy_compare_states);
+    // An idle period starts in the first idle state, whatever its residency
+    if(e->idle_count > 0) e->idles[0].residency = 0;
+
+    e->current = (e->governor == GOVERNOR_POWERSAVE) ? 0 : e->freq_count - 1;
+    e->next_sample = (e->governor >= GOVERNOR_ONDEMAND) ? e->sampling : SIM_TIME_MAX;
+    e->carry_pid = -1;
+    e->idle_since = -1;
+    return e;
+}
+
+/* FUNCTION DESCRIPTION: energy_progress
+* Converts the time a process ran into the progress it made, in ms at the highest frequency
+* The parameters are:
+*    -e, the model, NULL when the CPU always runs at full speed
+*    -pid, the running process, what it made below 1ms is kept for it
+*    -time, how long it ran, without the switch to it
+* The return value is the progress in ms
+*/
+static inline sim_time_t energy_progress(energy_t e, sim_pid_t pid, sim_time_t time){
+    long long work, top;
+
+    if(e == NULL) return time;
+    if(e->current == e->freq_count - 1){
+        e->carry = 0;
+        return time;
+    }
+    top = e->freqs[e->freq_count - 1].frequency;
+    if(pid != e->carry_pid) e->carry = 0;
+    e->carry_pid = pid;
+    work = e->carry + time * e->freqs[e->current].frequency;
+    e->carry = work % top;
+    return work / top;
+}
+
+/* FUNCTION DESCRIPTION: energy_time_for
+* Computes how long the running process needs to make some progress at the current frequency
+* The parameters are:
+*    -e, the model, NULL when the CPU always runs at full speed
+*    -pid, the running process
+*    -progress, the progress in ms at the highest frequency
+* The return value is the time in ms, rounded up
+*/
+static inline sim_time_t energy_time_for(energy_t e, sim_pid_t pid, int progress){
+    long long work, frequency;
+
+    if(e == NULL || e->current == e->freq_count - 1 || progress <= 0) return progress;
+    frequency = e->freqs[e->current].frequency;
+    work = (long long) progress * e->freqs[e->freq_count - 1].frequency - ((pid == e->carry_pid) ? e->carry : 0);
+    return (work <= 0) ? 1 : (work + frequency - 1) / frequency;
+}
+
+/* FUNCTION DESCRIPTION: energy_idle
+* Marks that the CPU is idle, an idle period starts unless one is going on
+*/
+static inline void energy_idle(energy_t e, sim_time_t now){
+    if(e != NULL && e->idle_since < 0) e->idle_since = now;
+}
+
+/* FUNCTION DESCRIPTION: energy_account
+* Adds the energy of the next time step, during which the CPU stays busy or idle in its current state
+* The parameters are:
+*    -e, the model, may be NULL
+*    -now, the start of the step
+*    -step, its length in ms
+*    -busy, whether a process holds the CPU
+*/
+static inline void energy_account(energy_t e, sim_time_t now, sim_time_t step, int busy){
+    sim_time_t start, end, from, to;
+    struct power_state *s;
+
+    if(e == NULL || step <= 0 || step == SIM_TIME_MAX) return;
+    if(busy){
+        s = &e->freqs[e->current];
+        s->time += step;
+        e->busy_energy += s->power * step / 1000.0;
+        e->window_busy += step;
+        e->idle_since = -1;
+        return;
+    }
+
+    // Splits the step over the idle states by how long the idle period lasted so far
+    if(e->idle_since < 0) e->idle_since = now;
+    start = now - e->idle_since;
+    end = start + step;
+    for(int i = 0; i < e->idle_count; i++){
+        s = &e->idles[i];
+        from = (start > s->residency) ? start : s->residency;
+        to = (i + 1 < e->idle_count && e->idles[i + 1].residency < end) ? e->idles[i + 1].residency : end;
+        if(to <= from) continue;
+        if(from == s->residency) s->entries++;
+        s->time += to - from;
+        e->idle_energy += s->power * (to - from) / 1000.0;
+    }
+}
+
+/* FUNCTION DESCRIPTION: energy_govern
+* Lets the governor pick the frequency once a sampling period is over, from the load of the period
+* The parameters are:
+*    -e, the model, may be NULL
+*    -now, the current time
+*/
+static inline void energy_govern(energy_t e, sim_time_t now){
+    long long load, wanted;
+    int next;
+
+    if(e == NULL || now < e->next_sample) return;
+    load = 100 * e->window_busy / (e->sampling + now - e->next_sample);
+    next = e->current;
+    if(e->governor == GOVERNOR_ONDEMAND){
+        next = e->freq_count - 1;
+        if(load < GOVERNOR_UP_THRESHOLD){
+            // The lowest frequency that would have served the load of the period
+            wanted = load * e->freqs[e->current].frequency / 100;
+            for(next = 0; next < e->freq_count - 1 && e->freqs[next].frequency < wanted; next++);
+        }
+    } else if(e->governor == GOVERNOR_CONSERVATIVE){
+        if(load > GOVERNOR_UP_THRESHOLD && next < e->freq_count - 1) next++;
+        if(load < GOVERNOR_DOWN_THRESHOLD && next > 0) next--;
+    }
+    if(next != e->current){
+        e->current = next;
+        e->changes++;
+    }
+    e->window_busy = 0;
+    e->next_sample = now + e->sampling;
+}
+
+/* FUNCTION DESCRIPTION: energy_next_sample
+* The time until the governor samples the load again, SIM_TIME_MAX if it never changes the frequency
+*/
+static inline sim_time_t energy_next_sample(energy_t e, sim_time_t now){
+    return (e == NULL || e->next_sample == SIM_TIME_MAX) ? SIM_TIME_MAX : e->next_sample - now;
+}
+
+/* FUNCTION DESCRIPTION: energy_print_report
+* Prints the energy of the workload and the time spent in every state
+* The parameters are:
+*    -e, the model, nothing is printed if it is NULL
+*    -policy, the name of the scheduling policy
+*    -end_time, the time the simulation completed
+*    -processes, how many processes completed
+*    -out, where to print the report
+*/
+static inline void energy_print_report(energy_t e, const char *policy, sim_time_t end_time, long long processes, FILE *out){
+    double total;
+
+    if(e == NULL) return;
+    total = e->busy_energy + e->idle_energy;
+    fprintf(out, "%s energy with the %s governor: %.3fJ in %lldms (%.3fW on average), %.3fJ busy, %.3fJ idle, "
+        "%.4fJ per process, %lld frequency changes\n", policy, GOVERNORS[e->governor], total, end_time,
+        (end_time > 0) ? 1000.0 * total / end_time : 0.0, e->busy_energy, e->idle_energy,
+        (processes > 0) ? total / processes : 0.0, e->changes);
+    for(int i = e->freq_count - 1; i >= 0; i--){
+        fprintf(out, "  %s %dMHz %.2fW: %lldms busy (%.2f%%)\n", e->freqs[i].name, e->freqs[i].frequency,
+            e->freqs[i].power, e->freqs[i].time, (end_time > 0) ? 100.0 * e->freqs[i].time / end_time : 0.0);
+    }
+    for(int i = 0; i < e->idle_count; i++){
+        fprintf(out, "  %s idle %.2fW after %dms: %lldms (%.2f%%), entered %lld times\n", e->idles[i].name,
+            e->idles[i].power, e->idles[i].residency, e->idles[i].time,
+            (end_time > 0) ? 100.0 * e->idles[i].time / end_time : 0.0, e->idles[i].entries);
+    }
+}
+
+static inline void energy_close(energy_t e){
+    free(e);
+}
+
+#endif
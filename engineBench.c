@@ -0,0 +1,198 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Benchmark of the simulation loops of libkernel-    *
+* sim. Every policy runs a generated workload with   *
+* every output, once in the generic loop (ks_run,    *
+* the policy read at every step and the transitions  *
+* written by a callback) and once in the loop        *
+* specialized for the policy and output              *
+* (ks_run_output). Both must write the same bytes    *
+* and reach the same metrics.                        *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "kernelSim.h"
+
+static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATED"};
+static const char *POLICIES[] = { "fcfs", "rr", "priority" };
+static const char *OUTPUTS[] = { "metrics", "text", "binary" };
+
+// One generated process, the columns of the input CSV
+struct row {
+    int pid;
+    int arrival_time;
+    int total_cpu_time;
+    int io_frequency;
+    int io_duration;
+};
+
+// What a run produced, to check that both loops did the same work
+struct result {
+    double time;
+    sim_time_t end_time;
+    long long transitions;
+    unsigned long long hash;
+};
+
+double now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// The transition callbacks of the generic loop, they write what ks_run_output writes
+void write_text(void *context, sim_time_t time, sim_pid_t pid, enum KS_STATE old_state, enum KS_STATE new_state){
+    fprintf((FILE *) context, "%lld,%lld,%s,%s\n", time, pid, STATES[old_state], STATES[new_state]);
+}
+
+void write_record(void *context, sim_time_t time, sim_pid_t pid, enum KS_STATE old_state, enum KS_STATE new_state){
+    struct ks_transition_record record = { time, pid, (uint8_t) old_state, (uint8_t) new_state, { 0 } };
+
+    fwrite(&record, sizeof(record), 1, (FILE *) context);
+}
+
+/* FUNCTION DESCRIPTION: generate
+* Fills the rows of a workload that keeps the CPU busy most of the time, the same for a given seed
+*/
+void generate(struct row *rows, int n, unsigned int seed){
+    srand(seed);
+    for(int i = 0; i < n; i++){
+        rows[i].pid = i + 1;
+        rows[i].arrival_time = rand() % (n * 40 + 1);
+        rows[i].total_cpu_time = 1 + rand() % 80;
+        rows[i].io_frequency = 1 + rand() % 20;
+        rows[i].io_duration = 1 + rand() % 30;
+    }
+}
+
+// FNV-1a of what a run wrote, read back once it is done
+unsigned long long hash_file(FILE *f){
+    unsigned long long hash = 14695981039346656037ULL;
+    int c;
+
+    fflush(f);
+    rewind(f);
+    while((c = getc(f)) != EOF) hash = (hash ^ (unsigned char) c) * 1099511628211ULL;
+    return hash;
+}
+
+/* FUNCTION DESCRIPTION: run
+* Runs the workload with a policy and an output, in the generic or the specialized loop
+* The return value is 0, or -1 if the simulation or its output cannot be created
+*/
+int run(const struct row *rows, int n, enum KS_POLICY policy, enum KS_OUTPUT output, int specialized, struct result *result){
+    ks_transition_fn callbacks[] = { NULL, write_text, write_record };
+    struct ks_config config;
+    struct ks_metrics m;
+    FILE *out = NULL;
+    double start;
+    ks_sim_t *sim = ks_create();
+
+    if(sim == NULL) return -1;
+    ks_config_default(&config);
+    config.policy = policy;
+    ks_configure(sim, &config);
+    for(int i = 0; i < n; i++){
+        ks_add_process(sim, rows[i].pid, rows[i].arrival_time, rows[i].total_cpu_time, rows[i].io_frequency, rows[i].io_duration);
+    }
+    if(output != KS_OUTPUT_METRICS){
+        out = tmpfile();
+        if(out == NULL){
+            perror("Cannot create the output file");
+            ks_destroy(sim);
+            return -1;
+        }
+    }
+
+    start = now();
+    if(specialized){
+        ks_run_output(sim, output, out);
+    } else {
+        ks_set_transition_callback(sim, callbacks[output], out);
+        ks_run(sim);
+    }
+    if(out != NULL) fflush(out);
+    result->time = now() - start;
+
+    ks_get_metrics(sim, &m);
+    result->end_time = m.end_time;
+    result->transitions = m.transitions;
+    result->hash = 0;
+    if(out != NULL){
+        result->hash = hash_file(out);
+        fclose(out);
+    }
+    ks_destroy(sim);
+    return 0;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-n processes] [-r repetitions] [-s seed]\n", name);
+}
+
+int main(int argc, char *argv[]){
+    int n = 100000, repetitions = 3, opt;
+    unsigned int seed = 1;
+    struct result generic = { 0 }, specialized = { 0 }, r;
+    struct row *rows;
+
+    while((opt = getopt(argc, argv, "n:r:s:")) != -1){
+        if(opt == 'n'){
+            n = atoi(optarg);
+        } else if(opt == 'r'){
+            repetitions = atoi(optarg);
+        } else if(opt == 's'){
+            seed = (unsigned int) atoi(optarg);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if(n <= 0 || repetitions <= 0){
+        print_usage(argv[0]);
+        return 2;
+    }
+    rows = (struct row *) malloc(n * sizeof(struct row));
+    if(rows == NULL){
+        perror("Cannot allocate the workload");
+        return 1;
+    }
+    generate(rows, n, seed);
+
+    printf("Policy,Output,Processes,Transitions,Generic (s),Specialized (s),Speedup\n");
+    for(int policy = KS_FCFS; policy <= KS_PRIORITY; policy++){
+        for(int output = KS_OUTPUT_METRICS; output <= KS_OUTPUT_BINARY; output++){
+            // The fastest of the repetitions, alternating the loops so that both see the same machine
+            generic.time = specialized.time = -1;
+            for(int i = 0; i < 2 * repetitions; i++){
+                if(run(rows, n, (enum KS_POLICY) policy, (enum KS_OUTPUT) output, i % 2, &r) != 0){
+                    free(rows);
+                    return 1;
+                }
+                if(i % 2 == 0 && (generic.time < 0 || r.time < generic.time)) generic = r;
+                if(i % 2 == 1 && (specialized.time < 0 || r.time < specialized.time)) specialized = r;
+            }
+            if(generic.end_time != specialized.end_time || generic.transitions != specialized.transitions
+                || generic.hash != specialized.hash){
+                fprintf(stderr, "%s with the %s output: the specialized loop ended at %lldms after %lld transitions, "
+                    "the generic one at %lldms after %lld%s\n", POLICIES[policy], OUTPUTS[output], specialized.end_time,
+                    specialized.transitions, generic.end_time, generic.transitions,
+                    (generic.hash != specialized.hash) ? ", and the outputs differ" : "");
+                free(rows);
+                return 1;
+            }
+            printf("%s,%s,%d,%lld,%.3f,%.3f,%.2fx\n", POLICIES[policy], OUTPUTS[output], n, generic.transitions,
+                generic.time, specialized.time, generic.time / specialized.time);
+        }
+    }
+    free(rows);
+    return 0;
+}
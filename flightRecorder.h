@@ -0,0 +1,174 @@
+/*****************************************************
+* Flight recorder shared by the simulators           *
+******************************************************
+* Keeps the last transitions and queue length        *
+* samples in fixed size rings instead of printing    *
+* every queue after every step. A sample is taken    *
+* every interval of simulated time and printed as a  *
+* line; the rings are only written out on request    *
+* (SIGUSR1) or when the simulation goes wrong, so    *
+* the cost per event stays constant whatever the     *
+* size of the input.                                 *
+******************************************************/
+
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <signal.h>
+#include "simTime.h"
+
+#define RECORDER_DEFAULT_EVENTS 4096
+#define RECORDER_DEFAULT_INTERVAL 1000
+
+struct flight_event {
+    sim_time_t time;
+    sim_pid_t pid;
+    const char *old_state;
+    const char *new_state;
+};
+
+// The queue lengths at one time, running is the PID on the CPU or -1
+struct flight_sample {
+    sim_time_t time;
+    sim_pid_t running;
+    int ready;
+    int waiting;
+    int blocked;
+    int arriving;
+};
+
+struct flight_recorder {
+    struct flight_event *events;
+    struct flight_sample *samples;
+    unsigned long long num_events;
+    unsigned long long num_samples;
+    int capacity;
+    int interval;
+    sim_time_t next_sample;
+    int dumps;
+    FILE *out;
+};
+
+typedef struct flight_recorder *recorder_t;
+
+// Set by SIGUSR1, the simulation loop writes the rings out at its next step
+static volatile sig_atomic_t recorder_requested = 0;
+
+static inline void recorder_on_signal(int signal_number){
+    (void) signal_number;
+    recorder_requested = 1;
+}
+
+/* FUNCTION DESCRIPTION: recorder_open
+* Creates a flight recorder
+* The parameters are:
+*    -spec, "<events>[,<interval>]": the number of transitions and samples kept, and the simulated ms between samples
+*    -out, where the samples and the dumps are written
+* The return value is the recorder, or NULL if the spec is not valid
+*/
+static inline recorder_t recorder_open(const char *spec, FILE *out){
+    int capacity = RECORDER_DEFAULT_EVENTS, interval = RECORDER_DEFAULT_INTERVAL;
+    recorder_t r;
+
+    if(sscanf(spec, "%d,%d", &capacity, &interval) < 1 || capacity <= 0 || interval <= 0){
+        fprintf(stderr, "The flight recorder is <events>[,<interval_ms>], both positive: %s\n", spec);
+        return NULL;
+    }
+    r = (recorder_t) calloc(1, sizeof(struct flight_recorder));
+    assert(r != NULL);
+    r->events = (struct flight_event *) malloc(capacity * sizeof(struct flight_event));
+    r->samples = (struct flight_sample *) malloc(capacity * sizeof(struct flight_sample));
+    assert(r->events != NULL && r->samples != NULL);
+    r->capacity = capacity;
+    r->interval = interval;
+    r->out = out;
+    signal(SIGUSR1, recorder_on_signal);
+    return r;
+}
+
+// Records one transition, overwriting the oldest once the ring is full
+static inline void recorder_transition(recorder_t r, sim_time_t time, sim_pid_t pid, const char *old_state, const char *new_state){
+    struct flight_event *e;
+
+    if(r == NULL) return;
+    e = &r->events[r->num_events++ % r->capacity];
+    e->time = time;
+    e->pid = pid;
+    e->old_state = old_state;
+    e->new_state = new_state;
+}
+
+/* FUNCTION DESCRIPTION: recorder_due
+* True when a sample must be taken at time now, the simulators only count their queues then
+*/
+static inline int recorder_due(recorder_t r, sim_time_t now){
+    return r != NULL && now >= r->next_sample;
+}
+
+/* FUNCTION DESCRIPTION: recorder_sample
+* Records the queue lengths and prints them as a line
+*/
+static inline void recorder_sample(recorder_t r, sim_time_t now, sim_pid_t running, int ready, int waiting, int blocked, int arriving){
+    struct flight_sample *s = &r->samples[r->num_samples++ % r->capacity];
+
+    s->time = now;
+    s->running = running;
+    s->ready = ready;
+    s->waiting = waiting;
+    s->blocked = blocked;
+    s->arriving = arriving;
+    fprintf(r->out, "Sample at %lldms: running %lld, ready %d, waiting %d, blocked %d, arriving %d\n",
+        now, running, ready, waiting, blocked, arriving);
+    // A long step skips the samples it covers, the next one is on the interval grid
+    r->next_sample = now - now % r->interval + r->interval;
+}
+
+/* FUNCTION DESCRIPTION: recorder_dump
+* Writes the transitions and samples in the rings, oldest first
+* The parameters are:
+*    -now, the simulated time
+*    -reason, why the rings are written
+*/
+static inline void recorder_dump(recorder_t r, sim_time_t now, const char *reason){
+    unsigned long long first;
+
+    if(r == NULL) return;
+    r->dumps++;
+    first = (r->num_events > (unsigned long long) r->capacity) ? r->num_events - r->capacity : 0;
+    fprintf(r->out, "Flight recorder at %lldms (%s): last %llu of %llu transitions\n",
+        now, reason, r->num_events - first, r->num_events);
+    fprintf(r->out, "Time of transition,PID,Old State,New State\n");
+    for(unsigned long long i = first; i < r->num_events; i++){
+        struct flight_event *e = &r->events[i % r->capacity];
+        fprintf(r->out, "%lld,%lld,%s,%s\n", e->time, e->pid, e->old_state, e->new_state);
+    }
+    first = (r->num_samples > (unsigned long long) r->capacity) ? r->num_samples - r->capacity : 0;
+    fprintf(r->out, "Last %llu of %llu samples\n", r->num_samples - first, r->num_samples);
+    fprintf(r->out, "Time,Running,Ready,Waiting,Blocked,Arriving\n");
+    for(unsigned long long i = first; i < r->num_samples; i++){
+        struct flight_sample *s = &r->samples[i % r->capacity];
+        fprintf(r->out, "%lld,%lld,%d,%d,%d,%d\n", s->time, s->running, s->ready, s->waiting, s->blocked, s->arriving);
+    }
+    fflush(r->out);
+}
+
+// Writes the rings out if SIGUSR1 arrived since the last step
+static inline void recorder_poll(recorder_t r, sim_time_t now){
+    if(r != NULL && recorder_requested){
+        recorder_requested = 0;
+        recorder_dump(r, now, "requested");
+    }
+}
+
+static inline void recorder_close(recorder_t r){
+    if(r == NULL) return;
+    signal(SIGUSR1, SIG_DFL);
+    free(r->events);
+    free(r->samples);
+    free(r);
+}
+
+#endif
@@ -0,0 +1,456 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Differential tester for the simulators. It runs a  *
+* reference and a candidate simulator on generated   *
+* workloads, compares their transitions and the      *
+* metrics derived from them, and shrinks the first   *
+* workload that diverges to a small reproducer.      *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+#define MAX_COMMAND 4096
+#define MAX_ROW 128
+
+// Macro to return the min of a and b
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+// The output of one run, the lines of stdout
+struct output {
+    char **lines;
+    int count;
+    int capacity;
+};
+
+// The metrics of one process, derived from its transitions
+struct metrics {
+    int pid;
+    int arrival;
+    int finish;
+    int dispatches;
+    long long ready_time;
+    int ready_since;
+};
+
+// Everything the tester needs to run one comparison
+struct tester {
+    const char *reference;
+    const char *candidate;
+    const char *workload_file;
+    int timeout;
+    bool metrics_only;
+};
+
+/* FUNCTION DESCRIPTION: next_random
+* xorshift64* generator, the workloads only depend on the seed
+*/
+unsigned long long next_random(unsigned long long *state){
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+int random_between(unsigned long long *state, int low, int high){
+    return low + (int) (next_random(state) % (unsigned long long) (high - low + 1));
+}
+
+/* FUNCTION DESCRIPTION: generate_workload
+* Generates the rows of a random workload, in the input format of the simulators
+* The parameters are:
+*    - rows: filled with num_processes rows, without the header
+*    - num_processes: the number of processes
+*    - seed: the seed of the workload
+*    - sorted: the rows are sorted by arrival time, as the streaming mode of the simulators needs
+*/
+void generate_workload(char **rows, int num_processes, unsigned long long seed, bool sorted){
+    unsigned long long state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    int horizon = max(num_processes * 4, 8), arrival = 0;
+
+    for(int i = 0; i < num_processes; i++){
+        // Sorted arrivals are spread over the same horizon on average
+        arrival = sorted ? arrival + random_between(&state, 0, 8) : random_between(&state, 0, horizon);
+        snprintf(rows[i], MAX_ROW, "%d,%d,%d,%d,%d", i + 1, arrival,
+            random_between(&state, 1, 30), random_between(&state, 1, 12), random_between(&state, 1, 15));
+    }
+}
+
+/* FUNCTION DESCRIPTION: write_workload
+* Writes the rows to the workload file, with the header the simulators skip
+* The return value is 0 on success, -1 if the file cannot be written
+*/
+int write_workload(const char *file, char **rows, int count){
+    FILE *f = fopen(file, "w");
+    if(f == NULL){
+        perror("Cannot write the workload");
+        return -1;
+    }
+    fprintf(f, "Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration\n");
+    for(int i = 0; i < count; i++){
+        fprintf(f, "%s\n", rows[i]);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: build_command
+* Replaces every {} of the command template by the workload file. With a timeout the whole
+* command runs in its own shell under timeout, so that pipelines are killed as well.
+*/
+void build_command(char *command, const char *template, const char *workload_file, int timeout){
+    int length = 0;
+
+    if(timeout > 0) length = snprintf(command, MAX_COMMAND, "timeout %d sh -c '", timeout);
+    for(const char *c = template; *c != '\0' && length < MAX_COMMAND - 8; c++){
+        if(c[0] == '{' && c[1] == '}'){
+            length += snprintf(command + length, MAX_COMMAND - 8 - length, "%s", workload_file);
+            c++;
+        } else if(*c == '\'' && timeout > 0){
+            // Close the quote, add an escaped quote and open it again
+            length += snprintf(command + length, MAX_COMMAND - 8 - length, "'\\''");
+        } else {
+            command[length++] = *c;
+        }
+    }
+    length = min(length, MAX_COMMAND - 8);
+    if(timeout > 0) command[length++] = '\'';
+    command[length] = '\0';
+}
+
+void free_output(struct output *out){
+    for(int i = 0; i < out->count; i++) free(out->lines[i]);
+    free(out->lines);
+    out->lines = NULL;
+    out->count = 0;
+    out->capacity = 0;
+}
+
+/* FUNCTION DESCRIPTION: run_simulator
+* Runs a command on the workload and keeps its stdout
+* The return value is the exit status of the command, 124 when timeout killed it
+*/
+int run_simulator(struct tester *t, const char *template, struct output *out){
+    char command[MAX_COMMAND], *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    int status;
+    FILE *p;
+
+    build_command(command, template, t->workload_file, t->timeout);
+    out->lines = NULL;
+    out->count = 0;
+    out->capacity = 0;
+
+    p = popen(command, "r");
+    if(p == NULL){
+        perror("Cannot run the simulator");
+        return -1;
+    }
+    while((length = getline(&line, &size, p)) != -1){
+        while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) line[--length] = '\0';
+        if(out->count == out->capacity){
+            out->capacity = (out->capacity == 0) ? 256 : out->capacity * 2;
+            out->lines = (char **) realloc(out->lines, out->capacity * sizeof(char *));
+            assert(out->lines != NULL);
+        }
+        out->lines[out->count++] = strdup(line);
+    }
+    free(line);
+    status = pclose(p);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/* FUNCTION DESCRIPTION: parse_transition
+* Parses a transition in the format of roundRobin.c ("time,pid,OLD,NEW") or of FCFS.c ("time pid Old New")
+* The return value is true if the line is a transition
+*/
+bool parse_transition(const char *line, int *time, int *pid, char *old_state, char *new_state){
+    if(sscanf(line, "%d,%d,%31[^,],%31s", time, pid, old_state, new_state) == 4) return true;
+    return sscanf(line, "%d %d %31s %31s", time, pid, old_state, new_state) == 4;
+}
+
+/* FUNCTION DESCRIPTION: find_metrics
+* Finds the metrics of a process, adding it if it is new
+*/
+struct metrics *find_metrics(struct metrics **all, int *count, int *capacity, int pid){
+    for(int i = 0; i < *count; i++){
+        if((*all)[i].pid == pid) return &(*all)[i];
+    }
+    if(*count == *capacity){
+        *capacity = (*capacity == 0) ? 64 : *capacity * 2;
+        *all = (struct metrics *) realloc(*all, *capacity * sizeof(struct metrics));
+        assert(*all != NULL);
+    }
+    struct metrics *m = &(*all)[(*count)++];
+    m->pid = pid;
+    m->arrival = -1;
+    m->finish = -1;
+    m->dispatches = 0;
+    m->ready_time = 0;
+    m->ready_since = -1;
+    return m;
+}
+
+/* FUNCTION DESCRIPTION: compute_metrics
+* Derives the metrics of every process from the transitions of a run
+* The return value is the number of processes, *all is allocated by this function
+*/
+int compute_metrics(struct output *out, struct metrics **all){
+    int count = 0, capacity = 0, time, pid;
+    char old_state[32], new_state[32];
+    struct metrics *m;
+
+    *all = NULL;
+    for(int i = 0; i < out->count; i++){
+        if(!parse_transition(out->lines[i], &time, &pid, old_state, new_state)) continue;
+        m = find_metrics(all, &count, &capacity, pid);
+        if(strcasecmp(old_state, "new") == 0) m->arrival = time;
+        if(strcasecmp(new_state, "ready") == 0) m->ready_since = time;
+        if(strcasecmp(old_state, "ready") == 0 && m->ready_since >= 0) m->ready_time += time - m->ready_since;
+        if(strcasecmp(new_state, "running") == 0) m->dispatches++;
+        if(strcasecmp(new_state, "terminated") == 0) m->finish = time;
+    }
+    return count;
+}
+
+/* FUNCTION DESCRIPTION: compare_metrics
+* Compares the metrics of the two runs
+* The parameters are:
+*    - a, b: the outputs of the reference and of the candidate
+*    - report: print the differences
+* The return value is the number of differences
+*/
+int compare_metrics(struct output *a, struct output *b, bool report){
+    struct metrics *ma, *mb;
+    int na = compute_metrics(a, &ma), nb = compute_metrics(b, &mb), differences = 0;
+    long long turnaround_a = 0, turnaround_b = 0, wait_a = 0, wait_b = 0;
+    int makespan_a = 0, makespan_b = 0;
+
+    if(na != nb){
+        differences++;
+        if(report) printf("  processes: reference %d, candidate %d\n", na, nb);
+    }
+    for(int i = 0; i < na; i++){
+        struct metrics *x = &ma[i], *y = NULL;
+        for(int j = 0; j < nb; j++){
+            if(mb[j].pid == x->pid) y = &mb[j];
+        }
+        makespan_a = max(makespan_a, x->finish);
+        turnaround_a += x->finish - x->arrival;
+        wait_a += x->ready_time;
+        if(y == NULL){
+            differences++;
+            if(report) printf("  PID %d: missing from the candidate\n", x->pid);
+            continue;
+        }
+        if(x->finish != y->finish || x->ready_time != y->ready_time || x->dispatches != y->dispatches){
+            differences++;
+            if(report) printf("  PID %d: finish %d vs %d, ready time %lld vs %lld, dispatches %d vs %d\n", x->pid,
+                x->finish, y->finish, x->ready_time, y->ready_time, x->dispatches, y->dispatches);
+        }
+    }
+    for(int j = 0; j < nb; j++){
+        makespan_b = max(makespan_b, mb[j].finish);
+        turnaround_b += mb[j].finish - mb[j].arrival;
+        wait_b += mb[j].ready_time;
+    }
+    if(report && na > 0 && nb > 0){
+        printf("  makespan %d vs %d, mean turnaround %.2f vs %.2f, mean ready time %.2f vs %.2f\n",
+            makespan_a, makespan_b, (double) turnaround_a / na, (double) turnaround_b / nb,
+            (double) wait_a / na, (double) wait_b / nb);
+    }
+    free(ma);
+    free(mb);
+    return differences;
+}
+
+/* FUNCTION DESCRIPTION: compare_runs
+* Runs both simulators on the rows and compares them
+* The parameters are:
+*    - t: the tester
+*    - rows, count: the workload
+*    - report: print where they diverge
+* The return value is true if the simulators diverge
+*/
+bool compare_runs(struct tester *t, char **rows, int count, bool report){
+    struct output a, b;
+    int status_a, status_b, first = -1;
+    bool diverge;
+
+    if(write_workload(t->workload_file, rows, count) != 0) exit(2);
+    status_a = run_simulator(t, t->reference, &a);
+    status_b = run_simulator(t, t->candidate, &b);
+
+    if(!t->metrics_only){
+        for(int i = 0; i < min(a.count, b.count); i++){
+            if(strcmp(a.lines[i], b.lines[i]) != 0){
+                first = i;
+                break;
+            }
+        }
+        if(first < 0 && a.count != b.count) first = min(a.count, b.count);
+    }
+    diverge = (first >= 0) || (status_a != status_b) || compare_metrics(&a, &b, false) > 0;
+
+    if(report && diverge){
+        if(status_a != status_b) printf("  exit status: reference %d, candidate %d\n", status_a, status_b);
+        if(first >= 0){
+            printf("  first difference at line %d of %d/%d:\n", first + 1, a.count, b.count);
+            printf("    reference: %s\n", (first < a.count) ? a.lines[first] : "<end of output>");
+            printf("    candidate: %s\n", (first < b.count) ? b.lines[first] : "<end of output>");
+        }
+        compare_metrics(&a, &b, true);
+    }
+    free_output(&a);
+    free_output(&b);
+    return diverge;
+}
+
+/* FUNCTION DESCRIPTION: minimize
+* Shrinks a diverging workload with delta debugging: it removes chunks of rows as long as the
+* simulators still diverge, with smaller and smaller chunks, until no single row can be removed.
+* The return value is the number of rows left, they are at the start of rows
+*/
+int minimize(struct tester *t, char **rows, int count){
+    char **candidate = (char **) malloc(count * sizeof(char *));
+    int granularity = 2, chunk, kept;
+    bool reduced;
+
+    assert(candidate != NULL);
+    while(count >= 2){
+        chunk = (count + granularity - 1) / granularity;
+        reduced = false;
+        for(int start = 0; start < count; start += chunk){
+            // The complement of the chunk
+            kept = 0;
+            for(int i = 0; i < count; i++){
+                if(i < start || i >= start + chunk) candidate[kept++] = rows[i];
+            }
+            if(kept > 0 && compare_runs(t, candidate, kept, false)){
+                // Keep the removed rows at the end so that they are still freed
+                char **removed = (char **) malloc(chunk * sizeof(char *));
+                int removed_count = 0;
+                assert(removed != NULL);
+                for(int i = start; i < min(start + chunk, count); i++) removed[removed_count++] = rows[i];
+                memcpy(rows, candidate, kept * sizeof(char *));
+                memcpy(rows + kept, removed, removed_count * sizeof(char *));
+                free(removed);
+                count = kept;
+                granularity = max(granularity - 1, 2);
+                reduced = true;
+                printf("  reduced to %d processes\n", count);
+                break;
+            }
+        }
+        if(!reduced){
+            if(granularity >= count) break;
+            granularity = min(granularity * 2, count);
+        }
+    }
+    free(candidate);
+    return count;
+}
+
+/* FUNCTION DESCRIPTION: clean_up
+* Removes the workload file, and the output FCFS.c writes next to it, and frees the rows
+*/
+void clean_up(const char *workload_file, char **rows, int num_processes){
+    char fcfs_output[96];
+
+    snprintf(fcfs_output, sizeof(fcfs_output), "output_%s.txt", workload_file);
+    unlink(workload_file);
+    unlink(fcfs_output);
+    for(int i = 0; i < num_processes; i++) free(rows[i]);
+    free(rows);
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-n runs] [-p processes] [-s seed] [-t timeout_s] [-m] [-a] [-o reproducer.csv] "
+        "\"<reference command>\" \"<candidate command>\"\n", name);
+    printf("Every {} in a command is replaced by the generated workload file.\n");
+}
+
+int main(int argc, char *argv[]){
+    int runs = 100, num_processes = 20, opt, count;
+    bool sorted = false;
+    unsigned long long seed = 1;
+    const char *reproducer = "golden_repro.csv";
+    char workload_file[64];
+    char **rows;
+    struct tester t;
+
+    t.timeout = 0;
+    t.metrics_only = false;
+    // -n: the number of workloads, -p: processes per workload, -s: the seed of the first workload
+    // -t: kill a simulator that runs longer than this (it may loop forever on a bug)
+    // -m: only compare the metrics, not the transitions line by line
+    // -o: where to write the minimized workload
+    // -a: generate workloads sorted by arrival time
+    while((opt = getopt(argc, argv, "n:p:s:t:mo:a")) != -1){
+        if(opt == 'n'){
+            runs = atoi(optarg);
+        } else if(opt == 'p'){
+            num_processes = atoi(optarg);
+        } else if(opt == 's'){
+            seed = strtoull(optarg, NULL, 10);
+        } else if(opt == 't'){
+            t.timeout = atoi(optarg);
+        } else if(opt == 'm'){
+            t.metrics_only = true;
+        } else if(opt == 'o'){
+            reproducer = optarg;
+        } else if(opt == 'a'){
+            sorted = true;
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if(argc - optind != 2 || num_processes <= 0){
+        print_usage(argv[0]);
+        return 2;
+    }
+    t.reference = argv[optind];
+    t.candidate = argv[optind + 1];
+
+    // The workload is in the current directory, FCFS.c names its output after the input file
+    snprintf(workload_file, sizeof(workload_file), "golden_%d.csv", (int) getpid());
+    t.workload_file = workload_file;
+
+    rows = (char **) malloc(num_processes * sizeof(char *));
+    assert(rows != NULL);
+    for(int i = 0; i < num_processes; i++){
+        rows[i] = (char *) malloc(MAX_ROW);
+        assert(rows[i] != NULL);
+    }
+
+    for(int run = 0; run < runs; run++){
+        generate_workload(rows, num_processes, seed + run, sorted);
+        if(!compare_runs(&t, rows, num_processes, false)) continue;
+
+        printf("Workload %llu diverges:\n", seed + run);
+        compare_runs(&t, rows, num_processes, true);
+        printf("Minimizing...\n");
+        count = minimize(&t, rows, num_processes);
+        write_workload(reproducer, rows, count);
+        printf("Reproducer with %d processes written to %s:\n", count, reproducer);
+        compare_runs(&t, rows, count, true);
+
+        clean_up(workload_file, rows, num_processes);
+        return 1;
+    }
+
+    printf("%d workloads of %d processes, no difference\n", runs, num_processes);
+    clean_up(workload_file, rows, num_processes);
+    return 0;
+}
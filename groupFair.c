@@ -0,0 +1,758 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Processes belong to groups that form a tree, and   *
+* the CPU is shared fairly between the groups of     *
+* each level, in proportion to their weights, like   *
+* cgroups. Every group has its own run queue, a heap *
+* of its runnable children ordered by virtual        *
+* runtime. The processes yet to arrive and those     *
+* waiting for I/O are in heaps on the time of their  *
+* next event, so no event scans all the processes.   *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "minHeap.h"
+#include "burstPool.h"
+#include "simTime.h"
+#define TIME_SLICE 3
+
+// Weight of every process, and of a group that is not given one
+#define DEFAULT_WEIGHT 1024
+// Virtual runtime is kept in 1/VRUNTIME_SCALE of a ms so that small weights do not round to 0
+#define VRUNTIME_SCALE 1024
+#define GROUP_BUCKETS 4096
+
+// Macro to return the min of a and b
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+// An enumerator (enum for short) to represent the state
+enum STATE {
+    STATE_NEW,
+    STATE_READY,
+    STATE_RUNNING,
+    STATE_WAITING,
+    STATE_TERMINATED
+};
+static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATED"};
+
+struct group;
+struct node;
+
+// A schedulable entity: either a process, or a group in the run queue of its parent group
+// on_queue is set while the entity is in the run queue of its parent,
+// current is set while the entity is on the path from the root to the running process
+struct entity {
+    long long vruntime;
+    int weight;
+    bool on_queue;
+    bool current;
+    struct group *parent;
+    struct group *group;
+    struct node *node;
+};
+
+// A group of processes. The root group has id 0 and no parent.
+struct group {
+    int id;
+    int parent_id;
+    int weight;
+    int num_processes;
+    long long cpu_time;
+    long long min_vruntime;
+    struct group *parent;
+    struct entity se;
+    heap_t queue;
+    struct group *hash_next;
+    struct group *all_next;
+};
+
+// A structure containing all the relovant meta data for a process, this is the PCB like struct
+// The io_time_remaining is used in two ways:
+// it counts how long until the next io call and how long until a current io call is complete
+// io_done is the time its I/O completes while it is waiting
+struct process {
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time;
+    int cpu_time_remaining;
+    int io_frequency;
+    int io_duration;
+    int io_time_remaining;
+    sim_time_t io_done;
+    // The sequences of the I/O Frequency and I/O Duration columns, burst counts the I/O done
+    struct burst_seq cpu_bursts;
+    struct burst_seq io_bursts;
+    int burst;
+    struct entity se;
+    enum STATE s;
+};
+
+// This structure is a linked list of processes
+struct node {
+    struct process *p;
+    struct node *next;
+};
+
+// typedefs are a short hand to make the code more legible
+typedef struct process *proc_t;
+typedef struct node *node_t;
+typedef struct group *group_t;
+
+// All the groups, found by id through a hash table
+struct group_table {
+    group_t buckets[GROUP_BUCKETS];
+    group_t all;
+    group_t root;
+    int count;
+};
+static struct group_table groups;
+
+/* FUNCTION DESCRIPTION: find_group
+* Finds a group by id, creating it (as a child of the root) if it does not exist yet
+* The return value is a pointer to the group
+*/
+group_t find_group(int id){
+    unsigned int bucket = ((unsigned int) id * 2654435761u) % GROUP_BUCKETS;
+    group_t g;
+
+    for(g = groups.buckets[bucket]; g != NULL; g = g->hash_next){
+        if(g->id == id) return g;
+    }
+
+    g = (group_t) calloc(1, sizeof(struct group));
+    assert(g != NULL);
+    g->id = id;
+    g->parent_id = 0;
+    g->weight = DEFAULT_WEIGHT;
+    g->queue = heap_create(16);
+    g->se.weight = DEFAULT_WEIGHT;
+    g->se.group = g;
+    g->hash_next = groups.buckets[bucket];
+    groups.buckets[bucket] = g;
+    g->all_next = groups.all;
+    groups.all = g;
+    groups.count++;
+    return g;
+}
+
+/* FUNCTION DESCRIPTION: link_groups
+* Sets the parent of every group once all of them are known.
+* A group whose ancestors never reach the root is part of a cycle, it is moved under the root.
+*/
+void link_groups(void){
+    group_t g, ancestor;
+    int depth;
+
+    // Create the parents that only appear as a parent, they are children of the root
+    for(g = groups.all; g != NULL; g = g->all_next){
+        find_group(g->parent_id);
+    }
+    for(g = groups.all; g != NULL; g = g->all_next){
+        if(g == groups.root) continue;
+        ancestor = find_group(g->parent_id);
+        for(depth = 0; ancestor != groups.root && ancestor != g && depth < groups.count; depth++){
+            ancestor = find_group(ancestor->parent_id);
+        }
+        if(ancestor != groups.root){
+            fprintf(stderr, "Group %d is part of a cycle, it is moved under the root\n", g->id);
+            g->parent_id = 0;
+        }
+    }
+    for(g = groups.all; g != NULL; g = g->all_next){
+        if(g == groups.root) continue;
+        g->parent = find_group(g->parent_id);
+        g->se.parent = g->parent;
+        g->se.weight = g->weight;
+    }
+}
+
+/* FUNCTION DESCRIPTION: create_proc
+* This function creates a new process structure.
+* The parameters are self descriptive:
+*    -pid
+*    -arrival_time
+*    -total_cpu_time
+*    -io_frequency
+*    -io_duration
+*    -g, the group of the process
+* The return value is a pointer to new process structure
+*/
+proc_t create_proc(sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration, group_t g){
+    // Initialize memory
+    proc_t temp;
+    temp = (proc_t) malloc(sizeof(struct process));
+    assert(temp != NULL);
+
+    // Initialize contents
+    temp->pid = pid;
+    temp->arrival_time = arrival_time;
+    temp->total_cpu_time = total_cpu_time;
+    temp->cpu_time_remaining = total_cpu_time;
+    temp->io_frequency = io_frequency;
+    temp->io_duration = io_duration;
+    temp->io_time_remaining = io_frequency;
+    temp->io_done = 0;
+    temp->cpu_bursts.chunk = temp->io_bursts.chunk = NULL;
+    temp->cpu_bursts.count = temp->io_bursts.count = 1;
+    temp->burst = 0;
+    temp->se.vruntime = 0;
+    temp->se.weight = DEFAULT_WEIGHT;
+    temp->se.on_queue = false;
+    temp->se.current = false;
+    temp->se.parent = g;
+    temp->se.group = NULL;
+    temp->se.node = NULL;
+    temp->s = STATE_NEW;
+    g->num_processes++;
+    return temp;
+}
+
+/* FUNCTION DESCRIPTION: create_node
+* This function creates a new  list node.
+* The parameters are:
+*    -p, a pointer to the process structure to be stored in this node
+* The return value is a pointer to the new node
+*/
+node_t create_node(proc_t p){
+    // Initialize memory
+    node_t temp;
+    temp = (node_t) malloc(sizeof(struct node));
+    assert(temp != NULL);
+
+    // Initialize contents
+    temp->next = NULL;
+    temp->p = p;
+    p->se.node = temp;
+
+    return temp;
+}
+
+/* FUNCTION DESCRIPTION: print_proc
+* Prints one process, along with its time remaining and current state
+* The time until the next IO event of a waiting process is counted from cpu_clock
+*/
+void print_proc(proc_t p, sim_time_t cpu_clock){
+    printf("Process ID: %lld\n", p->pid);
+    printf("CPU Arrival Time: %lldms\n", p->arrival_time);
+    printf("Time Remaining: %dms of %dms\n", p->cpu_time_remaining, p->total_cpu_time);
+    printf("IO Duration: %dms\n", p->io_duration);
+    printf("IO Frequency: %dms\n", p->io_frequency);
+    printf("Group: %d\n", p->se.parent->id);
+    printf("Current state: %s\n", STATES[p->s]);
+    printf("Time until next IO event: %lldms\n", (p->s == STATE_WAITING) ? p->io_done - cpu_clock : (sim_time_t) p->io_time_remaining);
+    printf("\n");
+}
+
+/* FUNCTION DESCRIPTION: print_nodes
+* Prints all the nodes in head, along with their time remaining and current states
+*/
+void print_nodes(node_t head, sim_time_t cpu_clock) {
+    if(head == NULL){
+        printf("EMPTY\n");
+        return;
+    }
+
+    for(node_t current = head; current != NULL; current = current->next){
+        print_proc(current->p, cpu_clock);
+    }
+}
+
+// Orders heap entries by insertion, for print_heap
+int compare_seq(const void *a, const void *b){
+    unsigned long long x = ((const struct heap_entry *) a)->seq, y = ((const struct heap_entry *) b)->seq;
+    return (x > y) - (x < y);
+}
+
+/* FUNCTION DESCRIPTION: print_heap
+* Prints all the nodes of the arrival or the waiting heap in the order they were added to it,
+* the order of the lists the heaps replaced. Only used in verbose mode, it sorts a copy of the heap.
+*/
+void print_heap(heap_t h, sim_time_t cpu_clock){
+    struct heap_entry *entries;
+
+    if(heap_empty(h)){
+        printf("EMPTY\n");
+        return;
+    }
+
+    entries = (struct heap_entry *) malloc(h->size * sizeof(struct heap_entry));
+    assert(entries != NULL);
+    memcpy(entries, h->entries, h->size * sizeof(struct heap_entry));
+    qsort(entries, h->size, sizeof(struct heap_entry), compare_seq);
+    for(int i = 0; i < h->size; i++){
+        print_proc(((node_t) entries[i].item)->p, cpu_clock);
+    }
+    free(entries);
+}
+
+/* FUNCTION DESCRIPTION: next_token
+* Reads the next comma separated column of the row being tokenized, a number from 0 to INT_MAX,
+* or gives the default value when the row has no more columns (optional columns)
+* The return value is 0, or -1 after printing why the column is not valid
+*/
+int next_token(const char *column, int default_value, int *value){
+    char *token = strtok(NULL, ",");
+    long long number;
+
+    *value = default_value;
+    if(token == NULL) return 0;
+    if(sim_parse_field(token, column, 0, INT_MAX, &number) != 0) return -1;
+    *value = (int) number;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: next_bursts
+* Returns the first burst of the next column of the row being tokenized, which holds one value
+* or a sequence of bursts that is stored in seq, or the default value when the row has no more columns
+*/
+int next_bursts(int default_value, struct burst_seq *seq){
+    char *token = strtok(NULL, ",");
+
+    seq->chunk = NULL;
+    seq->count = 1;
+    if(token == NULL) return default_value;
+    return burst_parse(token, seq);
+}
+
+/* FUNCTION DESCRIPTION: read_proc_from_file
+* Parse the CSV input file and load its contents into a list
+* The Group and Parent Group columns are optional, a process without a group belongs to the root
+* The parameters are:
+*    -input_file, the name of the CSV file
+* The return value is a list of the new processes
+*/
+node_t read_proc_from_file(char *input_file){
+    char *row = NULL, *fields[3];
+    size_t size = 0;
+    node_t new_list=NULL, tail=NULL, node;
+    proc_t proc;
+    group_t g;
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time, io_frequency, io_duration, group_id, parent_id;
+    struct burst_seq cpu_bursts, io_bursts;
+
+    FILE* f = fopen(input_file, "r");
+    if(f == NULL){
+        // file not opened, fail gracefully
+        perror("Cannot open the input file");
+        return NULL;
+    }
+    // Get the first row, which has the header values
+    //Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration[,Group[,Parent Group]]
+    // getline reads the rows whole, however long their burst sequences are
+    if(getline(&row, &size, f) == -1){
+        free(row);
+        fclose(f);
+        return NULL;
+    }
+    // Read the remainder of the rows until you get to the end of the file
+    while(getline(&row, &size, f) != -1){
+        // make sure it has at least enough char to be valid
+        if(strlen(row)<10) continue;
+        // The columns are range checked (see simTime.h), a row with one out of range is skipped
+        fields[0] = strtok(row, ",");
+        fields[1] = strtok(NULL, ",");
+        fields[2] = strtok(NULL, ",");
+        if(fields[2] == NULL || sim_parse_columns(fields, &pid, &arrival_time, &total_cpu_time) != 0) continue;
+        io_frequency = next_bursts(0, &cpu_bursts);
+        io_duration = next_bursts(0, &io_bursts);
+        if(sim_check_columns(pid, arrival_time, total_cpu_time, io_frequency, io_duration) != 0
+            || next_token("Group", 0, &group_id) != 0 || next_token("Parent Group", -1, &parent_id) != 0){
+            burst_free(&cpu_bursts);
+            burst_free(&io_bursts);
+            continue;
+        }
+
+        g = find_group(group_id);
+        if(parent_id >= 0 && g != groups.root) g->parent_id = parent_id;
+        proc = create_proc(pid, arrival_time, total_cpu_time, io_frequency, io_duration, g);
+        proc->cpu_bursts = cpu_bursts;
+        proc->io_bursts = io_bursts;
+        node = create_node(proc);
+        // Keep a tail pointer, a large workload would make push_node quadratic
+        if(tail == NULL){
+            new_list = node;
+        } else {
+            tail->next = node;
+        }
+        tail = node;
+    }
+
+    free(row);
+    fclose(f);
+    burst_pool_free();
+    return new_list;
+}
+
+/* FUNCTION DESCRIPTION: read_groups_from_file
+* Parse the optional group CSV file, with one row per group: Group,Parent Group,Weight
+* It overrides the parents given in the process file
+* The return value is 0 on success, -1 if the file cannot be opened
+*/
+int read_groups_from_file(char *groups_file){
+    char *row = NULL, *field;
+    size_t size = 0;
+    group_t g;
+    int parent_id, weight;
+    long long group_id;
+
+    FILE* f = fopen(groups_file, "r");
+    if(f == NULL){
+        perror("Cannot open the group file");
+        return -1;
+    }
+    //Group,Parent Group,Weight
+    if(getline(&row, &size, f) == -1){
+        free(row);
+        fclose(f);
+        return 0;
+    }
+    while(getline(&row, &size, f) != -1){
+        if(strlen(row)<3) continue;
+        field = strtok(row, ",");
+        if(field == NULL || sim_parse_field(field, "Group", 0, INT_MAX, &group_id) != 0) continue;
+        if(next_token("Parent Group", 0, &parent_id) != 0 || next_token("Weight", DEFAULT_WEIGHT, &weight) != 0) continue;
+        if(group_id == 0) continue;
+        g = find_group((int) group_id);
+        g->parent_id = parent_id;
+        g->weight = (weight > 0) ? weight : DEFAULT_WEIGHT;
+    }
+
+    free(row);
+    fclose(f);
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: enqueue_entity
+* Adds an entity to the run queue of a group in O(log n). An entity that slept cannot keep a virtual
+* runtime older than the group, otherwise it would monopolize the CPU to catch up.
+*/
+void enqueue_entity(group_t g, struct entity *se){
+    se->vruntime = max(se->vruntime, g->min_vruntime);
+    se->on_queue = true;
+    heap_push(g->queue, se->vruntime, se);
+}
+
+/* FUNCTION DESCRIPTION: make_ready
+* Adds a process to the run queue of its group, then enqueues every ancestor group that was not
+* runnable yet. It stops at the first ancestor already queued or on the path of the running process,
+* so the cost is O(depth * log n).
+*/
+void make_ready(node_t node){
+    group_t g = node->p->se.parent;
+
+    node->p->s = STATE_READY;
+    enqueue_entity(g, &node->p->se);
+    while(g != groups.root && !g->se.on_queue && !g->se.current){
+        enqueue_entity(g->parent, &g->se);
+        g = g->parent;
+    }
+}
+
+/* FUNCTION DESCRIPTION: pick_next
+* Descends from the root, taking the entity with the smallest virtual runtime at every level,
+* until it reaches a process. The entities on the way are marked current.
+* The return value is the node of the process, or NULL if nothing is runnable
+*/
+node_t pick_next(void){
+    group_t g = groups.root;
+    struct entity *se;
+
+    if(heap_empty(g->queue)) return NULL;
+    for(;;){
+        se = (struct entity *) heap_pop(g->queue);
+        se->on_queue = false;
+        se->current = true;
+        g->min_vruntime = max(g->min_vruntime, se->vruntime);
+        if(se->group == NULL) return se->node;
+        g = se->group;
+    }
+}
+
+/* FUNCTION DESCRIPTION: put_prev
+* Takes the running process off the CPU. It goes back to the run queue of its group if it is still
+* runnable, and every group on its path goes back to its parent queue if it still has runnable children.
+*/
+void put_prev(node_t running, bool runnable){
+    group_t g = running->p->se.parent;
+
+    running->p->se.current = false;
+    if(runnable) enqueue_entity(g, &running->p->se);
+    while(g != groups.root){
+        g->se.current = false;
+        if(!heap_empty(g->queue)) enqueue_entity(g->parent, &g->se);
+        g = g->parent;
+    }
+}
+
+/* FUNCTION DESCRIPTION: charge
+* Charges the time the process ran to its virtual runtime and to every group on its path,
+* in inverse proportion to their weights
+*/
+void charge(node_t running, int time){
+    struct entity *se = &running->p->se;
+    long long delta = (long long) time * VRUNTIME_SCALE;
+
+    se->vruntime += delta * DEFAULT_WEIGHT / se->weight;
+    for(group_t g = se->parent; g != groups.root; g = g->parent){
+        g->se.vruntime += delta * DEFAULT_WEIGHT / g->se.weight;
+        g->cpu_time += time;
+    }
+    groups.root->cpu_time += time;
+}
+
+/* FUNCTION DESCRIPTION: get_time_to_next_event
+* This function returns the amount of simulation time until the next event occurs
+* The parameters are:
+*    - cpu_clock: Time since the start of the simulation
+*    - running: The node containing the currently running process
+*    - slice_used: how much of its time slice the running process used
+*    - arrivals: The heap of the processes that have yet to arrive, on their arrival time
+*    - waiting: The heap of the processes that are waiting for io, on the time it completes
+* The return value is the time until the next event
+*/
+sim_time_t get_time_to_next_event(sim_time_t cpu_clock, node_t running, int slice_used, heap_t arrivals, heap_t waiting){
+    sim_time_t next_exit=SIM_TIME_MAX, next_block=SIM_TIME_MAX, next_arrival=SIM_TIME_MAX, next_io=SIM_TIME_MAX;
+
+    if(running != NULL){
+        next_exit = min(running->p->cpu_time_remaining, TIME_SLICE - slice_used);
+        next_block = running->p->io_time_remaining;
+    }
+
+    // The tops of the heaps are the next arrival and the next io completion
+    if(!heap_empty(arrivals)) next_arrival = heap_peek_key(arrivals) - cpu_clock;
+    if(!heap_empty(waiting)) next_io = heap_peek_key(waiting) - cpu_clock;
+
+    sim_time_t min_time = min(min(next_exit, next_block), min(next_arrival, next_io));
+    return (min_time == 0) ? 1 : min_time;
+}
+
+/* FUNCTION DESCRIPTION: print_transition
+* Prints one state transition in the output format shared by all the simulators
+*/
+void print_transition(sim_time_t cpu_clock, proc_t p, enum STATE old_state, enum STATE new_state){
+    printf("%lld,%lld,%s,%s\n", cpu_clock, p->pid, STATES[old_state], STATES[new_state]);
+}
+
+/* FUNCTION DESCRIPTION: dispatch
+* Picks the next process through the group hierarchy and runs it
+* The return value is the new running node, or NULL if the CPU is idle
+*/
+node_t dispatch(sim_time_t cpu_clock, int verbose){
+    node_t running = pick_next();
+
+    if(running != NULL){
+        running->p->s = STATE_RUNNING;
+        print_transition(cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+    } else {
+        if(verbose) printf("%lld: CPU is idle\n", cpu_clock);
+    }
+    return running;
+}
+
+/* FUNCTION DESCRIPTION: print_group_report
+* Prints the CPU time received by every group and its share of the CPU time of its parent, on stderr
+* The expected share is the weight of the group over the weights of its siblings, it is only reached
+* when the siblings are runnable all the time.
+*/
+void print_group_report(void){
+    group_t g;
+
+    fprintf(stderr, "Group report, %lldms of CPU time:\n", groups.root->cpu_time);
+    fprintf(stderr, "Group,Parent Group,Weight,Processes,CPU time,Share of parent\n");
+    for(g = groups.all; g != NULL; g = g->all_next){
+        if(g == groups.root){
+            fprintf(stderr, "%d,-,-,%d,%lldms,-\n", g->id, g->num_processes, g->cpu_time);
+        } else {
+            fprintf(stderr, "%d,%d,%d,%d,%lldms,%.2f%%\n", g->id, g->parent->id, g->weight, g->num_processes,
+                g->cpu_time, (g->parent->cpu_time > 0) ? 100.0 * g->cpu_time / g->parent->cpu_time : 0.0);
+        }
+    }
+}
+
+/* FUNCTION DESCRIPTION: clean_up
+* This function frees all the dynamically allocated heap memory
+* The parameters are:
+*    - list: the list of nodes to free
+*/
+void clean_up(node_t list){
+    node_t temp;
+    group_t g;
+    while(list != NULL){
+        temp = list;
+        list = list->next;
+        burst_free(&temp->p->cpu_bursts);
+        burst_free(&temp->p->io_bursts);
+        free(temp->p);
+        free(temp);
+    }
+    while(groups.all != NULL){
+        g = groups.all;
+        groups.all = g->all_next;
+        heap_free(g->queue);
+        free(g);
+    }
+}
+
+int main( int argc, char *argv[]) {
+    sim_time_t next_step = 0, cpu_clock = 0;
+    int slice_used = 0;
+    bool simulation_completed = false;
+    node_t new_list = NULL, terminated = NULL, terminated_tail = NULL, temp, node, next;
+    node_t running = NULL;
+    heap_t arrivals, waiting;
+    char *input_file;
+    int verbose;
+
+    if(argc >= 2 && argc <= 4){
+        input_file = argv[1];
+        verbose = (argc >= 3) ? atoi(argv[2]) : 0;
+    } else {
+        printf("Usage: %s <input_file.csv> [verbose] [groups.csv]\n", argv[0]);
+        return -1;
+    }
+
+    // The root group always exists, with id 0
+    groups.root = find_group(0);
+
+    // Process meta data should be read from a text file
+    if(verbose) printf("------------------------------- Loading all processes -------------------------------\n");
+    new_list = read_proc_from_file(input_file);
+    if(argc == 4 && read_groups_from_file(argv[3]) != 0) return -1;
+    link_groups();
+    if(verbose) print_nodes(new_list, cpu_clock);
+    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(verbose) printf("Starting simulation...\n");
+
+    // The processes arriving at the same time come out of the heap in the order of the file
+    arrivals = heap_create(64);
+    waiting = heap_create(64);
+    for(node = new_list; node != NULL; node = temp){
+        temp = node->next;
+        node->next = NULL;
+        heap_push(arrivals, node->p->arrival_time, node);
+    }
+
+    // print the headers
+    printf("Time of transition,PID,Old State,New State\n");
+    // Simulation loop
+    do {
+        // Advance the cpu clock time
+        cpu_clock += next_step;
+        // The processes whose io completed are ready, in the order they blocked
+        while(!heap_empty(waiting) && heap_peek_key(waiting) <= cpu_clock){
+            node = (node_t) heap_pop(waiting);
+            // Update the time of next io event to its next CPU burst
+            node->p->burst++;
+            node->p->io_time_remaining = burst_at(&node->p->cpu_bursts, node->p->burst, node->p->io_frequency);
+            make_ready(node);
+            print_transition(cpu_clock, node->p, STATE_WAITING, STATE_READY);
+        }
+
+        // The processes that arrived are ready, in the order of the file
+        while(!heap_empty(arrivals) && heap_peek_key(arrivals) <= cpu_clock){
+            node = (node_t) heap_pop(arrivals);
+            make_ready(node);
+            print_transition(cpu_clock, node->p, STATE_NEW, STATE_READY);
+        }
+
+        // Make sure the CPU is running a process
+        if(running == NULL){
+            running = dispatch(cpu_clock, verbose);
+            slice_used = 0;
+        } else {
+            // Remove the time step from remaining time until process completetion and next io event
+            running->p->cpu_time_remaining -= (int) next_step;
+            running->p->io_time_remaining -= (int) next_step;
+            charge(running, (int) next_step);
+            slice_used += (int) next_step;
+
+            if(running->p->cpu_time_remaining <= 0){
+                // The process is finished running, terminate it
+                running->p->s = STATE_TERMINATED;
+                put_prev(running, false);
+                if(terminated_tail == NULL){
+                    terminated = running;
+                } else {
+                    terminated_tail->next = running;
+                }
+                terminated_tail = running;
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_TERMINATED);
+
+                running = dispatch(cpu_clock, verbose);
+                slice_used = 0;
+            } else if(running->p->io_time_remaining <= 0){
+                // The process is blocked by io, update the timer and set state to waiting
+                // An io of 0ms still completes at the next step, 1ms later
+                running->p->io_time_remaining = burst_at(&running->p->io_bursts, running->p->burst, running->p->io_duration);
+                running->p->io_done = cpu_clock + running->p->io_time_remaining;
+                running->p->s = STATE_WAITING;
+                put_prev(running, false);
+                heap_push(waiting, cpu_clock + max(running->p->io_time_remaining, 1), running);
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_WAITING);
+
+                running = dispatch(cpu_clock, verbose);
+                slice_used = 0;
+            } else if(slice_used >= TIME_SLICE){
+                // The process used its time slice, the hierarchy decides who runs next
+                // It keeps the CPU without a transition if it is still the fairest choice
+                put_prev(running, true);
+                next = pick_next();
+                if(next != running){
+                    print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_READY);
+                    running->p->s = STATE_READY;
+                    next->p->s = STATE_RUNNING;
+                    print_transition(cpu_clock, next->p, STATE_READY, STATE_RUNNING);
+                    running = next;
+                }
+                slice_used = 0;
+            }
+        }
+
+        // Set the simulation time advance
+        next_step = get_time_to_next_event(cpu_clock, running, slice_used, arrivals, waiting);
+
+        if(verbose){
+            printf("-------------------------------------------------------------------------------------\n");
+            printf("At CPU time %lldms...\n", cpu_clock);
+            printf("-------------------------------\n");
+            printf("The CPU is currently running:\n");
+            print_nodes(running, cpu_clock);
+            printf("-------------------------------\n");
+            printf("The new process list is:\n");
+            print_heap(arrivals, cpu_clock);
+            printf("-------------------------------\n");
+            printf("The root run queue holds %d entities\n", groups.root->queue->size);
+            printf("-------------------------------\n");
+            printf("The waiting list is:\n");
+            print_heap(waiting, cpu_clock);
+            printf("-------------------------------\n");
+            printf("The terminated list is:\n");
+            print_nodes(terminated, cpu_clock);
+            printf("-------------------------------------------------------------------------------------\n");
+        }
+
+        // The simulation is completed when all the queues are empty, in otherwords, all programs have run to completion
+        simulation_completed = heap_empty(groups.root->queue) && heap_empty(arrivals) && heap_empty(waiting) && (running == NULL);
+    } while(!simulation_completed);
+    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(verbose) printf("Simulation completed in %lld ms.\n", cpu_clock);
+
+    print_group_report();
+
+    // The simulation is done, all the nodes are in the terminated list, free them
+    heap_free(arrivals);
+    heap_free(waiting);
+    clean_up(terminated);
+    return 0;
+}
@@ -0,0 +1,281 @@
+/*****************************************************
+* I/O devices shared by the simulators               *
+******************************************************
+* Without devices every process waiting for I/O is   *
+* served at once. With devices a process blocks on   *
+* the device PID % number of devices, which serves   *
+* at most "concurrency" requests at the same time    *
+* and queues the others, first in first out or like  *
+* an elevator (SCAN) over the block of the request.  *
+* The requests in service are kept in a heap on      *
+* their completion time.                             *
+******************************************************/
+
+#ifndef IO_DEVICE_H
+#define IO_DEVICE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "minHeap.h"
+#include "simTime.h"
+
+enum DISCIPLINE {
+    DISCIPLINE_FIFO,
+    DISCIPLINE_SCAN
+};
+static const char *DISCIPLINES[] = { "fifo", "scan" };
+
+// One I/O request. The simulators embed it in their process structure since a process
+// has at most one request at a time. The block is the position on the device used by SCAN,
+// the simulators use the PID so that the order is reproducible.
+struct io_request {
+    void *owner;
+    int device;
+    sim_pid_t block;
+    int duration;
+    sim_time_t submit_time;
+    sim_time_t completion_time;
+};
+
+// A device. For SCAN, up holds the pending requests at or after the head, down the ones before it
+// (keyed on minus the block). FIFO only uses up, with the same key for every request.
+struct io_device {
+    char name[32];
+    int concurrency;
+    enum DISCIPLINE discipline;
+    int in_service;
+    sim_pid_t head;
+    int going_up;
+    heap_t up;
+    heap_t down;
+    // statistics
+    sim_time_t last_update;
+    long long busy_time;
+    long long completed;
+    long long total_queue_delay;
+    long long total_service_time;
+    long long max_queue_delay;
+    int max_queue_length;
+};
+
+struct io_system {
+    struct io_device *devices;
+    int count;
+    int outstanding;
+    heap_t completions;
+};
+
+typedef struct io_system *io_system_t;
+
+/* FUNCTION DESCRIPTION: io_system_load
+* Parse the device CSV file, with one row per device: Device,Concurrency,Discipline
+* where the discipline is fifo or scan
+* The parameters are:
+*    -device_file, the name of the CSV file
+* The return value is the I/O system, or NULL if the file cannot be read or has no device
+*/
+static inline io_system_t io_system_load(const char *device_file){
+    char row[128], *name, *token;
+    io_system_t sys;
+    struct io_device *d;
+    int capacity = 4;
+
+    FILE *f = fopen(device_file, "r");
+    if(f == NULL){
+        perror("Cannot open the device file");
+        return NULL;
+    }
+
+    sys = (io_system_t) malloc(sizeof(struct io_system));
+    assert(sys != NULL);
+    sys->devices = (struct io_device *) calloc(capacity, sizeof(struct io_device));
+    assert(sys->devices != NULL);
+    sys->count = 0;
+    sys->outstanding = 0;
+    sys->completions = heap_create(64);
+
+    //Device,Concurrency,Discipline
+    fgets(row, sizeof(row), f);
+    while(fgets(row, sizeof(row), f) != NULL){
+        name = strtok(row, ",\r\n");
+        if(name == NULL) continue;
+        if(sys->count == capacity){
+            capacity *= 2;
+            sys->devices = (struct io_device *) realloc(sys->devices, capacity * sizeof(struct io_device));
+            assert(sys->devices != NULL);
+        }
+        d = &sys->devices[sys->count++];
+        memset(d, 0, sizeof(struct io_device));
+        snprintf(d->name, sizeof(d->name), "%s", name);
+        token = strtok(NULL, ",\r\n");
+        d->concurrency = (token != NULL && atoi(token) > 0) ? atoi(token) : 1;
+        token = strtok(NULL, ",\r\n ");
+        d->discipline = (token != NULL && strcmp(token, "scan") == 0) ? DISCIPLINE_SCAN : DISCIPLINE_FIFO;
+        d->going_up = 1;
+        d->up = heap_create(16);
+        d->down = heap_create(16);
+    }
+    fclose(f);
+
+    if(sys->count == 0){
+        fprintf(stderr, "The device file has no device\n");
+        heap_free(sys->completions);
+        free(sys->devices);
+        free(sys);
+        return NULL;
+    }
+    return sys;
+}
+
+// Accumulates the busy time of a device up to now, before the number of requests in service changes
+static inline void io_update_busy(struct io_device *d, sim_time_t now){
+    d->busy_time += (long long) d->in_service * (now - d->last_update);
+    d->last_update = now;
+}
+
+// Puts a request in service on its device, it completes duration ms from now
+static inline void io_start(io_system_t sys, struct io_device *d, struct io_request *req, sim_time_t now){
+    long long delay = now - req->submit_time;
+
+    io_update_busy(d, now);
+    d->in_service++;
+    d->head = req->block;
+    d->total_queue_delay += delay;
+    if(delay > d->max_queue_delay) d->max_queue_delay = delay;
+    req->completion_time = now + req->duration;
+    heap_push(sys->completions, req->completion_time, req);
+}
+
+// Takes the next pending request of a device according to its discipline, or NULL if there is none
+static inline struct io_request *io_next_pending(struct io_device *d){
+    if(d->discipline == DISCIPLINE_SCAN){
+        // Keep going in the same direction while there are requests that way, then turn around
+        if(d->going_up && heap_empty(d->up)) d->going_up = 0;
+        if(!d->going_up && heap_empty(d->down)) d->going_up = 1;
+        return (struct io_request *) heap_pop(d->going_up ? d->up : d->down);
+    }
+    return (struct io_request *) heap_pop(d->up);
+}
+
+/* FUNCTION DESCRIPTION: io_submit
+* Submits the I/O request of a process blocking at time now. It starts right away if its device has
+* a free slot, otherwise it waits in the queue of the device.
+* The parameters are:
+*    -sys, the I/O system
+*    -req, the request embedded in the process
+*    -owner, the process (or its node) given back when the request completes
+*    -pid, selects the device and is the block of the request
+*    -duration, the service time of the request
+*    -now, the current time
+*/
+static inline void io_submit(io_system_t sys, struct io_request *req, void *owner, sim_pid_t pid, int duration, sim_time_t now){
+    struct io_device *d;
+    int queued;
+
+    req->owner = owner;
+    req->device = (int) (((pid % sys->count) + sys->count) % sys->count);
+    req->block = pid;
+    req->duration = duration;
+    req->submit_time = now;
+    sys->outstanding++;
+
+    d = &sys->devices[req->device];
+    if(d->in_service < d->concurrency){
+        io_start(sys, d, req, now);
+        return;
+    }
+
+    if(d->discipline == DISCIPLINE_FIFO){
+        heap_push(d->up, 0, req);
+    } else if(d->going_up ? (req->block >= d->head) : (req->block > d->head)){
+        heap_push(d->up, req->block, req);
+    } else {
+        heap_push(d->down, -(long long) req->block, req);
+    }
+    queued = d->up->size + d->down->size;
+    if(queued > d->max_queue_length) d->max_queue_length = queued;
+}
+
+/* FUNCTION DESCRIPTION: io_next_completion
+* The return value is the time of the next I/O completion, SIM_TIME_MAX if no request is in service
+*/
+static inline sim_time_t io_next_completion(io_system_t sys){
+    if(sys == NULL || heap_empty(sys->completions)) return SIM_TIME_MAX;
+    return heap_peek_key(sys->completions);
+}
+
+/* FUNCTION DESCRIPTION: io_complete
+* Completes one request that is done by time now and starts the next pending request of its device.
+* Call it until it returns NULL. Requests completing at the same time come out in the order they started.
+* The return value is the owner of the completed request, or NULL if no request is done
+*/
+static inline void *io_complete(io_system_t sys, sim_time_t now){
+    struct io_request *req, *next;
+    struct io_device *d;
+
+    if(sys == NULL || heap_empty(sys->completions) || heap_peek_key(sys->completions) > now) return NULL;
+
+    req = (struct io_request *) heap_pop(sys->completions);
+    d = &sys->devices[req->device];
+    io_update_busy(d, req->completion_time);
+    d->in_service--;
+    d->completed++;
+    d->total_service_time += req->duration;
+    sys->outstanding--;
+
+    next = io_next_pending(d);
+    if(next != NULL) io_start(sys, d, next, req->completion_time);
+    return req->owner;
+}
+
+// True when no request is in service or queued
+static inline int io_idle(io_system_t sys){
+    return sys == NULL || sys->outstanding == 0;
+}
+
+// The number of processes blocked on the devices, queued or in service
+static inline int io_outstanding(io_system_t sys){
+    return (sys == NULL) ? 0 : sys->outstanding;
+}
+
+/* FUNCTION DESCRIPTION: io_print_report
+* Prints the utilization and the queueing delays of every device
+* The parameters are:
+*    -sys, the I/O system
+*    -end_time, the time the simulation completed
+*    -out, where to print the report
+*/
+static inline void io_print_report(io_system_t sys, sim_time_t end_time, FILE *out){
+    struct io_device *d;
+
+    if(sys == NULL) return;
+    fprintf(out, "Device report after %lldms:\n", end_time);
+    fprintf(out, "Device,Discipline,Concurrency,Requests,Utilization,Mean queue delay,Max queue delay,Max queue length,Mean service time\n");
+    for(int i = 0; i < sys->count; i++){
+        d = &sys->devices[i];
+        io_update_busy(d, end_time);
+        fprintf(out, "%s,%s,%d,%lld,%.2f%%,%.2fms,%lldms,%d,%.2fms\n", d->name, DISCIPLINES[d->discipline], d->concurrency,
+            d->completed, (end_time > 0) ? 100.0 * d->busy_time / ((double) d->concurrency * end_time) : 0.0,
+            (d->completed > 0) ? (double) d->total_queue_delay / d->completed : 0.0, d->max_queue_delay,
+            d->max_queue_length, (d->completed > 0) ? (double) d->total_service_time / d->completed : 0.0);
+    }
+}
+
+/* FUNCTION DESCRIPTION: io_system_free
+* This function frees the I/O system. It does not free the owners of the requests.
+*/
+static inline void io_system_free(io_system_t sys){
+    if(sys == NULL) return;
+    for(int i = 0; i < sys->count; i++){
+        heap_free(sys->devices[i].up);
+        heap_free(sys->devices[i].down);
+    }
+    heap_free(sys->completions);
+    free(sys->devices);
+    free(sys);
+}
+
+#endif
@@ -0,0 +1,989 @@
+/*****************************************************
+* libkernelsim, the simulators as a library          *
+******************************************************
+* The event loop of roundRobin.c and priority.c on   *
+* a table of processes. The processes are referred   *
+* to by their index in the table and every queue is  *
+* a heap of indices:                                 *
+*    - arrivals, keyed on the arrival time           *
+*    - ready, keyed on the priority, or on 0 for the *
+*      first in first out policies                   *
+*    - waiting, keyed on the I/O completion time     *
+* A snapshot is the state as fixed size records:     *
+* a header, the process table, then the entries of   *
+* the three heaps. It can be mapped and read in      *
+* place, and a simulation resumes from it as if it   *
+* never stopped.                                     *
+* A scripted process keeps its coroutine in a table  *
+* of scripts, and its CPU burst and I/O in the same  *
+* timers as the processes of the CSV, so the loop    *
+* only resumes it where those timers run out.        *
+* Build it as a static or a shared library:          *
+*    gcc -O2 -c kernelSim.c                          *
+*    ar rcs libkernelsim.a kernelSim.o               *
+*    gcc -O2 -fPIC -shared -o libkernelsim.so        *
+*        kernelSim.c                                 *
+******************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "kernelSim.h"
+#include "minHeap.h"
+#include "switchCost.h"
+
+// Macro to return the min of a and b
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+// Same order as enum KS_STATE, for the text output
+static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATED"};
+
+// The process structure of the simulators, with what the metrics need
+// The io_time_remaining counts how long until the next io call, the waiting heap has the I/O completions
+struct ks_process {
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time;
+    int cpu_time_remaining;
+    int io_frequency;
+    int io_duration;
+    int io_time_remaining;
+    int switch_remaining;
+    struct cache_state cache;
+    sim_time_t ready_since;
+    sim_time_t first_run;
+    sim_time_t finish_time;
+    long long ready_time;
+    unsigned long long wait_seq;
+    // the index in the table of scripts, -1 for the processes of the CSV
+    int script;
+    enum KS_STATE s;
+};
+
+// The coroutine of a scripted process and the ready time it had when it was last resumed
+struct ks_script {
+    ks_script_fn fn;
+    struct ks_coroutine co;
+    long long ready_mark;
+};
+
+// The CPU time of a scripted process until it exits is unknown, it never runs out before its requests do
+#define SCRIPT_UNBOUNDED (INT_MAX / 2)
+
+struct ks_sim {
+    struct ks_config config;
+    struct switch_model costs;
+    ks_transition_fn callback;
+    void *context;
+    // Where ks_run_output writes the transitions
+    FILE *out;
+
+    struct ks_process *procs;
+    int count;
+    int capacity;
+    heap_t arrivals;
+    heap_t ready;
+    heap_t waiting;
+    int running;
+
+    sim_time_t cpu_clock;
+    sim_time_t next_step;
+    // The progress the running process made in its time slice, the switch to it does not count
+    int slice_used;
+    int started;
+    int completed;
+    unsigned long long next_wait_seq;
+    int *woken;
+    int woken_capacity;
+
+    struct ks_script *scripts;
+    int script_count;
+    int script_capacity;
+    // The children spawned by the last resumes, started once their parent went on
+    int *spawned;
+    int spawned_count;
+    int spawned_capacity;
+    sim_pid_t next_pid;
+
+    // statistics
+    long long transitions;
+    long long dispatches;
+    long long busy_time;
+    sim_time_t max_wait;
+    sim_pid_t max_wait_pid;
+};
+
+// The heaps store indices in the process table
+#define INDEX(item) ((int) (intptr_t) (item))
+#define ITEM(index) ((void *) (intptr_t) (index))
+
+void ks_config_default(struct ks_config *config){
+    config->policy = KS_ROUND_ROBIN;
+    config->time_slice = 3;
+    config->aging_interval = 0;
+    config->switch_cost = 0;
+    config->cache_penalty = 0;
+    config->cache_decay = 0;
+    config->migration_penalty = 0;
+}
+
+ks_sim_t *ks_create(void){
+    ks_sim_t *sim = (ks_sim_t *) calloc(1, sizeof(struct ks_sim));
+    if(sim == NULL) return NULL;
+
+    ks_config_default(&sim->config);
+    switch_model_init(&sim->costs);
+    sim->capacity = 64;
+    sim->procs = (struct ks_process *) malloc(sim->capacity * sizeof(struct ks_process));
+    sim->woken_capacity = 64;
+    sim->woken = (int *) malloc(sim->woken_capacity * sizeof(int));
+    if(sim->procs == NULL || sim->woken == NULL){
+        free(sim->procs);
+        free(sim->woken);
+        free(sim);
+        return NULL;
+    }
+    sim->arrivals = heap_create(64);
+    sim->ready = heap_create(64);
+    sim->waiting = heap_create(64);
+    sim->running = -1;
+    sim->max_wait_pid = -1;
+    return sim;
+}
+
+int ks_configure(ks_sim_t *sim, const struct ks_config *config){
+    if(sim == NULL || config == NULL) return KS_ERROR_ARGUMENT;
+    if(sim->started) return KS_ERROR_STARTED;
+    if(config->policy < KS_FCFS || config->policy > KS_PRIORITY || config->time_slice < 0 || config->aging_interval < 0
+        || (config->policy == KS_ROUND_ROBIN && config->time_slice == 0)
+        || config->switch_cost < 0 || config->cache_penalty < 0 || config->cache_decay < 0 || config->migration_penalty < 0){
+        return KS_ERROR_ARGUMENT;
+    }
+    sim->config = *config;
+    switch_model_init(&sim->costs);
+    sim->costs.switch_cost = config->switch_cost;
+    sim->costs.cache_penalty = config->cache_penalty;
+    sim->costs.cache_decay = config->cache_decay;
+    sim->costs.migration_penalty = config->migration_penalty;
+    return KS_OK;
+}
+
+void ks_set_transition_callback(ks_sim_t *sim, ks_transition_fn callback, void *context){
+    sim->callback = callback;
+    sim->context = context;
+}
+
+// Adds a process to the table, the caller queues it
+// The return value is its index, or -1 if there is no memory
+static int new_process(ks_sim_t *sim, sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration){
+    struct ks_process *p;
+
+    if(sim->count == sim->capacity){
+        p = (struct ks_process *) realloc(sim->procs, 2 * sim->capacity * sizeof(struct ks_process));
+        if(p == NULL) return -1;
+        sim->procs = p;
+        sim->capacity *= 2;
+    }
+
+    // Initialize contents like create_proc
+    p = &sim->procs[sim->count];
+    memset(p, 0, sizeof(struct ks_process));
+    p->pid = pid;
+    p->arrival_time = arrival_time;
+    p->total_cpu_time = total_cpu_time;
+    p->cpu_time_remaining = total_cpu_time;
+    p->io_frequency = io_frequency;
+    p->io_duration = io_duration;
+    p->io_time_remaining = io_frequency;
+    cache_state_init(&p->cache);
+    p->first_run = -1;
+    p->finish_time = -1;
+    p->s = KS_NEW;
+    p->script = -1;
+    if(pid >= sim->next_pid) sim->next_pid = (pid < LLONG_MAX) ? pid + 1 : pid;
+    return sim->count++;
+}
+
+// Gives a process of the table a script, it has no CPU time or I/O of its own until the first resume sets them
+// The return value is 0, or -1 if there is no memory
+static int attach_script(ks_sim_t *sim, int index, ks_script_fn fn, void *arg){
+    struct ks_script *scripts, *script;
+    int capacity;
+
+    if(sim->script_count == sim->script_capacity){
+        capacity = (sim->script_capacity > 0) ? 2 * sim->script_capacity : 64;
+        scripts = (struct ks_script *) realloc(sim->scripts, capacity * sizeof(struct ks_script));
+        if(scripts == NULL) return -1;
+        sim->scripts = scripts;
+        sim->script_capacity = capacity;
+    }
+    script = &sim->scripts[sim->script_count];
+    memset(script, 0, sizeof(struct ks_script));
+    script->fn = fn;
+    script->co.pid = sim->procs[index].pid;
+    script->co.arg = arg;
+    script->co.spawned = -1;
+    sim->procs[index].cpu_time_remaining = SCRIPT_UNBOUNDED;
+    sim->procs[index].script = sim->script_count++;
+    return 0;
+}
+
+// Queues a process of the table for its arrival
+static void queue_arrival(ks_sim_t *sim, int index){
+    sim_time_t arrival_time = sim->procs[index].arrival_time;
+
+    heap_push(sim->arrivals, arrival_time, ITEM(index));
+    if(sim->started){
+        sim->next_step = sim->completed ? arrival_time - sim->cpu_clock : min(sim->next_step, arrival_time - sim->cpu_clock);
+        sim->completed = 0;
+    }
+}
+
+int ks_add_process(ks_sim_t *sim, sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration){
+    int index;
+
+    if(sim == NULL) return KS_ERROR_ARGUMENT;
+    // A process arrives, runs for some time and does I/O of some length, or none with a frequency of 0
+    // -1 is no process for the transitions, so a PID cannot be negative
+    // The clock adds durations to the arrival times, SIM_TIME_LIMIT leaves room for them
+    if(pid < 0 || arrival_time < 0 || arrival_time > SIM_TIME_LIMIT || total_cpu_time <= 0 || io_frequency < 0 || io_duration < 0){
+        return KS_ERROR_ARGUMENT;
+    }
+    // Once started, the arrivals at the current time have already been handled
+    if(sim->started && arrival_time <= sim->cpu_clock) return KS_ERROR_STARTED;
+    index = new_process(sim, pid, arrival_time, total_cpu_time, io_frequency, io_duration);
+    if(index < 0) return KS_ERROR_ARGUMENT;
+    queue_arrival(sim, index);
+    return KS_OK;
+}
+
+int ks_add_script(ks_sim_t *sim, sim_pid_t pid, sim_time_t arrival_time, ks_script_fn script, void *arg){
+    int index;
+
+    if(sim == NULL || script == NULL || pid < 0 || arrival_time < 0 || arrival_time > SIM_TIME_LIMIT) return KS_ERROR_ARGUMENT;
+    if(sim->started && arrival_time <= sim->cpu_clock) return KS_ERROR_STARTED;
+    index = new_process(sim, pid, arrival_time, 0, 0, 0);
+    if(index < 0) return KS_ERROR_ARGUMENT;
+    if(attach_script(sim, index, script, arg) != 0){
+        sim->count--;
+        return KS_ERROR_ARGUMENT;
+    }
+    queue_arrival(sim, index);
+    return KS_OK;
+}
+
+int ks_load_csv(ks_sim_t *sim, const char *input_file){
+    char *row = NULL, *save, *fields[5];
+    size_t size = 0;
+    int valid, result = KS_OK;
+    long long columns[5];
+    // The ranges of the simulators, the PID, the arrival time and then durations (see simTime.h)
+    const long long highs[5] = { LLONG_MAX, SIM_TIME_LIMIT, SIM_DURATION_MAX, SIM_DURATION_MAX, SIM_DURATION_MAX };
+
+    if(sim == NULL || input_file == NULL) return KS_ERROR_ARGUMENT;
+    FILE *f = fopen(input_file, "r");
+    if(f == NULL) return KS_ERROR_FILE;
+
+    // Get the first row, which has the header values
+    //Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration
+    // getline reads the rows whole, however long their burst sequences are
+    if(getline(&row, &size, f) == -1){
+        free(row);
+        fclose(f);
+        return KS_OK;
+    }
+    while(result == KS_OK && getline(&row, &size, f) != -1){
+        // make sure it has at least enough char to be valid
+        if(strlen(row) < 10) continue;
+        // strtok_r so that simulations can load on different threads
+        valid = 1;
+        for(int i = 0; i < 5; i++){
+            fields[i] = strtok_r((i == 0) ? row : NULL, ",", &save);
+            if(fields[i] == NULL) valid = 0;
+            if(!valid) break;
+        }
+        if(!valid) continue;
+        // A process has one CPU burst and one I/O duration, a row with burst sequences cannot be simulated
+        if(strchr(fields[3], ';') != NULL || strchr(fields[4], ';') != NULL) result = KS_ERROR_ARGUMENT;
+        for(int i = 0; i < 5 && result == KS_OK; i++){
+            if(sim_parse_number(fields[i], 0, highs[i], &columns[i]) != 0) result = KS_ERROR_ARGUMENT;
+        }
+        if(result == KS_OK){
+            result = ks_add_process(sim, columns[0], columns[1], (int) columns[2], (int) columns[3], (int) columns[4]);
+        }
+    }
+    free(row);
+    fclose(f);
+    return result;
+}
+
+// The transitions go to the callback in the generic loop of ks_step
+#define OUTPUT_CALLBACK (KS_OUTPUT_BINARY + 1)
+
+// The functions of the loop are inlined into every specialized copy, where their policy and output
+// parameters are constants that remove the branches on them
+#if defined(__GNUC__)
+#define SPECIALIZED static inline __attribute__((always_inline))
+#else
+#define SPECIALIZED static inline
+#endif
+
+// Reports a transition to the caller or writes it, and changes the state of the process
+SPECIALIZED void transition(ks_sim_t *sim, int output, int index, enum KS_STATE new_state){
+    struct ks_process *p = &sim->procs[index];
+    struct ks_transition_record record;
+
+    sim->transitions++;
+    if(output == OUTPUT_CALLBACK){
+        if(sim->callback != NULL) sim->callback(sim->context, sim->cpu_clock, p->pid, p->s, new_state);
+    } else if(output == KS_OUTPUT_TEXT){
+        fprintf(sim->out, "%lld,%lld,%s,%s\n", sim->cpu_clock, p->pid, STATES[p->s], STATES[new_state]);
+    } else if(output == KS_OUTPUT_BINARY){
+        record.time = sim->cpu_clock;
+        record.pid = p->pid;
+        record.old_state = (uint8_t) p->s;
+        record.new_state = (uint8_t) new_state;
+        memset(record.pad, 0, sizeof(record.pad));
+        fwrite(&record, sizeof(record), 1, sim->out);
+    }
+    p->s = new_state;
+}
+
+// The key of a process in the ready heap, see make_ready in priority.c for the aging key
+SPECIALIZED long long ready_key(const ks_sim_t *sim, enum KS_POLICY policy, const struct ks_process *p){
+    long long key = 0;
+
+    if(policy == KS_PRIORITY){
+        key = p->total_cpu_time;
+        if(sim->config.aging_interval > 0) key = key * sim->config.aging_interval + p->ready_since;
+    }
+    return key;
+}
+
+// Adds a process to the ready heap
+SPECIALIZED void make_ready(ks_sim_t *sim, enum KS_POLICY policy, int output, int index){
+    struct ks_process *p = &sim->procs[index];
+
+    p->ready_since = sim->cpu_clock;
+    transition(sim, output, index, KS_READY);
+    heap_push(sim->ready, ready_key(sim, policy, p), ITEM(index));
+}
+
+// Runs the next ready process, or leaves the CPU idle if there is none
+SPECIALIZED void dispatch(ks_sim_t *sim, int output){
+    struct ks_process *p;
+    sim_time_t wait;
+
+    if(heap_empty(sim->ready)){
+        sim->running = -1;
+        return;
+    }
+    sim->running = INDEX(heap_pop(sim->ready));
+    p = &sim->procs[sim->running];
+    p->switch_remaining = switch_dispatch(&sim->costs, &p->cache, p->pid, 0, sim->cpu_clock);
+    wait = sim->cpu_clock - p->ready_since;
+    p->ready_time += wait;
+    if(wait > sim->max_wait){
+        sim->max_wait = wait;
+        sim->max_wait_pid = p->pid;
+    }
+    if(p->first_run < 0) p->first_run = sim->cpu_clock;
+    sim->slice_used = 0;
+    sim->dispatches++;
+    transition(sim, output, sim->running, KS_RUNNING);
+}
+
+// Blocks a process until its I/O completes, a scripted process asking for more I/O stays waiting
+SPECIALIZED void block(ks_sim_t *sim, int output, int index){
+    struct ks_process *p = &sim->procs[index];
+
+    p->io_time_remaining = p->io_duration;
+    if(p->s == KS_RUNNING) switch_leave(&p->cache, 0, sim->cpu_clock);
+    p->wait_seq = sim->next_wait_seq++;
+    heap_push(sim->waiting, (long long) sim->cpu_clock + p->io_duration, ITEM(index));
+    if(p->s != KS_WAITING) transition(sim, output, index, KS_WAITING);
+}
+
+// Terminates a process, a scripted process can exit without running again
+SPECIALIZED void terminate(ks_sim_t *sim, int output, int index){
+    struct ks_process *p = &sim->procs[index];
+
+    if(p->s == KS_RUNNING) switch_leave(&p->cache, 0, sim->cpu_clock);
+    p->finish_time = sim->cpu_clock;
+    transition(sim, output, index, KS_TERMINATED);
+}
+
+/* FUNCTION DESCRIPTION: resume_script
+* Resumes the coroutine of a scripted process until it asks for CPU time, I/O or exits, and sets its timers so
+* that the loop handles the request like the CSV columns: a CPU burst is the time to its next I/O, I/O is
+* a burst that just ended and an exit leaves no CPU time. The children it spawns are added to the table and
+* listed for start_spawned, which starts them once the parent went on.
+*/
+static void resume_script(ks_sim_t *sim, int index){
+    struct ks_request request;
+    struct ks_script *script;
+    struct ks_process *p;
+    int child;
+
+    for(;;){
+        // Spawning grows the tables, the pointers are taken again every time
+        p = &sim->procs[index];
+        script = &sim->scripts[p->script];
+        script->co.now = sim->cpu_clock;
+        script->co.ready_wait = p->ready_time - script->ready_mark;
+        script->ready_mark = p->ready_time;
+        request.type = KS_REQUEST_EXIT;
+        request.duration = 0;
+        request.script = NULL;
+        request.arg = NULL;
+        script->fn(&script->co, &request);
+        if(request.type != KS_REQUEST_SPAWN) break;
+
+        child = -1;
+        if(request.script != NULL){
+            child = new_process(sim, sim->next_pid, sim->cpu_clock, 0, 0, 0);
+            if(child >= 0 && attach_script(sim, child, request.script, request.arg) != 0){
+                sim->count--;
+                child = -1;
+            }
+        }
+        // A child that cannot be created is reported to the parent as PID -1
+        sim->scripts[sim->procs[index].script].co.spawned = (child >= 0) ? sim->procs[child].pid : -1;
+        if(child < 0) continue;
+        if(sim->spawned_count == sim->spawned_capacity){
+            sim->spawned_capacity = (sim->spawned_capacity > 0) ? 2 * sim->spawned_capacity : 64;
+            sim->spawned = (int *) realloc(sim->spawned, sim->spawned_capacity * sizeof(int));
+            assert(sim->spawned != NULL);
+        }
+        sim->spawned[sim->spawned_count++] = child;
+    }
+
+    p = &sim->procs[index];
+    p->cpu_time_remaining = SCRIPT_UNBOUNDED;
+    if(request.type == KS_REQUEST_CPU){
+        // The burst is also the key of the priority policy
+        p->total_cpu_time = (request.duration < 1) ? 1 : min(request.duration, SCRIPT_UNBOUNDED - 1);
+        p->io_time_remaining = p->total_cpu_time;
+    } else if(request.type == KS_REQUEST_IO){
+        p->io_duration = (request.duration < 0) ? 0 : request.duration;
+        p->io_time_remaining = 0;
+    } else {
+        p->cpu_time_remaining = 0;
+    }
+}
+
+// Resumes a scripted process that is not running (it arrives or its I/O completed) and queues it for its request
+SPECIALIZED void run_script(ks_sim_t *sim, enum KS_POLICY policy, int output, int index){
+    struct ks_process *p;
+
+    resume_script(sim, index);
+    p = &sim->procs[index];
+    if(p->cpu_time_remaining <= 0){
+        terminate(sim, output, index);
+    } else if(p->io_time_remaining <= 0){
+        block(sim, output, index);
+    } else {
+        make_ready(sim, policy, output, index);
+    }
+}
+
+// Starts the children spawned by the last resumes at the current time, and the children they spawn
+SPECIALIZED void start_spawned(ks_sim_t *sim, enum KS_POLICY policy, int output){
+    for(int i = 0; i < sim->spawned_count; i++) run_script(sim, policy, output, sim->spawned[i]);
+    sim->spawned_count = 0;
+}
+
+// Moves the processes whose I/O completed to the ready heap, in the order they started waiting like the waiting list
+SPECIALIZED void wake_waiting(ks_sim_t *sim, enum KS_POLICY policy, int output){
+    int count = 0, index, j;
+
+    while(!heap_empty(sim->waiting) && heap_peek_key(sim->waiting) <= sim->cpu_clock){
+        if(count == sim->woken_capacity){
+            sim->woken_capacity *= 2;
+            sim->woken = (int *) realloc(sim->woken, sim->woken_capacity * sizeof(int));
+            assert(sim->woken != NULL);
+        }
+        sim->woken[count++] = INDEX(heap_pop(sim->waiting));
+    }
+    // Completions at the same time already come out in that order, only earlier ones can be out of order
+    for(int i = 1; i < count; i++){
+        index = sim->woken[i];
+        for(j = i; j > 0 && sim->procs[sim->woken[j - 1]].wait_seq > sim->procs[index].wait_seq; j--){
+            sim->woken[j] = sim->woken[j - 1];
+        }
+        sim->woken[j] = index;
+    }
+    for(int i = 0; i < count; i++){
+        index = sim->woken[i];
+        if(sim->procs[index].script >= 0){
+            run_script(sim, policy, output, index);
+        } else {
+            sim->procs[index].io_time_remaining = sim->procs[index].io_frequency;
+            make_ready(sim, policy, output, index);
+        }
+    }
+}
+
+// The get_time_to_next_event of the simulators
+// The durations are int, their sums and the gaps to the 64 bit timestamps are computed in sim_time_t
+SPECIALIZED sim_time_t time_to_next_event(ks_sim_t *sim, enum KS_POLICY policy){
+    sim_time_t next_exit = SIM_TIME_MAX, next_block = SIM_TIME_MAX, next_arrival = SIM_TIME_MAX, next_io = SIM_TIME_MAX;
+    sim_time_t next_slice = SIM_TIME_MAX;
+    struct ks_process *p;
+
+    if(sim->running >= 0){
+        p = &sim->procs[sim->running];
+        next_exit = (sim_time_t) p->switch_remaining + p->cpu_time_remaining;
+        next_block = (sim_time_t) p->switch_remaining + p->io_time_remaining;
+        if(policy == KS_ROUND_ROBIN) next_slice = (sim_time_t) p->switch_remaining + sim->config.time_slice - sim->slice_used;
+    }
+    if(!heap_empty(sim->arrivals)) next_arrival = heap_peek_key(sim->arrivals) - sim->cpu_clock;
+    if(!heap_empty(sim->waiting)) next_io = heap_peek_key(sim->waiting) - sim->cpu_clock;
+
+    sim_time_t min_time = min(min(min(next_exit, next_block), min(next_arrival, next_io)), next_slice);
+    return (min_time <= 0) ? 1 : min_time;
+}
+
+/* FUNCTION DESCRIPTION: step
+* One step of the simulation loop, with the policy and the output as parameters
+* The return value is 1 if the simulation goes on, 0 once it is completed
+*/
+SPECIALIZED int step(ks_sim_t *sim, enum KS_POLICY policy, int output){
+    struct ks_process *p;
+    sim_time_t progress;
+    int used, index;
+
+    if(sim->completed) return 0;
+    sim->started = 1;
+
+    // Advance the cpu clock time
+    sim->cpu_clock += sim->next_step;
+    if(sim->running >= 0) sim->busy_time += sim->next_step;
+
+    wake_waiting(sim, policy, output);
+
+    // Move the processes that arrive now to the ready heap
+    while(!heap_empty(sim->arrivals) && heap_peek_key(sim->arrivals) <= sim->cpu_clock){
+        index = INDEX(heap_pop(sim->arrivals));
+        if(sim->procs[index].script >= 0){
+            run_script(sim, policy, output, index);
+        } else {
+            make_ready(sim, policy, output, index);
+        }
+    }
+    if(sim->spawned_count > 0) start_spawned(sim, policy, output);
+
+    // Make sure the CPU is running a process
+    if(sim->running < 0){
+        dispatch(sim, output);
+    } else {
+        // Remove the time step from the remaining time, the time spent switching to the process is not progress
+        p = &sim->procs[sim->running];
+        progress = sim->next_step;
+        if(p->switch_remaining > 0){
+            used = (int) min(progress, p->switch_remaining);
+            p->switch_remaining -= used;
+            progress -= used;
+        }
+        // What is left of the step after the switch ends at the next exit or block, so it fits in the int timers
+        p->cpu_time_remaining -= (int) progress;
+        p->io_time_remaining -= (int) progress;
+        sim->slice_used += (int) progress;
+
+        if(p->script >= 0 && p->io_time_remaining <= 0){
+            // The CPU burst of a scripted process ended: another burst goes on running, I/O and exit are handled below
+            resume_script(sim, sim->running);
+            if(sim->spawned_count > 0) start_spawned(sim, policy, output);
+            p = &sim->procs[sim->running];
+        }
+        if(p->cpu_time_remaining <= 0){
+            // The process is finished running, terminate it
+            terminate(sim, output, sim->running);
+            dispatch(sim, output);
+        } else if(p->io_time_remaining <= 0){
+            // The process is blocked by io until its I/O completes
+            block(sim, output, sim->running);
+            dispatch(sim, output);
+        } else if(policy == KS_ROUND_ROBIN && sim->slice_used >= sim->config.time_slice){
+            // The process used its time slice, it goes to the back of the ready queue if another process is waiting
+            if(heap_empty(sim->ready)){
+                sim->slice_used = 0;
+            } else {
+                switch_leave(&p->cache, 0, sim->cpu_clock);
+                make_ready(sim, policy, output, sim->running);
+                dispatch(sim, output);
+            }
+        }
+    }
+
+    // The simulation is completed when all the queues are empty
+    sim->completed = heap_empty(sim->ready) && heap_empty(sim->arrivals) && heap_empty(sim->waiting) && (sim->running < 0);
+    if(!sim->completed) sim->next_step = time_to_next_event(sim, policy);
+    return !sim->completed;
+}
+
+// The generic loop, the policy is read from the configuration and the transitions go to the callback
+int ks_step(ks_sim_t *sim){
+    if(sim == NULL) return KS_ERROR_ARGUMENT;
+    return step(sim, sim->config.policy, OUTPUT_CALLBACK);
+}
+
+int ks_run(ks_sim_t *sim){
+    int result;
+
+    if(sim == NULL) return KS_ERROR_ARGUMENT;
+    while((result = ks_step(sim)) > 0);
+    return result;
+}
+
+// The specialized loops, one for each policy and output
+#define SPECIALIZED_LOOPS(X) \
+    X(KS_FCFS, KS_OUTPUT_METRICS) X(KS_FCFS, KS_OUTPUT_TEXT) X(KS_FCFS, KS_OUTPUT_BINARY) \
+    X(KS_ROUND_ROBIN, KS_OUTPUT_METRICS) X(KS_ROUND_ROBIN, KS_OUTPUT_TEXT) X(KS_ROUND_ROBIN, KS_OUTPUT_BINARY) \
+    X(KS_PRIORITY, KS_OUTPUT_METRICS) X(KS_PRIORITY, KS_OUTPUT_TEXT) X(KS_PRIORITY, KS_OUTPUT_BINARY)
+
+#define DEFINE_LOOP(policy, output) \
+    static void run_##policy##_##output(ks_sim_t *sim){ \
+        while(step(sim, policy, output) > 0); \
+    }
+#define LOOP_ENTRY(policy, output) [policy][output] = run_##policy##_##output,
+
+SPECIALIZED_LOOPS(DEFINE_LOOP)
+
+static void (*const loops[KS_PRIORITY + 1][KS_OUTPUT_BINARY + 1])(ks_sim_t *) = {
+    SPECIALIZED_LOOPS(LOOP_ENTRY)
+};
+
+int ks_run_output(ks_sim_t *sim, enum KS_OUTPUT output, FILE *out){
+    if(sim == NULL || output < KS_OUTPUT_METRICS || output > KS_OUTPUT_BINARY) return KS_ERROR_ARGUMENT;
+    if(output != KS_OUTPUT_METRICS && out == NULL) return KS_ERROR_ARGUMENT;
+    // The loop is chosen once, not on every step
+    sim->out = out;
+    loops[sim->config.policy][output](sim);
+    return 0;
+}
+
+sim_time_t ks_time(const ks_sim_t *sim){
+    return sim->cpu_clock;
+}
+
+int ks_completed(const ks_sim_t *sim){
+    return sim->completed;
+}
+
+void ks_get_metrics(const ks_sim_t *sim, struct ks_metrics *metrics){
+    long long turnaround = 0, ready_time = 0, response = 0;
+    int responded = 0;
+    const struct ks_process *p;
+
+    memset(metrics, 0, sizeof(struct ks_metrics));
+    metrics->end_time = sim->cpu_clock;
+    metrics->processes = sim->count;
+    for(int i = 0; i < sim->count; i++){
+        p = &sim->procs[i];
+        ready_time += p->ready_time;
+        if(p->first_run >= 0){
+            response += p->first_run - p->arrival_time;
+            responded++;
+        }
+        if(p->s == KS_TERMINATED){
+            turnaround += p->finish_time - p->arrival_time;
+            metrics->completed++;
+        }
+    }
+    metrics->transitions = sim->transitions;
+    metrics->dispatches = sim->dispatches;
+    metrics->busy_time = sim->busy_time;
+    metrics->utilization = (sim->cpu_clock > 0) ? (double) sim->busy_time / sim->cpu_clock : 0.0;
+    metrics->mean_turnaround = (metrics->completed > 0) ? (double) turnaround / metrics->completed : 0.0;
+    metrics->mean_ready_time = (sim->count > 0) ? (double) ready_time / sim->count : 0.0;
+    metrics->mean_response = (responded > 0) ? (double) response / responded : 0.0;
+    metrics->max_ready_wait = sim->max_wait;
+    metrics->max_ready_wait_pid = sim->max_wait_pid;
+    metrics->switches = sim->costs.switches;
+    metrics->switch_time = sim->costs.switch_time;
+    metrics->cache_time = sim->costs.cache_time;
+}
+
+// Copies the entries of a heap, the copy keeps its own capacity
+static void copy_heap(heap_t to, const struct min_heap *from){
+    if(from->size > to->capacity){
+        to->entries = (struct heap_entry *) realloc(to->entries, from->size * sizeof(struct heap_entry));
+        assert(to->entries != NULL);
+        to->capacity = from->size;
+    }
+    memcpy(to->entries, from->entries, from->size * sizeof(struct heap_entry));
+    to->size = from->size;
+    to->next_seq = from->next_seq;
+}
+
+// Orders heap entries by insertion, to push them again in the order they were pushed
+static int compare_seq(const void *a, const void *b){
+    const struct heap_entry *x = (const struct heap_entry *) a, *y = (const struct heap_entry *) b;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+ks_sim_t *ks_fork(const ks_sim_t *sim, const struct ks_config *config){
+    struct heap_entry *entries;
+    ks_sim_t *copy;
+    int count;
+
+    if(sim == NULL) return NULL;
+    copy = ks_create();
+    if(copy == NULL) return NULL;
+
+    // The whole state is the process table and the heaps, copying them is a few memcpy
+    if(sim->count > copy->capacity){
+        copy->procs = (struct ks_process *) realloc(copy->procs, sim->count * sizeof(struct ks_process));
+        assert(copy->procs != NULL);
+        copy->capacity = sim->count;
+    }
+    memcpy(copy->procs, sim->procs, sim->count * sizeof(struct ks_process));
+    copy->count = sim->count;
+    copy_heap(copy->arrivals, sim->arrivals);
+    copy_heap(copy->ready, sim->ready);
+    copy_heap(copy->waiting, sim->waiting);
+    copy->config = sim->config;
+    copy->costs = sim->costs;
+    copy->running = sim->running;
+    copy->cpu_clock = sim->cpu_clock;
+    copy->next_step = sim->next_step;
+    copy->slice_used = sim->slice_used;
+    copy->started = sim->started;
+    copy->completed = sim->completed;
+    copy->next_wait_seq = sim->next_wait_seq;
+    copy->transitions = sim->transitions;
+    copy->dispatches = sim->dispatches;
+    copy->busy_time = sim->busy_time;
+    copy->max_wait = sim->max_wait;
+    copy->max_wait_pid = sim->max_wait_pid;
+    copy->next_pid = sim->next_pid;
+    // The coroutines are plain values, the copy resumes its own (what their arg points to is shared)
+    if(sim->script_count > 0){
+        copy->scripts = (struct ks_script *) malloc(sim->script_count * sizeof(struct ks_script));
+        assert(copy->scripts != NULL);
+        memcpy(copy->scripts, sim->scripts, sim->script_count * sizeof(struct ks_script));
+        copy->script_count = copy->script_capacity = sim->script_count;
+    }
+    if(config == NULL) return copy;
+
+    // The configuration can only be set before the first step, the copy takes it over directly
+    copy->started = 0;
+    if(ks_configure(copy, config) != KS_OK){
+        ks_destroy(copy);
+        return NULL;
+    }
+    copy->started = sim->started;
+    // Only the parameters of the switch model change, not what it counted so far
+    copy->costs.last_pid = sim->costs.last_pid;
+    copy->costs.dispatches = sim->costs.dispatches;
+    copy->costs.switches = sim->costs.switches;
+    copy->costs.switch_time = sim->costs.switch_time;
+    copy->costs.cache_time = sim->costs.cache_time;
+
+    // Push the ready processes again with the keys of the new policy, in the order they were pushed
+    count = copy->ready->size;
+    entries = (struct heap_entry *) malloc((count > 0 ? count : 1) * sizeof(struct heap_entry));
+    assert(entries != NULL);
+    memcpy(entries, copy->ready->entries, count * sizeof(struct heap_entry));
+    qsort(entries, count, sizeof(struct heap_entry), compare_seq);
+    copy->ready->size = 0;
+    for(int i = 0; i < count; i++){
+        heap_push(copy->ready, ready_key(copy, copy->config.policy, &copy->procs[INDEX(entries[i].item)]), entries[i].item);
+    }
+    free(entries);
+    return copy;
+}
+
+// Snapshot files start with this, the version changes with the layout of the records
+#define KS_SNAPSHOT_MAGIC "KSIMSNAP"
+#define KS_SNAPSHOT_VERSION 5
+
+// The header of a snapshot, the records sizes make sure it is read by a build with the same layout
+struct ks_snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t process_size;
+    uint32_t heap_entry_size;
+    struct ks_config config;
+    struct switch_model costs;
+    int count;
+    int running;
+    sim_time_t cpu_clock;
+    sim_time_t next_step;
+    int slice_used;
+    int started;
+    int completed;
+    sim_time_t max_wait;
+    sim_pid_t max_wait_pid;
+    int heap_sizes[3];
+    unsigned long long heap_seqs[3];
+    unsigned long long next_wait_seq;
+    long long transitions;
+    long long dispatches;
+    long long busy_time;
+};
+
+int ks_snapshot_save(const ks_sim_t *sim, const char *path){
+    struct ks_snapshot_header header;
+    heap_t heaps[3];
+    char temp_path[4096];
+    int ok;
+
+    // The scripts are functions of the running program
+    if(sim == NULL || path == NULL || sim->script_count > 0) return KS_ERROR_ARGUMENT;
+    heaps[0] = sim->arrivals;
+    heaps[1] = sim->ready;
+    heaps[2] = sim->waiting;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KS_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = KS_SNAPSHOT_VERSION;
+    header.header_size = sizeof(struct ks_snapshot_header);
+    header.process_size = sizeof(struct ks_process);
+    header.heap_entry_size = sizeof(struct heap_entry);
+    header.config = sim->config;
+    header.costs = sim->costs;
+    header.count = sim->count;
+    header.running = sim->running;
+    header.cpu_clock = sim->cpu_clock;
+    header.next_step = sim->next_step;
+    header.slice_used = sim->slice_used;
+    header.started = sim->started;
+    header.completed = sim->completed;
+    header.max_wait = sim->max_wait;
+    header.max_wait_pid = sim->max_wait_pid;
+    for(int i = 0; i < 3; i++){
+        header.heap_sizes[i] = heaps[i]->size;
+        header.heap_seqs[i] = heaps[i]->next_seq;
+    }
+    header.next_wait_seq = sim->next_wait_seq;
+    header.transitions = sim->transitions;
+    header.dispatches = sim->dispatches;
+    header.busy_time = sim->busy_time;
+
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE *f = fopen(temp_path, "wb");
+    if(f == NULL) return KS_ERROR_FILE;
+    ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && fwrite(sim->procs, sizeof(struct ks_process), sim->count, f) == (size_t) sim->count;
+    for(int i = 0; i < 3; i++){
+        ok = ok && fwrite(heaps[i]->entries, sizeof(struct heap_entry), heaps[i]->size, f) == (size_t) heaps[i]->size;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if(!ok || rename(temp_path, path) != 0){
+        unlink(temp_path);
+        return KS_ERROR_FILE;
+    }
+    return KS_OK;
+}
+
+// Copies the entries of a heap out of the mapped snapshot
+static void load_heap(heap_t h, const struct heap_entry *entries, int size, unsigned long long next_seq){
+    if(size > h->capacity){
+        h->entries = (struct heap_entry *) realloc(h->entries, size * sizeof(struct heap_entry));
+        assert(h->entries != NULL);
+        h->capacity = size;
+    }
+    memcpy(h->entries, entries, size * sizeof(struct heap_entry));
+    h->size = size;
+    h->next_seq = next_seq;
+}
+
+ks_sim_t *ks_snapshot_load(const char *path, int *error){
+    const struct ks_snapshot_header *header;
+    const struct heap_entry *entries;
+    struct stat info;
+    size_t expected;
+    ks_sim_t *sim = NULL;
+    void *map;
+    int fd, result = KS_ERROR_SNAPSHOT;
+
+    if(error != NULL) *error = KS_ERROR_FILE;
+    if(path == NULL) return NULL;
+    fd = open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    if(fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(struct ks_snapshot_header)){
+        close(fd);
+        if(error != NULL) *error = KS_ERROR_SNAPSHOT;
+        return NULL;
+    }
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) return NULL;
+
+    header = (const struct ks_snapshot_header *) map;
+    expected = sizeof(struct ks_snapshot_header) + (size_t) header->count * sizeof(struct ks_process)
+        + ((size_t) header->heap_sizes[0] + header->heap_sizes[1] + header->heap_sizes[2]) * sizeof(struct heap_entry);
+    if(memcmp(header->magic, KS_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 || header->version != KS_SNAPSHOT_VERSION
+        || header->header_size != sizeof(struct ks_snapshot_header) || header->process_size != sizeof(struct ks_process)
+        || header->heap_entry_size != sizeof(struct heap_entry) || header->count < 0 || header->heap_sizes[0] < 0
+        || header->heap_sizes[1] < 0 || header->heap_sizes[2] < 0 || expected != (size_t) info.st_size){
+        goto done;
+    }
+
+    sim = ks_create();
+    if(sim == NULL){
+        result = KS_ERROR_ARGUMENT;
+        goto done;
+    }
+    sim->config = header->config;
+    sim->costs = header->costs;
+    if(header->count > sim->capacity){
+        sim->procs = (struct ks_process *) realloc(sim->procs, header->count * sizeof(struct ks_process));
+        assert(sim->procs != NULL);
+        sim->capacity = header->count;
+    }
+    memcpy(sim->procs, header + 1, header->count * sizeof(struct ks_process));
+    sim->count = header->count;
+    for(int i = 0; i < sim->count; i++){
+        if(sim->procs[i].pid >= sim->next_pid) sim->next_pid = (sim->procs[i].pid < LLONG_MAX) ? sim->procs[i].pid + 1 : LLONG_MAX;
+    }
+
+    entries = (const struct heap_entry *) ((const struct ks_process *) (header + 1) + header->count);
+    load_heap(sim->arrivals, entries, header->heap_sizes[0], header->heap_seqs[0]);
+    entries += header->heap_sizes[0];
+    load_heap(sim->ready, entries, header->heap_sizes[1], header->heap_seqs[1]);
+    entries += header->heap_sizes[1];
+    load_heap(sim->waiting, entries, header->heap_sizes[2], header->heap_seqs[2]);
+
+    sim->running = header->running;
+    sim->cpu_clock = header->cpu_clock;
+    sim->next_step = header->next_step;
+    sim->slice_used = header->slice_used;
+    sim->started = header->started;
+    sim->completed = header->completed;
+    sim->max_wait = header->max_wait;
+    sim->max_wait_pid = header->max_wait_pid;
+    sim->next_wait_seq = header->next_wait_seq;
+    sim->transitions = header->transitions;
+    sim->dispatches = header->dispatches;
+    sim->busy_time = header->busy_time;
+    result = KS_OK;
+
+done:
+    munmap(map, info.st_size);
+    if(error != NULL) *error = result;
+    return sim;
+}
+
+void ks_destroy(ks_sim_t *sim){
+    if(sim == NULL) return;
+    heap_free(sim->arrivals);
+    heap_free(sim->ready);
+    heap_free(sim->waiting);
+    free(sim->procs);
+    free(sim->woken);
+    free(sim->scripts);
+    free(sim->spawned);
+    free(sim);
+}
@@ -0,0 +1,276 @@
+/*****************************************************
+* libkernelsim, the simulators as a library          *
+******************************************************
+* Runs the round robin, priority and first come      *
+* first served simulations in process: the caller    *
+* adds processes (or loads a CSV), configures the    *
+* policy, runs or steps the simulation, gets every   *
+* transition through a callback and collects the     *
+* metrics. Nothing is printed and no file is written.*
+* A simulation is not thread safe, but independent   *
+* simulations can run on different threads.          *
+******************************************************/
+
+#ifndef KERNEL_SIM_H
+#define KERNEL_SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "simTime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Round robin and priority follow roundRobin.c and priority.c transition for transition.
+// First come first served is the round robin event loop without a time slice.
+enum KS_POLICY {
+    KS_FCFS,
+    KS_ROUND_ROBIN,
+    KS_PRIORITY
+};
+
+// Same order as the STATE enumerators of the simulators
+enum KS_STATE {
+    KS_NEW,
+    KS_READY,
+    KS_RUNNING,
+    KS_WAITING,
+    KS_TERMINATED
+};
+
+// The outputs of ks_run_output. Each policy and output has its own copy of the simulation loop where
+// both are constants, so the loop has no policy branch and no indirect call per transition.
+enum KS_OUTPUT {
+    KS_OUTPUT_METRICS,
+    KS_OUTPUT_TEXT,
+    KS_OUTPUT_BINARY
+};
+
+// One transition of the binary output, in native byte order
+struct ks_transition_record {
+    int64_t time;
+    int64_t pid;
+    uint8_t old_state;
+    uint8_t new_state;
+    uint8_t pad[6];
+};
+
+// What a scripted process asks the kernel for when it yields
+enum KS_REQUEST {
+    // run on the CPU for duration ms, then the script is resumed
+    KS_REQUEST_CPU,
+    // block for duration ms of I/O, then the script is resumed
+    KS_REQUEST_IO,
+    // start a child process now that runs script with arg, the parent is resumed right away
+    KS_REQUEST_SPAWN,
+    // terminate
+    KS_REQUEST_EXIT
+};
+
+struct ks_coroutine;
+struct ks_request;
+
+// The behavior of a scripted process, called every time it is resumed. It sets the request and returns.
+typedef void (*ks_script_fn)(struct ks_coroutine *co, struct ks_request *request);
+
+struct ks_request {
+    enum KS_REQUEST type;
+    int duration;
+    ks_script_fn script;
+    void *arg;
+};
+
+#define KS_COROUTINE_VARS 4
+
+// The state of a scripted process between two resumes. It has no stack: the script keeps what it needs
+// across the yields in vars (0 at the start) or in what arg points to.
+struct ks_coroutine {
+    // where the script goes on, 0 before the first resume
+    int resume_point;
+    sim_pid_t pid;
+    void *arg;
+    // the time of the resume
+    sim_time_t now;
+    // how long the process waited in the ready queue during its last CPU burst
+    sim_time_t ready_wait;
+    // the PID of the last child it spawned
+    sim_pid_t spawned;
+    int vars[KS_COROUTINE_VARS];
+};
+
+// A script is a switch on the resume point, each yield saves its line and returns, and the next resume jumps
+// back after it. Locals do not survive a yield, there is at most one yield per line and none inside a switch
+// of the script. A script that returns through KS_END exits.
+#define KS_BEGIN(co) switch((co)->resume_point){ case 0:
+#define KS_YIELD(co) do { (co)->resume_point = __LINE__; return; case __LINE__:; } while(0)
+#define KS_RUN(co, request, ms) do { (request)->type = KS_REQUEST_CPU; (request)->duration = (ms); KS_YIELD(co); } while(0)
+#define KS_IO(co, request, ms) do { (request)->type = KS_REQUEST_IO; (request)->duration = (ms); KS_YIELD(co); } while(0)
+#define KS_SPAWN(co, request, fn, a) \
+    do { (request)->type = KS_REQUEST_SPAWN; (request)->script = (fn); (request)->arg = (a); KS_YIELD(co); } while(0)
+#define KS_EXIT(co, request) do { (request)->type = KS_REQUEST_EXIT; (co)->resume_point = -1; return; } while(0)
+#define KS_END(co, request) break; default: break; } KS_EXIT(co, request)
+
+// Error codes, every call returning an int returns 0 or one of these
+#define KS_OK 0
+#define KS_ERROR_ARGUMENT -1
+#define KS_ERROR_FILE -2
+#define KS_ERROR_STARTED -3
+#define KS_ERROR_SNAPSHOT -4
+
+// The configuration of a simulation, ks_config_default gives the behavior of the simulators without options
+struct ks_config {
+    enum KS_POLICY policy;
+    // round robin: the time slice in ms, at least 1 (-q of roundRobin.c, TIME_SLICE by default)
+    int time_slice;
+    // priority: ms of waiting per unit of priority, 0 disables aging (-a of priority.c)
+    int aging_interval;
+    // context switches, see switchCost.h (-c and -w of the simulators)
+    int switch_cost;
+    int cache_penalty;
+    int cache_decay;
+    int migration_penalty;
+};
+
+// The metrics collected by a simulation, times in ms
+struct ks_metrics {
+    sim_time_t end_time;
+    int processes;
+    int completed;
+    long long transitions;
+    long long dispatches;
+    long long busy_time;
+    double utilization;
+    double mean_turnaround;
+    double mean_ready_time;
+    double mean_response;
+    sim_time_t max_ready_wait;
+    sim_pid_t max_ready_wait_pid;
+    long long switches;
+    long long switch_time;
+    long long cache_time;
+};
+
+// Called for every transition, in the order the simulators print them
+typedef void (*ks_transition_fn)(void *context, sim_time_t time, sim_pid_t pid, enum KS_STATE old_state, enum KS_STATE new_state);
+
+typedef struct ks_sim ks_sim_t;
+
+/* FUNCTION DESCRIPTION: ks_config_default
+* Fills the configuration of a round robin simulation behaving like roundRobin.c
+*/
+void ks_config_default(struct ks_config *config);
+
+/* FUNCTION DESCRIPTION: ks_create
+* Creates an empty simulation with the default configuration
+* The return value is the simulation, or NULL if there is no memory
+*/
+ks_sim_t *ks_create(void);
+
+/* FUNCTION DESCRIPTION: ks_configure
+* Sets the configuration, only before the first step
+*/
+int ks_configure(ks_sim_t *sim, const struct ks_config *config);
+
+/* FUNCTION DESCRIPTION: ks_set_transition_callback
+* Sets the function called for every transition, NULL to collect the metrics only
+*/
+void ks_set_transition_callback(ks_sim_t *sim, ks_transition_fn callback, void *context);
+
+/* FUNCTION DESCRIPTION: ks_add_process
+* Adds a process, with the columns of the input CSV. A process can be added while the simulation
+* runs as long as it arrives after the current time.
+* The return value is KS_ERROR_ARGUMENT for a negative PID, I/O frequency or I/O duration, a total CPU time
+* that is not positive, or an arrival time that is negative or after SIM_TIME_LIMIT (see simTime.h)
+*/
+int ks_add_process(ks_sim_t *sim, sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration);
+
+/* FUNCTION DESCRIPTION: ks_add_script
+* Adds a scripted process: instead of the columns of the input CSV, its CPU bursts, I/O and children come
+* from a coroutine resumed when it arrives, when a CPU burst ends and when its I/O completes. The priority
+* policy orders scripted processes on the CPU burst they ask for. The children get the PIDs after the
+* largest one added so far. A simulation with scripted processes cannot be saved in a snapshot.
+* The parameters are:
+*    -pid, arrival_time, like ks_add_process
+*    -script, the behavior of the process
+*    -arg, given to the script in its coroutine, it is shared with the forks of the simulation
+*/
+int ks_add_script(ks_sim_t *sim, sim_pid_t pid, sim_time_t arrival_time, ks_script_fn script, void *arg);
+
+/* FUNCTION DESCRIPTION: ks_load_csv
+* Adds the processes of a CSV file in the input format of the simulators
+* The library takes one value per I/O column: a row with burst sequences stops the load with KS_ERROR_ARGUMENT,
+* like a column out of the ranges of the simulators (see simTime.h) or a process ks_add_process refuses
+*/
+int ks_load_csv(ks_sim_t *sim, const char *input_file);
+
+/* FUNCTION DESCRIPTION: ks_step
+* Runs one step of the simulation loop: the clock moves to the next event and the events at that time are handled
+* The return value is 1 if the simulation goes on, 0 once it is completed
+*/
+int ks_step(ks_sim_t *sim);
+
+/* FUNCTION DESCRIPTION: ks_run
+* Runs the simulation to completion
+*/
+int ks_run(ks_sim_t *sim);
+
+/* FUNCTION DESCRIPTION: ks_run_output
+* Runs the simulation to completion in the loop specialized for its policy and the output, which is
+* the same as ks_run with a callback writing the transitions, without calling the callback.
+* The parameters are:
+*    -sim, the simulation, it can have run steps already
+*    -output, the metrics only, the transitions as the rows printed by the simulators, or as records
+*    -out, where the transitions are written, unused for the metrics only
+*/
+int ks_run_output(ks_sim_t *sim, enum KS_OUTPUT output, FILE *out);
+
+// The current simulated time
+sim_time_t ks_time(const ks_sim_t *sim);
+
+// True once every process terminated
+int ks_completed(const ks_sim_t *sim);
+
+/* FUNCTION DESCRIPTION: ks_get_metrics
+* Computes the metrics so far, it can be called at any step
+*/
+void ks_get_metrics(const ks_sim_t *sim, struct ks_metrics *metrics);
+
+/* FUNCTION DESCRIPTION: ks_fork
+* Copies a simulation at its current time into a new one that goes on with another configuration.
+* The processes already in the ready queue are ordered again for the new policy, in the order they became
+* ready when it is first in first out. The copy has no transition callback. The simulation and its forks
+* share nothing, they can run on different threads.
+* The parameters are:
+*    -sim, the simulation to copy, it is not changed
+*    -config, the configuration of the copy, NULL to keep the one of sim
+* The return value is the copy, or NULL if the configuration is invalid or there is no memory
+*/
+ks_sim_t *ks_fork(const ks_sim_t *sim, const struct ks_config *config);
+
+/* FUNCTION DESCRIPTION: ks_snapshot_save
+* Saves the whole state of the simulation: clock, queues, process timers and time slice.
+* The snapshot is written to a temporary file renamed over path, so a crash leaves the previous one.
+* The transition callback is not saved, and neither can the scripts: with scripted processes it fails.
+*/
+int ks_snapshot_save(const ks_sim_t *sim, const char *path);
+
+/* FUNCTION DESCRIPTION: ks_snapshot_load
+* Creates a simulation from a snapshot, it goes on exactly as the simulation that was saved
+* The parameters are:
+*    -path, the snapshot file, written by the same build of the library
+*    -error, set to the error code when the snapshot cannot be loaded, may be NULL
+* The return value is the simulation, or NULL on error
+*/
+ks_sim_t *ks_snapshot_load(const char *path, int *error);
+
+/* FUNCTION DESCRIPTION: ks_destroy
+* Frees the simulation
+*/
+void ks_destroy(ks_sim_t *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Checks of the error paths of libkernelsim: the     *
+* processes and files the library must refuse, and   *
+* that a refused process leaves the simulation as it *
+* was. Every check is printed, the exit status is    *
+* the number of checks that failed.                  *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "kernelSim.h"
+
+static int failed = 0;
+
+/* FUNCTION DESCRIPTION: check
+* Prints a check and counts it when the result is not the expected one
+*/
+void check(const char *name, int result, int expected){
+    printf("%-60s %s\n", name, (result == expected) ? "ok" : "FAILED");
+    if(result != expected){
+        printf("    returned %d, expected %d\n", result, expected);
+        failed++;
+    }
+}
+
+// A script that only runs once, for ks_add_script
+void run_once(struct ks_coroutine *co, struct ks_request *request){
+    KS_BEGIN(co);
+    KS_RUN(co, request, 1);
+    KS_END(co, request);
+}
+
+/* FUNCTION DESCRIPTION: write_csv
+* Writes a workload file with the header of the simulators and the given rows
+* The return value is 0, or -1 if the file cannot be written
+*/
+int write_csv(const char *path, const char *rows){
+    FILE *f = fopen(path, "w");
+
+    if(f == NULL){
+        perror("Cannot write the workload");
+        return -1;
+    }
+    fprintf(f, "Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration\n%s", rows);
+    fclose(f);
+    return 0;
+}
+
+void check_add_process(void){
+    struct ks_metrics m;
+    ks_sim_t *sim = ks_create();
+
+    check("ks_add_process without a simulation", ks_add_process(NULL, 1, 0, 10, 2, 3), KS_ERROR_ARGUMENT);
+    check("ks_add_process with a negative PID", ks_add_process(sim, -1, 0, 10, 2, 3), KS_ERROR_ARGUMENT);
+    check("ks_add_process with a negative arrival time", ks_add_process(sim, 1, -1, 10, 2, 3), KS_ERROR_ARGUMENT);
+    check("ks_add_process with no CPU time", ks_add_process(sim, 1, 0, 0, 2, 3), KS_ERROR_ARGUMENT);
+    check("ks_add_process with a negative CPU time", ks_add_process(sim, 1, 0, -10, 2, 3), KS_ERROR_ARGUMENT);
+    check("ks_add_process with a negative I/O frequency", ks_add_process(sim, 1, 0, 10, -2, 3), KS_ERROR_ARGUMENT);
+    check("ks_add_process with a negative I/O duration", ks_add_process(sim, 1, 0, 10, 2, -3), KS_ERROR_ARGUMENT);
+    check("ks_add_script with a negative PID", ks_add_script(sim, -1, 0, run_once, NULL), KS_ERROR_ARGUMENT);
+    check("ks_add_script with a negative arrival time", ks_add_script(sim, 1, -1, run_once, NULL), KS_ERROR_ARGUMENT);
+    check("ks_add_process arriving after SIM_TIME_LIMIT", ks_add_process(sim, 1, SIM_TIME_LIMIT + 1, 10, 2, 3), KS_ERROR_ARGUMENT);
+    ks_get_metrics(sim, &m);
+    check("the refused processes were not added", m.processes, 0);
+
+    check("ks_add_process without I/O", ks_add_process(sim, 1, 0, 10, 0, 0), KS_OK);
+    check("ks_add_process with I/O", ks_add_process(sim, 2, 5, 10, 2, 3), KS_OK);
+    check("ks_run with the valid processes", ks_run(sim), KS_OK);
+    ks_get_metrics(sim, &m);
+    check("the valid processes completed", m.completed, 2);
+    check("ks_add_process arriving before the current time", ks_add_process(sim, 3, 0, 10, 2, 3), KS_ERROR_STARTED);
+    ks_destroy(sim);
+}
+
+void check_load_csv(void){
+    char path[] = "/tmp/kernelSimTestXXXXXX";
+    ks_sim_t *sim = ks_create();
+    int fd = mkstemp(path);
+
+    check("ks_load_csv without a file", ks_load_csv(sim, "/nonexistent/workload.csv"), KS_ERROR_FILE);
+    if(fd < 0){
+        perror("Cannot create the workload");
+        failed++;
+        ks_destroy(sim);
+        return;
+    }
+    close(fd);
+    if(write_csv(path, "1,0,10,2,3\n2,4,10,2;4,3\n") == 0){
+        check("ks_load_csv with burst sequences", ks_load_csv(sim, path), KS_ERROR_ARGUMENT);
+    }
+    ks_destroy(sim);
+    sim = ks_create();
+    if(write_csv(path, "1,0,10,2,3\n2,4,-10,2,3\n") == 0){
+        check("ks_load_csv with a negative CPU time", ks_load_csv(sim, path), KS_ERROR_ARGUMENT);
+    }
+    ks_destroy(sim);
+    sim = ks_create();
+    if(write_csv(path, "1,0,10,2,3\n2,2000000000000000,10,2,3\n") == 0){
+        check("ks_load_csv with an arrival time past SIM_TIME_LIMIT", ks_load_csv(sim, path), KS_ERROR_ARGUMENT);
+    }
+    ks_destroy(sim);
+    sim = ks_create();
+    if(write_csv(path, "1,0,10,2,3\n-1,4,10,2,3\n") == 0){
+        check("ks_load_csv with a negative PID", ks_load_csv(sim, path), KS_ERROR_ARGUMENT);
+    }
+    ks_destroy(sim);
+    sim = ks_create();
+    if(write_csv(path, "1,0,10,2,3\n2,4,10,x,3\n") == 0){
+        check("ks_load_csv with a column that is not a number", ks_load_csv(sim, path), KS_ERROR_ARGUMENT);
+    }
+    ks_destroy(sim);
+    sim = ks_create();
+    if(write_csv(path, "1,0,10,2,3\n2,4,12abc,2,3\n") == 0){
+        check("ks_load_csv with a number followed by letters", ks_load_csv(sim, path), KS_ERROR_ARGUMENT);
+    }
+    ks_destroy(sim);
+    sim = ks_create();
+    if(write_csv(path, "1,0,10,2,3\n2,4,10,2,3\n") == 0){
+        check("ks_load_csv with valid rows", ks_load_csv(sim, path), KS_OK);
+    }
+    ks_destroy(sim);
+    unlink(path);
+}
+
+void check_late_times(void){
+    struct ks_metrics m;
+    ks_sim_t *sim = ks_create();
+
+    // The times of a process arriving near INT_MAX go past it, the clock must not wrap
+    check("ks_add_process arriving just before INT_MAX", ks_add_process(sim, 1, 2147483600LL, 100, 10, 5), KS_OK);
+    check("ks_run past INT_MAX", ks_run(sim), KS_OK);
+    ks_get_metrics(sim, &m);
+    check("the clock went past INT_MAX", m.end_time > 2147483647LL, 1);
+    check("the turnaround is the CPU and I/O time", (int) m.mean_turnaround, 100 + 9 * 5);
+    ks_destroy(sim);
+}
+
+int main(void){
+    check_add_process();
+    check_late_times();
+    check_load_csv();
+    printf("%d checks failed\n", failed);
+    return failed;
+}
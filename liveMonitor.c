@@ -0,0 +1,145 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Watches a running simulator started with -L. It    *
+* maps the shared memory segment of the simulator    *
+* and prints its progress every interval: the        *
+* simulated clock, the events and simulated time per *
+* second of wall clock time, the queue lengths and   *
+* the utilization so far. Reading the segment never  *
+* blocks the simulator.                              *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include "liveStats.h"
+
+double now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void sleep_ms(int ms){
+    struct timespec t = { ms / 1000, (ms % 1000) * 1000000L };
+
+    while(nanosleep(&t, &t) != 0 && errno == EINTR);
+}
+
+/* FUNCTION DESCRIPTION: attach
+* Maps the segment of a simulator, waiting for it to be created
+* The return value is the segment, or NULL if it is not a live statistics segment
+*/
+struct live_segment *attach(const char *name, int interval){
+    struct live_segment *segment;
+    int fd, waited = 0;
+
+    for(;;){
+        fd = shm_open(name, O_RDONLY, 0);
+        if(fd >= 0) break;
+        if(errno != ENOENT){
+            perror("Cannot open the live statistics segment");
+            return NULL;
+        }
+        if(!waited) fprintf(stderr, "Waiting for a simulator to create %s\n", name);
+        waited = 1;
+        sleep_ms(interval);
+    }
+    segment = (struct live_segment *) mmap(NULL, sizeof(struct live_segment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(segment == MAP_FAILED){
+        perror("Cannot map the live statistics segment");
+        return NULL;
+    }
+    // A segment that was just created may not be initialized yet
+    for(int tries = 0; memcmp(segment->magic, LIVE_MAGIC, sizeof(segment->magic)) != 0; tries++){
+        if(tries == 100){
+            fprintf(stderr, "%s is not a live statistics segment\n", name);
+            munmap(segment, sizeof(struct live_segment));
+            return NULL;
+        }
+        sleep_ms(10);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if(segment->version != LIVE_VERSION){
+        fprintf(stderr, "%s has version %d, this monitor reads version %d\n", name, segment->version, LIVE_VERSION);
+        munmap(segment, sizeof(struct live_segment));
+        return NULL;
+    }
+    return segment;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-i interval_ms] [-n samples] <shm_name>\n", name);
+}
+
+int main(int argc, char *argv[]){
+    int interval = 1000, samples = 0, opt;
+    char name[64];
+    struct live_segment *segment;
+    long long values[LIVE_FIELDS], previous[LIVE_FIELDS] = { 0 };
+    int stale;
+    double start, last, current, elapsed;
+
+    // -i: the time between two lines, -n: stop after that many lines (0 runs until the simulation finishes)
+    while((opt = getopt(argc, argv, "i:n:")) != -1){
+        if(opt == 'i'){
+            interval = atoi(optarg);
+        } else if(opt == 'n'){
+            samples = atoi(optarg);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if(argc - optind != 1 || interval <= 0 || samples < 0){
+        print_usage(argv[0]);
+        return 2;
+    }
+    snprintf(name, sizeof(name), "%s%s", (argv[optind][0] == '/') ? "" : "/", argv[optind]);
+
+    segment = attach(name, interval);
+    if(segment == NULL) return 1;
+    fprintf(stderr, "Watching the %s simulator, PID %d\n", segment->policy, segment->pid);
+
+    printf("Wall (s),Clock (ms),Events/s,Simulated ms/s,Completed,Running,Ready,Waiting,Blocked,Arriving,Utilization\n");
+    // A stale block has no line, the liveness check below tells whether the simulator is gone
+    live_read(segment, previous);
+    start = last = now();
+    for(int line = 0; samples == 0 || line < samples; line++){
+        sleep_ms(interval);
+        stale = live_read(segment, values) != 0;
+        current = now();
+        elapsed = current - last;
+        if(!stale) printf("%.1f,%lld,%.0f,%.0f,%lld,%lld,%lld,%lld,%lld,%lld,%.2f%%\n", current - start, values[LIVE_CLOCK],
+            (values[LIVE_EVENTS] - previous[LIVE_EVENTS]) / elapsed, (values[LIVE_CLOCK] - previous[LIVE_CLOCK]) / elapsed,
+            values[LIVE_COMPLETED], values[LIVE_RUNNING], values[LIVE_READY], values[LIVE_WAITING], values[LIVE_BLOCKED],
+            values[LIVE_ARRIVING], (values[LIVE_CLOCK] > 0) ? 100.0 * values[LIVE_BUSY_TIME] / values[LIVE_CLOCK] : 0.0);
+        fflush(stdout);
+        if(!stale && values[LIVE_FINISHED]){
+            fprintf(stderr, "The simulation finished at %lldms\n", values[LIVE_CLOCK]);
+            break;
+        }
+        // The simulator removes the name when it finishes, a dead one that did not finish will never update
+        if(kill(segment->pid, 0) != 0 && errno == ESRCH){
+            fprintf(stderr, "The simulator exited before the simulation finished\n");
+            munmap(segment, sizeof(struct live_segment));
+            return 1;
+        }
+        if(stale){
+            fprintf(stderr, "The statistics were being written during the whole read, the line is skipped\n");
+            continue;
+        }
+        memcpy(previous, values, sizeof(values));
+        last = current;
+    }
+    munmap(segment, sizeof(struct live_segment));
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*****************************************************
+* Live statistics shared by the simulators           *
+******************************************************
+* Publishes the progress of a running simulation in  *
+* a POSIX shared memory segment that liveMonitor.c   *
+* (or anything else) can map and read while the      *
+* simulation goes on. The block is protected by a    *
+* sequence lock: the simulator makes the sequence    *
+* odd, writes the fields and makes it even again, a  *
+* reader retries when the sequence was odd or moved  *
+* while it copied the fields, up to LIVE_RETRIES     *
+* times: a simulator that died while writing leaves  *
+* the sequence odd for good. The simulator never     *
+* waits for a reader, and only publishes every       *
+* LIVE_PERIOD events.                                *
+******************************************************/
+
+#ifndef LIVE_STATS_H
+#define LIVE_STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LIVE_MAGIC "KSIMLIVE"
+#define LIVE_VERSION 1
+#define LIVE_PERIOD 256
+// A publish takes well under a microsecond, a reader that failed this many times is looking at a dead writer
+#define LIVE_RETRIES 1000000
+
+// The fields of the block, in the order liveMonitor.c prints them
+enum LIVE_FIELD {
+    LIVE_CLOCK,
+    LIVE_EVENTS,
+    LIVE_COMPLETED,
+    LIVE_BUSY_TIME,
+    LIVE_RUNNING,
+    LIVE_READY,
+    LIVE_WAITING,
+    LIVE_BLOCKED,
+    LIVE_ARRIVING,
+    LIVE_FINISHED,
+    LIVE_FIELDS
+};
+
+// The shared block. The fields are relaxed atomics so that a reader racing the writer is well defined,
+// the sequence orders them.
+struct live_segment {
+    char magic[8];
+    int version;
+    int pid;
+    char policy[16];
+    _Alignas(64) atomic_uint seq;
+    atomic_llong fields[LIVE_FIELDS];
+};
+
+struct live_stats {
+    struct live_segment *segment;
+    char name[64];
+    long long events;
+    long long values[LIVE_FIELDS];
+};
+
+typedef struct live_stats *live_t;
+
+/* FUNCTION DESCRIPTION: live_open
+* Creates the shared memory segment and maps it
+* The parameters are:
+*    -name, the name of the segment, "/name" as shm_open wants it (the / is added if missing)
+*    -policy, the scheduling policy shown by the monitor
+* The return value is the publisher, or NULL if the segment cannot be created
+*/
+static inline live_t live_open(const char *name, const char *policy){
+    struct live_segment *segment;
+    live_t l;
+    int fd;
+
+    l = (live_t) calloc(1, sizeof(struct live_stats));
+    assert(l != NULL);
+    snprintf(l->name, sizeof(l->name), "%s%s", (name[0] == '/') ? "" : "/", name);
+    fd = shm_open(l->name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if(fd < 0 || ftruncate(fd, sizeof(struct live_segment)) != 0){
+        perror("Cannot create the live statistics segment");
+        if(fd >= 0) close(fd);
+        free(l);
+        return NULL;
+    }
+    segment = (struct live_segment *) mmap(NULL, sizeof(struct live_segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(segment == MAP_FAILED){
+        perror("Cannot map the live statistics segment");
+        shm_unlink(l->name);
+        free(l);
+        return NULL;
+    }
+    atomic_init(&segment->seq, 0);
+    for(int i = 0; i < LIVE_FIELDS; i++) atomic_init(&segment->fields[i], 0);
+    segment->version = LIVE_VERSION;
+    segment->pid = (int) getpid();
+    snprintf(segment->policy, sizeof(segment->policy), "%s", policy);
+    // The magic goes last, a reader that sees it sees an initialized block
+    atomic_thread_fence(memory_order_release);
+    memcpy(segment->magic, LIVE_MAGIC, sizeof(segment->magic));
+    l->segment = segment;
+    return l;
+}
+
+/* FUNCTION DESCRIPTION: live_publish
+* Writes l->values to the shared block under the sequence lock
+*/
+static inline void live_publish(live_t l){
+    struct live_segment *segment = l->segment;
+    unsigned int seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&segment->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    l->values[LIVE_EVENTS] = l->events;
+    for(int i = 0; i < LIVE_FIELDS; i++){
+        atomic_store_explicit(&segment->fields[i], l->values[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&segment->seq, seq + 2, memory_order_release);
+}
+
+/* FUNCTION DESCRIPTION: live_update
+* Publishes the state of the simulation, running is the PID on the CPU or -1
+*/
+static inline void live_update(live_t l, long long clock, long long completed, long long busy_time, long long running,
+    int ready, int waiting, int blocked, int arriving){
+    l->values[LIVE_CLOCK] = clock;
+    l->values[LIVE_COMPLETED] = completed;
+    l->values[LIVE_BUSY_TIME] = busy_time;
+    l->values[LIVE_RUNNING] = running;
+    l->values[LIVE_READY] = ready;
+    l->values[LIVE_WAITING] = waiting;
+    l->values[LIVE_BLOCKED] = blocked;
+    l->values[LIVE_ARRIVING] = arriving;
+    live_publish(l);
+}
+
+/* FUNCTION DESCRIPTION: live_due
+* Counts one event of the simulation loop
+* The return value is true every LIVE_PERIOD events, when the simulator must call live_update
+*/
+static inline int live_due(live_t l){
+    return l != NULL && l->events++ % LIVE_PERIOD == 0;
+}
+
+/* FUNCTION DESCRIPTION: live_read
+* Copies the shared block into values, retrying while the simulator is writing it
+* The return value is 0, or -1 when the block is stale: it was still being written after LIVE_RETRIES tries,
+* which happens when the simulator died in the middle of a publish. values is then left as it was.
+*/
+static inline int live_read(struct live_segment *segment, long long values[LIVE_FIELDS]){
+    long long copy[LIVE_FIELDS];
+    unsigned int before, after;
+
+    for(int tries = 0; tries < LIVE_RETRIES; tries++){
+        before = atomic_load_explicit(&segment->seq, memory_order_acquire);
+        if(before & 1) continue;
+        for(int i = 0; i < LIVE_FIELDS; i++){
+            copy[i] = atomic_load_explicit(&segment->fields[i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+        if(before == after){
+            memcpy(values, copy, sizeof(copy));
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* FUNCTION DESCRIPTION: live_close
+* Publishes the last values passed to live_update marked as finished and removes the segment name,
+* readers keep their mapping
+*/
+static inline void live_close(live_t l){
+    if(l == NULL) return;
+    l->values[LIVE_FINISHED] = 1;
+    live_publish(l);
+    munmap(l->segment, sizeof(struct live_segment));
+    shm_unlink(l->name);
+    free(l);
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*****************************************************
+* Binary min-heap shared by the simulators           *
+******************************************************
+* Entries are ordered by a 64 bit key. Ties are      *
+* broken by insertion order so that entries with the *
+* same key come out first in, first out, which keeps *
+* the output identical to the linked list scans.     *
+******************************************************/
+
+#ifndef MIN_HEAP_H
+#define MIN_HEAP_H
+
+#include <stdlib.h>
+#include <assert.h>
+
+struct heap_entry {
+    long long key;
+    unsigned long long seq;
+    void *item;
+};
+
+struct min_heap {
+    struct heap_entry *entries;
+    int size;
+    int capacity;
+    unsigned long long next_seq;
+};
+
+typedef struct min_heap *heap_t;
+
+/* FUNCTION DESCRIPTION: heap_create
+* This function creates a new, empty heap.
+* The parameters are:
+*    -capacity, the initial number of entries; the heap grows as needed
+* The return value is a pointer to the new heap
+*/
+static inline heap_t heap_create(int capacity){
+    heap_t h = (heap_t) malloc(sizeof(struct min_heap));
+    assert(h != NULL);
+
+    if(capacity < 16) capacity = 16;
+    h->entries = (struct heap_entry *) malloc(capacity * sizeof(struct heap_entry));
+    assert(h->entries != NULL);
+    h->size = 0;
+    h->capacity = capacity;
+    h->next_seq = 0;
+    return h;
+}
+
+// Returns true when entry a must come out of the heap before entry b
+static inline int heap_before(const struct heap_entry *a, const struct heap_entry *b){
+    if(a->key != b->key) return a->key < b->key;
+    return a->seq < b->seq;
+}
+
+static inline void heap_sift_up(heap_t h, int i){
+    struct heap_entry e = h->entries[i];
+    while(i > 0){
+        int parent = (i - 1) / 2;
+        if(!heap_before(&e, &h->entries[parent])) break;
+        h->entries[i] = h->entries[parent];
+        i = parent;
+    }
+    h->entries[i] = e;
+}
+
+static inline void heap_sift_down(heap_t h, int i){
+    struct heap_entry e = h->entries[i];
+    for(;;){
+        int child = 2 * i + 1;
+        if(child >= h->size) break;
+        if(child + 1 < h->size && heap_before(&h->entries[child + 1], &h->entries[child])) child++;
+        if(!heap_before(&h->entries[child], &e)) break;
+        h->entries[i] = h->entries[child];
+        i = child;
+    }
+    h->entries[i] = e;
+}
+
+/* FUNCTION DESCRIPTION: heap_push
+* This function inserts an item in O(log n).
+* The parameters are:
+*    -h, the heap
+*    -key, the ordering key, smallest comes out first
+*    -item, the pointer stored with the key
+*/
+static inline void heap_push(heap_t h, long long key, void *item){
+    if(h->size == h->capacity){
+        h->capacity *= 2;
+        h->entries = (struct heap_entry *) realloc(h->entries, h->capacity * sizeof(struct heap_entry));
+        assert(h->entries != NULL);
+    }
+    h->entries[h->size].key = key;
+    h->entries[h->size].seq = h->next_seq++;
+    h->entries[h->size].item = item;
+    h->size++;
+    heap_sift_up(h, h->size - 1);
+}
+
+/* FUNCTION DESCRIPTION: heap_pop
+* This function removes the item with the smallest key in O(log n).
+* The return value is the removed item, or NULL if the heap is empty
+*/
+static inline void *heap_pop(heap_t h){
+    void *item;
+    if(h->size == 0) return NULL;
+
+    item = h->entries[0].item;
+    h->size--;
+    if(h->size > 0){
+        h->entries[0] = h->entries[h->size];
+        heap_sift_down(h, 0);
+    }
+    return item;
+}
+
+// The item with the smallest key without removing it, or NULL if the heap is empty
+static inline void *heap_peek(heap_t h){
+    return (h->size == 0) ? NULL : h->entries[0].item;
+}
+
+// The smallest key, only meaningful when the heap is not empty
+static inline long long heap_peek_key(heap_t h){
+    return h->entries[0].key;
+}
+
+static inline int heap_empty(heap_t h){
+    return h->size == 0;
+}
+
+/* FUNCTION DESCRIPTION: heap_free
+* This function frees the heap. It does not free the stored items.
+*/
+static inline void heap_free(heap_t h){
+    free(h->entries);
+    free(h);
+}
+
+#endif
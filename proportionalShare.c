@@ -0,0 +1,711 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* The CPU is shared in proportion to the tickets of  *
+* each process, either with stride scheduling (a     *
+* heap on the pass value) or with lottery scheduling *
+* (a Fenwick tree over the tickets of the ready      *
+* processes, indexed by the slot of the process).    *
+* The processes yet to arrive and those waiting for  *
+* I/O are in heaps on the time of their next event,  *
+* so every event costs O(log n) whatever the number  *
+* of processes.                                      *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include "minHeap.h"
+#include "burstPool.h"
+#include "simTime.h"
+#define TIME_SLICE 3
+
+// Tickets of a process whose row has no Tickets column
+#define DEFAULT_TICKETS 100
+// Stride scheduling constant, the stride of a process is STRIDE1 / tickets
+#define STRIDE1 (1LL << 20)
+// Fixed seed so that lottery runs are reproducible
+#define LOTTERY_SEED 0x2545F4914F6CDD1DULL
+
+// Macro to return the min of a and b
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+// An enumerator (enum for short) to represent the state
+enum STATE {
+    STATE_NEW,
+    STATE_READY,
+    STATE_RUNNING,
+    STATE_WAITING,
+    STATE_TERMINATED
+};
+static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATED"};
+
+enum POLICY {
+    POLICY_STRIDE,
+    POLICY_LOTTERY
+};
+
+// A structure containing all the relovant meta data for a process, this is the PCB like struct
+// The io_time_remaining is used in two ways:
+// it counts how long until the next io call and how long until a current io call is complete
+// slot is the index of the process in the lottery tree, pass and stride are used by stride scheduling
+// entitled accumulates the CPU time the tickets of the process were worth while it was runnable,
+// runnable_mark is the value of the share clock when it last became runnable
+// io_done is the time its I/O completes while it is waiting
+struct process {
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time;
+    int cpu_time_remaining;
+    int io_frequency;
+    int io_duration;
+    int io_time_remaining;
+    sim_time_t io_done;
+    // The sequences of the I/O Frequency and I/O Duration columns, burst counts the I/O done
+    struct burst_seq cpu_bursts;
+    struct burst_seq io_bursts;
+    int burst;
+    int tickets;
+    int slot;
+    long long stride;
+    long long pass;
+    double entitled;
+    double runnable_mark;
+    enum STATE s;
+};
+
+// This structure is a linked list of processes
+struct node {
+    struct process *p;
+    struct node *next;
+};
+
+// typedefs are a short hand to make the code more legible
+typedef struct process *proc_t;
+typedef struct node *node_t;
+
+// The ready queue of either policy
+// For stride it is a heap on pass values, for lottery a Fenwick tree indexed by slot
+// whose weights are the tickets of the ready processes (0 for the others)
+struct ready_queue {
+    enum POLICY policy;
+    heap_t heap;
+    long long *tree;
+    node_t *slots;
+    int num_slots;
+    int size;
+    long long global_pass;
+    unsigned long long rng;
+};
+typedef struct ready_queue *ready_t;
+
+/* FUNCTION DESCRIPTION: create_proc
+* This function creates a new process structure.
+* The parameters are self descriptive:
+*    -pid
+*    -arrival_time
+*    -total_cpu_time
+*    -io_frequency
+*    -io_duration
+*    -tickets, the share of the CPU the process is entitled to
+* The return value is a pointer to new process structure
+*/
+proc_t create_proc(sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration, int tickets){
+    // Initialize memory
+    proc_t temp;
+    temp = (proc_t) malloc(sizeof(struct process));
+    assert(temp != NULL);
+
+    // Initialize contents
+    temp->pid = pid;
+    temp->arrival_time = arrival_time;
+    temp->total_cpu_time = total_cpu_time;
+    temp->cpu_time_remaining = total_cpu_time;
+    temp->io_frequency = io_frequency;
+    temp->io_duration = io_duration;
+    temp->io_time_remaining = io_frequency;
+    temp->io_done = 0;
+    temp->cpu_bursts.chunk = temp->io_bursts.chunk = NULL;
+    temp->cpu_bursts.count = temp->io_bursts.count = 1;
+    temp->burst = 0;
+    temp->tickets = (tickets > 0) ? tickets : DEFAULT_TICKETS;
+    temp->slot = -1;
+    temp->stride = STRIDE1 / temp->tickets;
+    temp->pass = 0;
+    temp->entitled = 0.0;
+    temp->runnable_mark = 0.0;
+    temp->s = STATE_NEW;
+    return temp;
+}
+
+/* FUNCTION DESCRIPTION: create_node
+* This function creates a new  list node.
+* The parameters are:
+*    -p, a pointer to the process structure to be stored in this node
+* The return value is a pointer to the new node
+*/
+node_t create_node(proc_t p){
+    // Initialize memory
+    node_t temp;
+    temp = (node_t) malloc(sizeof(struct node));
+    assert(temp != NULL);
+
+    // Initialize contents
+    temp->next = NULL;
+    temp->p = p;
+
+    return temp;
+}
+
+/* FUNCTION DESCRIPTION: print_proc
+* Prints one process, along with its time remaining and current state
+* The time until the next IO event of a waiting process is counted from cpu_clock
+*/
+void print_proc(proc_t p, sim_time_t cpu_clock){
+    printf("Process ID: %lld\n", p->pid);
+    printf("CPU Arrival Time: %lldms\n", p->arrival_time);
+    printf("Time Remaining: %dms of %dms\n", p->cpu_time_remaining, p->total_cpu_time);
+    printf("IO Duration: %dms\n", p->io_duration);
+    printf("IO Frequency: %dms\n", p->io_frequency);
+    printf("Tickets: %d\n", p->tickets);
+    printf("Current state: %s\n", STATES[p->s]);
+    printf("Time until next IO event: %lldms\n", (p->s == STATE_WAITING) ? p->io_done - cpu_clock : (sim_time_t) p->io_time_remaining);
+    printf("\n");
+}
+
+/* FUNCTION DESCRIPTION: print_nodes
+* Prints all the nodes in head, along with their time remaining and current states
+*/
+void print_nodes(node_t head, sim_time_t cpu_clock) {
+    if(head == NULL){
+        printf("EMPTY\n");
+        return;
+    }
+
+    for(node_t current = head; current != NULL; current = current->next){
+        print_proc(current->p, cpu_clock);
+    }
+}
+
+// Orders heap entries by insertion, for print_heap
+int compare_seq(const void *a, const void *b){
+    unsigned long long x = ((const struct heap_entry *) a)->seq, y = ((const struct heap_entry *) b)->seq;
+    return (x > y) - (x < y);
+}
+
+/* FUNCTION DESCRIPTION: print_heap
+* Prints all the nodes of an arrival or a waiting heap in the order they were added to it,
+* the order of the lists the heaps replaced. Only used in verbose mode, it sorts a copy of the heap.
+*/
+void print_heap(heap_t h, sim_time_t cpu_clock){
+    struct heap_entry *entries;
+
+    if(heap_empty(h)){
+        printf("EMPTY\n");
+        return;
+    }
+
+    entries = (struct heap_entry *) malloc(h->size * sizeof(struct heap_entry));
+    assert(entries != NULL);
+    memcpy(entries, h->entries, h->size * sizeof(struct heap_entry));
+    qsort(entries, h->size, sizeof(struct heap_entry), compare_seq);
+    for(int i = 0; i < h->size; i++){
+        print_proc(((node_t) entries[i].item)->p, cpu_clock);
+    }
+    free(entries);
+}
+
+/* FUNCTION DESCRIPTION: next_token
+* Reads the next comma separated column of the row being tokenized, a number from 0 to INT_MAX,
+* or gives the default value when the row has no more columns (optional columns)
+* The return value is 0, or -1 after printing why the column is not valid
+*/
+int next_token(const char *column, int default_value, int *value){
+    char *token = strtok(NULL, ",");
+    long long number;
+
+    *value = default_value;
+    if(token == NULL) return 0;
+    if(sim_parse_field(token, column, 0, INT_MAX, &number) != 0) return -1;
+    *value = (int) number;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: next_bursts
+* Returns the first burst of the next column of the row being tokenized, which holds one value
+* or a sequence of bursts that is stored in seq, or the default value when the row has no more columns
+*/
+int next_bursts(int default_value, struct burst_seq *seq){
+    char *token = strtok(NULL, ",");
+
+    seq->chunk = NULL;
+    seq->count = 1;
+    if(token == NULL) return default_value;
+    return burst_parse(token, seq);
+}
+
+/* FUNCTION DESCRIPTION: read_proc_from_file
+* Parse the CSV input file and load its contents into a list
+* The Tickets column is optional, a row without it gets DEFAULT_TICKETS
+* The parameters are:
+*    -input_file, the name of the CSV file
+*    -num_processes, set to the number of processes read
+* The return value is a list of the new processes
+*/
+node_t read_proc_from_file(char *input_file, int *num_processes){
+    char *row = NULL, *fields[3];
+    size_t size = 0;
+    node_t new_list=NULL, tail=NULL, node;
+    proc_t proc;
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time, io_frequency, io_duration, tickets;
+    struct burst_seq cpu_bursts, io_bursts;
+
+    *num_processes = 0;
+    FILE* f = fopen(input_file, "r");
+    if(f == NULL){
+        // file not opened, fail gracefully
+        perror("Cannot open the input file");
+        return NULL;
+    }
+    // Get the first row, which has the header values
+    //Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration[,Tickets]
+    // getline reads the rows whole, however long their burst sequences are
+    if(getline(&row, &size, f) == -1){
+        free(row);
+        fclose(f);
+        return NULL;
+    }
+    // Read the remainder of the rows until you get to the end of the file
+    while(getline(&row, &size, f) != -1){
+        // make sure it has at least enough char to be valid
+        if(strlen(row)<10) continue;
+        // The columns are range checked (see simTime.h), a row with one out of range is skipped
+        fields[0] = strtok(row, ",");
+        fields[1] = strtok(NULL, ",");
+        fields[2] = strtok(NULL, ",");
+        if(fields[2] == NULL || sim_parse_columns(fields, &pid, &arrival_time, &total_cpu_time) != 0) continue;
+        io_frequency = next_bursts(0, &cpu_bursts);
+        io_duration = next_bursts(0, &io_bursts);
+        if(sim_check_columns(pid, arrival_time, total_cpu_time, io_frequency, io_duration) != 0
+            || next_token("Tickets", DEFAULT_TICKETS, &tickets) != 0){
+            burst_free(&cpu_bursts);
+            burst_free(&io_bursts);
+            continue;
+        }
+
+        proc = create_proc(pid, arrival_time, total_cpu_time, io_frequency, io_duration, tickets);
+        proc->cpu_bursts = cpu_bursts;
+        proc->io_bursts = io_bursts;
+        proc->slot = (*num_processes)++;
+        node = create_node(proc);
+        // Keep a tail pointer, a large workload would make push_node quadratic
+        if(tail == NULL){
+            new_list = node;
+        } else {
+            tail->next = node;
+        }
+        tail = node;
+    }
+
+    free(row);
+    fclose(f);
+    burst_pool_free();
+    return new_list;
+}
+
+/* FUNCTION DESCRIPTION: fenwick_add
+* Adds delta to the weight of a slot of the lottery tree in O(log n)
+*/
+void fenwick_add(ready_t rq, int slot, long long delta){
+    for(int i = slot + 1; i <= rq->num_slots; i += i & (-i)){
+        rq->tree[i] += delta;
+    }
+}
+
+/* FUNCTION DESCRIPTION: fenwick_find
+* Finds the slot holding the winning ticket in O(log n), by descending the tree
+* The parameters are:
+*    - rq: the ready queue
+*    - ticket: the winning ticket, between 0 and the number of ready tickets - 1
+* The return value is the slot whose range of tickets contains the winning ticket
+*/
+int fenwick_find(ready_t rq, long long ticket){
+    int pos = 0, step = 1;
+
+    while(step * 2 <= rq->num_slots) step *= 2;
+    for(; step > 0; step /= 2){
+        if(pos + step <= rq->num_slots && rq->tree[pos + step] <= ticket){
+            pos += step;
+            ticket -= rq->tree[pos];
+        }
+    }
+    return pos;
+}
+
+/* FUNCTION DESCRIPTION: next_random
+* xorshift64* generator, good enough to draw lottery tickets
+*/
+unsigned long long next_random(ready_t rq){
+    rq->rng ^= rq->rng >> 12;
+    rq->rng ^= rq->rng << 25;
+    rq->rng ^= rq->rng >> 27;
+    return rq->rng * 0x2545F4914F6CDD1DULL;
+}
+
+/* FUNCTION DESCRIPTION: create_ready_queue
+* This function creates the ready queue for the policy
+* The parameters are:
+*    - policy: stride or lottery
+*    - num_processes: the number of slots of the lottery tree
+* The return value is a pointer to the ready queue
+*/
+ready_t create_ready_queue(enum POLICY policy, int num_processes, node_t all){
+    ready_t rq = (ready_t) malloc(sizeof(struct ready_queue));
+    assert(rq != NULL);
+
+    rq->policy = policy;
+    rq->heap = heap_create(num_processes);
+    rq->num_slots = num_processes;
+    rq->tree = (long long *) calloc(num_processes + 1, sizeof(long long));
+    rq->slots = (node_t *) calloc(num_processes + 1, sizeof(node_t));
+    assert(rq->tree != NULL && rq->slots != NULL);
+    for(node_t node = all; node != NULL; node = node->next){
+        rq->slots[node->p->slot] = node;
+    }
+    rq->size = 0;
+    rq->global_pass = 0;
+    rq->rng = LOTTERY_SEED;
+    return rq;
+}
+
+/* FUNCTION DESCRIPTION: ready_push
+* Adds a node to the ready queue
+* A process that was not running (it arrived or its io completed) cannot keep a pass
+* older than the global pass, otherwise it would monopolize the CPU to catch up
+*/
+void ready_push(ready_t rq, node_t node, bool was_running){
+    node->p->s = STATE_READY;
+    rq->size++;
+    if(rq->policy == POLICY_STRIDE){
+        if(!was_running) node->p->pass = max(node->p->pass, rq->global_pass);
+        heap_push(rq->heap, node->p->pass, node);
+    } else {
+        fenwick_add(rq, node->p->slot, node->p->tickets);
+    }
+}
+
+/* FUNCTION DESCRIPTION: ready_pop
+* Removes the next process to run from the ready queue: the smallest pass for stride,
+* the holder of a randomly drawn ticket for lottery
+* The return value is the node, or NULL if no process is ready
+*/
+node_t ready_pop(ready_t rq){
+    node_t node;
+    long long total;
+
+    if(rq->size == 0) return NULL;
+    rq->size--;
+    if(rq->policy == POLICY_STRIDE){
+        node = (node_t) heap_pop(rq->heap);
+        rq->global_pass = max(rq->global_pass, node->p->pass);
+    } else {
+        // The root of the tree covering all the slots holds the total number of ready tickets
+        total = 0;
+        for(int i = rq->num_slots; i > 0; i -= i & (-i)) total += rq->tree[i];
+        node = rq->slots[fenwick_find(rq, (long long) (next_random(rq) % (unsigned long long) total))];
+        fenwick_add(rq, node->p->slot, -node->p->tickets);
+    }
+    return node;
+}
+
+void free_ready_queue(ready_t rq){
+    heap_free(rq->heap);
+    free(rq->tree);
+    free(rq->slots);
+    free(rq);
+}
+
+/* FUNCTION DESCRIPTION: get_time_to_next_event
+* This function returns the amount of simulation time until the next event occurs
+* The parameters are:
+*    - cpu_clock: Time since the start of the simulation
+*    - running: The node containing the currently running process
+*    - slice_used: how much of its time slice the running process used
+*    - arrivals: The heap of the processes that have yet to arrive, on their arrival time
+*    - waiting: The heap of the processes that are waiting for io, on the time it completes
+* The return value is the time until the next event
+*/
+sim_time_t get_time_to_next_event(sim_time_t cpu_clock, node_t running, int slice_used, heap_t arrivals, heap_t waiting){
+    sim_time_t next_exit=SIM_TIME_MAX, next_block=SIM_TIME_MAX, next_arrival=SIM_TIME_MAX, next_io=SIM_TIME_MAX;
+
+    if(running != NULL){
+        next_exit = min(running->p->cpu_time_remaining, TIME_SLICE - slice_used);
+        next_block = running->p->io_time_remaining;
+    }
+
+    // The tops of the heaps are the next arrival and the next io completion
+    if(!heap_empty(arrivals)) next_arrival = heap_peek_key(arrivals) - cpu_clock;
+    if(!heap_empty(waiting)) next_io = heap_peek_key(waiting) - cpu_clock;
+
+    sim_time_t min_time = min(min(next_exit, next_block), min(next_arrival, next_io));
+    return (min_time == 0) ? 1 : min_time;
+}
+
+/* FUNCTION DESCRIPTION: print_transition
+* Prints one state transition in the output format shared by all the simulators
+*/
+void print_transition(sim_time_t cpu_clock, proc_t p, enum STATE old_state, enum STATE new_state){
+    printf("%lld,%lld,%s,%s\n", cpu_clock, p->pid, STATES[old_state], STATES[new_state]);
+}
+
+/* FUNCTION DESCRIPTION: dispatch
+* Takes the next process out of the ready queue and runs it
+* The return value is the new running node, or NULL if the CPU is idle
+*/
+node_t dispatch(sim_time_t cpu_clock, ready_t rq, int verbose){
+    node_t running = ready_pop(rq);
+
+    if(running != NULL){
+        running->p->s = STATE_RUNNING;
+        print_transition(cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+    } else {
+        if(verbose) printf("%lld: CPU is idle\n", cpu_clock);
+    }
+    return running;
+}
+
+/* FUNCTION DESCRIPTION: print_share_report
+* Prints the achieved and the target share of the CPU of each process on stderr.
+* The target of a process is what its tickets were worth while it was runnable: every ms the CPU
+* is busy is split between the runnable processes in proportion to their tickets. The achieved
+* share is the CPU time it really got. Both are relative to the total CPU busy time.
+* The parameters are:
+*    - terminated: the list of all the processes once the simulation is done
+*    - policy: the policy, for the title of the report
+*/
+void print_share_report(node_t terminated, enum POLICY policy){
+    node_t temp;
+    long long busy = 0;
+    double error, worst = 0.0, sum_error = 0.0;
+    int count = 0;
+
+    for(temp = terminated; temp != NULL; temp = temp->next){
+        busy += temp->p->total_cpu_time;
+    }
+    if(busy == 0) return;
+
+    fprintf(stderr, "%s share report, %lldms of CPU time:\n", (policy == POLICY_STRIDE) ? "Stride" : "Lottery", busy);
+    fprintf(stderr, "PID,Tickets,Target share,Achieved share,Achieved/Target\n");
+    for(temp = terminated; temp != NULL; temp = temp->next){
+        proc_t p = temp->p;
+        double target = 100.0 * p->entitled / busy;
+        double achieved = 100.0 * p->total_cpu_time / busy;
+
+        fprintf(stderr, "%lld,%d,%.3f%%,%.3f%%,%.3f\n", p->pid, p->tickets, target, achieved,
+            (p->entitled > 0.0) ? p->total_cpu_time / p->entitled : 0.0);
+        error = achieved - target;
+        if(error < 0) error = -error;
+        sum_error += error;
+        if(error > worst) worst = error;
+        count++;
+    }
+    fprintf(stderr, "Share error: worst %.3f points, mean %.3f points over %d processes\n",
+        worst, sum_error / count, count);
+}
+
+/* FUNCTION DESCRIPTION: clean_up
+* This function frees all the dynamically allocated heap memory
+* The parameters are:
+*    - list: the list of nodes to free
+*/
+void clean_up(node_t list){
+    node_t temp;
+    while(list != NULL){
+        temp = list;
+        list = list->next;
+        burst_free(&temp->p->cpu_bursts);
+        burst_free(&temp->p->io_bursts);
+        free(temp->p);
+        free(temp);
+    }
+}
+
+int main( int argc, char *argv[]) {
+    sim_time_t next_step = 0, cpu_clock = 0;
+    int slice_used = 0, num_processes;
+    bool simulation_completed = false;
+    node_t new_list = NULL, terminated = NULL, terminated_tail = NULL, temp, node;
+    node_t running = NULL;
+    heap_t arrivals, waiting;
+    ready_t rq;
+    enum POLICY policy;
+    char *input_file;
+    int verbose;
+    // The share clock advances by 1 / (tickets of the runnable processes) for every ms the CPU is busy,
+    // so the entitlement of a process over an interval is its tickets times the advance of the clock
+    double share_clock = 0.0;
+    long long runnable_tickets = 0;
+
+    if(argc == 3 || argc == 4){
+        input_file = argv[1];
+        verbose = (argc == 4) ? atoi(argv[3]) : 0;
+    } else {
+        printf("Usage: %s <input_file.csv> <stride|lottery> [verbose]\n", argv[0]);
+        return -1;
+    }
+    if(strcmp(argv[2], "stride") == 0){
+        policy = POLICY_STRIDE;
+    } else if(strcmp(argv[2], "lottery") == 0){
+        policy = POLICY_LOTTERY;
+    } else {
+        printf("Unknown policy %s, expected stride or lottery.\n", argv[2]);
+        return -1;
+    }
+
+    // Process meta data should be read from a text file
+    if(verbose) printf("------------------------------- Loading all processes -------------------------------\n");
+    new_list = read_proc_from_file(input_file, &num_processes);
+    if(verbose) print_nodes(new_list, cpu_clock);
+    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(verbose) printf("Starting simulation...\n");
+
+    rq = create_ready_queue(policy, num_processes, new_list);
+    // The processes arriving at the same time come out of the heap in the order of the file
+    arrivals = heap_create(num_processes);
+    waiting = heap_create(num_processes);
+    for(node = new_list; node != NULL; node = temp){
+        temp = node->next;
+        node->next = NULL;
+        heap_push(arrivals, node->p->arrival_time, node);
+    }
+
+    // print the headers
+    printf("Time of transition,PID,Old State,New State\n");
+    // Simulation loop
+    do {
+        // Advance the cpu clock time, and the share clock if the CPU was busy
+        cpu_clock += next_step;
+        if(running != NULL && runnable_tickets > 0){
+            share_clock += (double) next_step / runnable_tickets;
+        }
+        // The processes whose io completed are ready, in the order they blocked
+        while(!heap_empty(waiting) && heap_peek_key(waiting) <= cpu_clock){
+            node = (node_t) heap_pop(waiting);
+            // Update the time of next io event to its next CPU burst
+            node->p->burst++;
+            node->p->io_time_remaining = burst_at(&node->p->cpu_bursts, node->p->burst, node->p->io_frequency);
+            ready_push(rq, node, false);
+            node->p->runnable_mark = share_clock;
+            runnable_tickets += node->p->tickets;
+            print_transition(cpu_clock, node->p, STATE_WAITING, STATE_READY);
+        }
+
+        // The processes that arrived are ready, in the order of the file
+        while(!heap_empty(arrivals) && heap_peek_key(arrivals) <= cpu_clock){
+            node = (node_t) heap_pop(arrivals);
+            ready_push(rq, node, false);
+            node->p->runnable_mark = share_clock;
+            runnable_tickets += node->p->tickets;
+            print_transition(cpu_clock, node->p, STATE_NEW, STATE_READY);
+        }
+
+        // Make sure the CPU is running a process
+        if(running == NULL){
+            running = dispatch(cpu_clock, rq, verbose);
+            slice_used = 0;
+        } else {
+            // Remove the time step from remaining time until process completetion and next io event
+            // and charge the stride of the process for the time it ran
+            running->p->cpu_time_remaining -= (int) next_step;
+            running->p->io_time_remaining -= (int) next_step;
+            running->p->pass += running->p->stride * next_step;
+            slice_used += (int) next_step;
+
+            if(running->p->cpu_time_remaining <= 0 || running->p->io_time_remaining <= 0){
+                // The process is no longer runnable, close its share interval
+                running->p->entitled += running->p->tickets * (share_clock - running->p->runnable_mark);
+                runnable_tickets -= running->p->tickets;
+            }
+
+            if(running->p->cpu_time_remaining <= 0){
+                // The process is finished running, terminate it
+                running->p->s = STATE_TERMINATED;
+                running->next = NULL;
+                if(terminated_tail == NULL){
+                    terminated = running;
+                } else {
+                    terminated_tail->next = running;
+                }
+                terminated_tail = running;
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_TERMINATED);
+
+                running = dispatch(cpu_clock, rq, verbose);
+                slice_used = 0;
+            } else if(running->p->io_time_remaining <= 0){
+                // The process is blocked by io, update the timer and set state to waiting
+                // An io of 0ms still completes at the next step, 1ms later
+                running->p->io_time_remaining = burst_at(&running->p->io_bursts, running->p->burst, running->p->io_duration);
+                running->p->io_done = cpu_clock + running->p->io_time_remaining;
+                running->p->s = STATE_WAITING;
+                heap_push(waiting, cpu_clock + max(running->p->io_time_remaining, 1), running);
+                print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_WAITING);
+
+                running = dispatch(cpu_clock, rq, verbose);
+                slice_used = 0;
+            } else if(slice_used >= TIME_SLICE){
+                // The process used its time slice, it goes back to the ready queue if another one is ready
+                if(rq->size > 0){
+                    print_transition(cpu_clock, running->p, STATE_RUNNING, STATE_READY);
+                    ready_push(rq, running, true);
+                    running = dispatch(cpu_clock, rq, verbose);
+                }
+                slice_used = 0;
+            }
+        }
+
+        // Set the simulation time advance
+        next_step = get_time_to_next_event(cpu_clock, running, slice_used, arrivals, waiting);
+
+        if(verbose){
+            printf("-------------------------------------------------------------------------------------\n");
+            printf("At CPU time %lldms...\n", cpu_clock);
+            printf("-------------------------------\n");
+            printf("The CPU is currently running:\n");
+            print_nodes(running, cpu_clock);
+            printf("-------------------------------\n");
+            printf("The new process list is:\n");
+            print_heap(arrivals, cpu_clock);
+            printf("-------------------------------\n");
+            printf("The ready queue holds %d processes\n", rq->size);
+            printf("-------------------------------\n");
+            printf("The waiting list is:\n");
+            print_heap(waiting, cpu_clock);
+            printf("-------------------------------\n");
+            printf("The terminated list is:\n");
+            print_nodes(terminated, cpu_clock);
+            printf("-------------------------------------------------------------------------------------\n");
+        }
+
+        // The simulation is completed when all the queues are empty, in otherwords, all programs have run to completion
+        simulation_completed = (rq->size == 0) && heap_empty(arrivals) && heap_empty(waiting) && (running == NULL);
+    } while(!simulation_completed);
+    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(verbose) printf("Simulation completed in %lld ms.\n", cpu_clock);
+
+    print_share_report(terminated, policy);
+
+    // The simulation is done, all the nodes are in the terminated list, free them
+    free_ready_queue(rq);
+    heap_free(arrivals);
+    heap_free(waiting);
+    clean_up(terminated);
+    return 0;
+}
@@ -0,0 +1,474 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Tunes the round robin time slice of a workload     *
+* with libkernelsim. The candidate slices are a      *
+* geometric grid; they are compared by successive    *
+* halving: every round simulates the surviving       *
+* candidates on a prefix of the workload, keeps the  *
+* best half and doubles the prefix, until one        *
+* candidate is left and is simulated on the whole    *
+* workload. The candidates of a round run in         *
+* parallel, and a run stops as soon as its metric is *
+* certain to end up worse than the best finished run *
+* of the round by more than the margin.              *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "kernelSim.h"
+#include "simTime.h"
+
+#define MAX_CANDIDATES 256
+// The steps between two checks of a run against the best one
+#define CHECK_STEPS 4096
+
+enum METRIC {
+    METRIC_WAIT,
+    METRIC_TURNAROUND,
+    METRIC_RESPONSE
+};
+static const char *METRICS[] = { "wait", "turnaround", "response" };
+static const char *METRIC_TITLES[] = { "Mean ready time (ms)", "Mean turnaround (ms)", "P99 response (ms)" };
+static const char *METRIC_NAMES[] = { "mean ready time", "mean turnaround", "99th percentile response" };
+
+enum CANDIDATE_STATUS {
+    CANDIDATE_DONE,
+    CANDIDATE_STOPPED,
+    CANDIDATE_FAILED
+};
+
+// The processes of the workload, in the order of the file
+struct workload {
+    int count;
+    sim_time_t *arrival_time;
+    int *total_cpu_time;
+    int *io_frequency;
+    int *io_duration;
+};
+
+struct candidate {
+    int time_slice;
+    enum CANDIDATE_STATUS status;
+    double metric;
+    sim_time_t stopped_at;
+};
+
+// What a run collects from its transitions, the PID of a process is its row in the workload
+struct tally {
+    const struct workload *w;
+    int rows;
+    sim_time_t *ready_since;
+    sim_time_t *response;
+    long long ready_time;
+    long long turnaround;
+};
+
+struct tuner {
+    struct workload w;
+    struct ks_config base;
+    enum METRIC metric;
+    double margin;
+    struct candidate **round;
+    int round_size;
+    int rows;
+    int next;
+    int have_best;
+    double best;
+    long long simulations;
+    long long stopped;
+    pthread_mutex_t lock;
+};
+
+/* FUNCTION DESCRIPTION: load_workload
+* Reads the CSV in the input format of the simulators, like ks_load_csv
+* The library takes one value per column, a burst sequence counts as its first burst
+* The columns must fit the 32 bit times of the library, the rows out of range are skipped like the simulators do
+* The return value is 0, or -1 if the file cannot be read or has no process
+*/
+int load_workload(const char *input_file, struct workload *w){
+    char *line = NULL, *save, *fields[5];
+    size_t size = 0;
+    int capacity = 1024, sequences = 0, valid;
+    long long columns[4];
+
+    FILE *f = fopen(input_file, "r");
+    if(f == NULL){
+        perror("Cannot open the workload");
+        return -1;
+    }
+    memset(w, 0, sizeof(struct workload));
+    w->arrival_time = (sim_time_t *) malloc(capacity * sizeof(sim_time_t));
+    w->total_cpu_time = (int *) malloc(capacity * sizeof(int));
+    w->io_frequency = (int *) malloc(capacity * sizeof(int));
+    w->io_duration = (int *) malloc(capacity * sizeof(int));
+    assert(w->arrival_time != NULL && w->total_cpu_time != NULL && w->io_frequency != NULL && w->io_duration != NULL);
+
+    // The first row has the header values
+    if(getline(&line, &size, f) != -1){
+        while(getline(&line, &size, f) != -1){
+            if(strlen(line) < 10) continue;
+            if(strchr(line, ';') != NULL) sequences++;
+            valid = 1;
+            for(int i = 0; i < 5 && valid; i++){
+                fields[i] = strtok_r((i == 0) ? line : NULL, ",", &save);
+                valid = (fields[i] != NULL);
+            }
+            if(!valid) continue;
+            // A process the library would refuse is skipped, every candidate would fail on it
+            // Only the first burst of a sequence is checked, it is the one the library simulates
+            fields[3][strcspn(fields[3], ";")] = '\0';
+            fields[4][strcspn(fields[4], ";")] = '\0';
+            if(sim_parse_field(fields[1], "Arrival Time", 0, SIM_TIME_LIMIT, &columns[0]) != 0 ||
+                sim_parse_field(fields[2], "Total CPU Time", 1, SIM_DURATION_MAX, &columns[1]) != 0 ||
+                sim_parse_field(fields[3], "I/O Frequency", 0, SIM_DURATION_MAX, &columns[2]) != 0 ||
+                sim_parse_field(fields[4], "I/O Duration", 0, SIM_DURATION_MAX, &columns[3]) != 0) continue;
+            if(w->count == capacity){
+                capacity *= 2;
+                w->arrival_time = (sim_time_t *) realloc(w->arrival_time, capacity * sizeof(sim_time_t));
+                w->total_cpu_time = (int *) realloc(w->total_cpu_time, capacity * sizeof(int));
+                w->io_frequency = (int *) realloc(w->io_frequency, capacity * sizeof(int));
+                w->io_duration = (int *) realloc(w->io_duration, capacity * sizeof(int));
+                assert(w->arrival_time != NULL && w->total_cpu_time != NULL && w->io_frequency != NULL && w->io_duration != NULL);
+            }
+            w->arrival_time[w->count] = columns[0];
+            w->total_cpu_time[w->count] = (int) columns[1];
+            w->io_frequency[w->count] = (int) columns[2];
+            w->io_duration[w->count] = (int) columns[3];
+            w->count++;
+        }
+    }
+    free(line);
+    fclose(f);
+    if(sequences > 0) fprintf(stderr, "%d processes have burst sequences, only their first bursts are simulated\n", sequences);
+    if(w->count == 0){
+        fprintf(stderr, "%s has no process\n", input_file);
+        return -1;
+    }
+    return 0;
+}
+
+void free_workload(struct workload *w){
+    free(w->arrival_time);
+    free(w->total_cpu_time);
+    free(w->io_frequency);
+    free(w->io_duration);
+}
+
+/* FUNCTION DESCRIPTION: count_transition
+* The transition callback of a run, it adds up the metrics as the simulation goes
+*/
+void count_transition(void *context, sim_time_t time, sim_pid_t pid, enum KS_STATE old_state, enum KS_STATE new_state){
+    struct tally *t = (struct tally *) context;
+
+    (void) old_state;
+    if(new_state == KS_READY){
+        t->ready_since[pid] = time;
+    } else if(new_state == KS_RUNNING){
+        t->ready_time += time - t->ready_since[pid];
+        if(t->response[pid] < 0) t->response[pid] = time - t->w->arrival_time[pid];
+    } else if(new_state == KS_TERMINATED){
+        t->turnaround += time - t->w->arrival_time[pid];
+    }
+}
+
+// Orders response times
+int compare_time(const void *a, const void *b){
+    sim_time_t x = *(const sim_time_t *) a, y = *(const sim_time_t *) b;
+    return (x > y) - (x < y);
+}
+
+// The rank of the 99th percentile of n values, counted from 1 (nearest rank)
+int p99_rank(int n){
+    return (int) ceil(0.99 * n);
+}
+
+/* FUNCTION DESCRIPTION: final_metric
+* The metric of a run that completed
+*/
+double final_metric(enum METRIC metric, struct tally *t){
+    if(metric == METRIC_WAIT) return (double) t->ready_time / t->rows;
+    if(metric == METRIC_TURNAROUND) return (double) t->turnaround / t->rows;
+    // Every process ran, the responses can be sorted in place
+    qsort(t->response, t->rows, sizeof(sim_time_t), compare_time);
+    return t->response[p99_rank(t->rows) - 1];
+}
+
+/* FUNCTION DESCRIPTION: dominated
+* True when a run that is not finished is certain to end up worse than limit
+* The sums only grow, and the 99th percentile is above limit once more responses than the last 1% are
+*/
+int dominated(enum METRIC metric, struct tally *t, double limit){
+    int above = 0;
+
+    if(metric == METRIC_WAIT) return t->ready_time > limit * t->rows;
+    if(metric == METRIC_TURNAROUND) return t->turnaround > limit * t->rows;
+    for(int i = 0; i < t->rows; i++){
+        if(t->response[i] > limit) above++;
+    }
+    return above > t->rows - p99_rank(t->rows);
+}
+
+/* FUNCTION DESCRIPTION: run_candidate
+* Simulates a candidate on the first rows of the workload, stopping when it is dominated by the best run of the round
+*/
+void run_candidate(struct tuner *tn, struct candidate *c){
+    struct ks_config config = tn->base;
+    struct tally t;
+    ks_sim_t *sim;
+    long long steps = 0;
+    double limit;
+    int result, have_best;
+
+    memset(&t, 0, sizeof(t));
+    t.w = &tn->w;
+    t.rows = tn->rows;
+    t.ready_since = (sim_time_t *) malloc(t.rows * sizeof(sim_time_t));
+    t.response = (sim_time_t *) malloc(t.rows * sizeof(sim_time_t));
+    assert(t.ready_since != NULL && t.response != NULL);
+    for(int i = 0; i < t.rows; i++) t.response[i] = -1;
+
+    c->status = CANDIDATE_FAILED;
+    config.time_slice = c->time_slice;
+    sim = ks_create();
+    if(sim == NULL || ks_configure(sim, &config) != KS_OK) goto done;
+    for(int i = 0; i < t.rows; i++){
+        if(ks_add_process(sim, i, tn->w.arrival_time[i], tn->w.total_cpu_time[i], tn->w.io_frequency[i],
+            tn->w.io_duration[i]) != KS_OK) goto done;
+    }
+    ks_set_transition_callback(sim, count_transition, &t);
+
+    while((result = ks_step(sim)) > 0){
+        if(++steps % CHECK_STEPS != 0) continue;
+        pthread_mutex_lock(&tn->lock);
+        have_best = tn->have_best;
+        limit = tn->best * (1 + tn->margin);
+        pthread_mutex_unlock(&tn->lock);
+        if(have_best && dominated(tn->metric, &t, limit)){
+            c->status = CANDIDATE_STOPPED;
+            c->stopped_at = ks_time(sim);
+            break;
+        }
+    }
+    if(result == 0){
+        c->status = CANDIDATE_DONE;
+        c->metric = final_metric(tn->metric, &t);
+        pthread_mutex_lock(&tn->lock);
+        if(!tn->have_best || c->metric < tn->best) tn->best = c->metric;
+        tn->have_best = 1;
+        pthread_mutex_unlock(&tn->lock);
+    }
+
+done:
+    pthread_mutex_lock(&tn->lock);
+    tn->simulations++;
+    if(c->status == CANDIDATE_STOPPED) tn->stopped++;
+    pthread_mutex_unlock(&tn->lock);
+    ks_destroy(sim);
+    free(t.ready_since);
+    free(t.response);
+}
+
+// A worker thread, it takes the next candidate of the round until there is none
+void *run_worker(void *arg){
+    struct tuner *tn = (struct tuner *) arg;
+    struct candidate *c;
+
+    for(;;){
+        pthread_mutex_lock(&tn->lock);
+        c = (tn->next < tn->round_size) ? tn->round[tn->next++] : NULL;
+        pthread_mutex_unlock(&tn->lock);
+        if(c == NULL) return NULL;
+        run_candidate(tn, c);
+    }
+}
+
+/* FUNCTION DESCRIPTION: run_round
+* Simulates the candidates of a round on jobs threads, in their order: the best of the last round go first
+* so that the runs that follow can be stopped early
+*/
+void run_round(struct tuner *tn, int jobs){
+    pthread_t threads[MAX_CANDIDATES];
+    int created = 0;
+
+    tn->next = 0;
+    tn->have_best = 0;
+    if(jobs > tn->round_size) jobs = tn->round_size;
+    for(int i = 1; i < jobs; i++){
+        if(pthread_create(&threads[created], NULL, run_worker, tn) != 0) break;
+        created++;
+    }
+    // This thread is a worker too, the round completes even when no thread can be created
+    run_worker(tn);
+    for(int i = 0; i < created; i++) pthread_join(threads[i], NULL);
+}
+
+// Orders the candidates: finished ones by metric, then stopped, then failed
+int compare_candidates(const void *a, const void *b){
+    const struct candidate *x = *(const struct candidate * const *) a, *y = *(const struct candidate * const *) b;
+
+    if(x->status != y->status) return (int) x->status - (int) y->status;
+    if(x->status == CANDIDATE_DONE && x->metric != y->metric) return (x->metric > y->metric) - (x->metric < y->metric);
+    return x->time_slice - y->time_slice;
+}
+
+// Orders the candidates by time slice, for the curve
+int compare_slices(const void *a, const void *b){
+    return (*(const struct candidate * const *) a)->time_slice - (*(const struct candidate * const *) b)->time_slice;
+}
+
+/* FUNCTION DESCRIPTION: print_round
+* Prints the metric of every candidate of the round against its time slice, and what became of it
+* The first kept candidate of the last round is the chosen one
+*/
+void print_round(struct tuner *tn, int round, struct candidate **ranked, int kept, int last){
+    struct candidate *by_slice[MAX_CANDIDATES];
+
+    memcpy(by_slice, ranked, tn->round_size * sizeof(struct candidate *));
+    qsort(by_slice, tn->round_size, sizeof(struct candidate *), compare_slices);
+    for(int i = 0; i < tn->round_size; i++){
+        struct candidate *c = by_slice[i];
+        int rank = 0;
+
+        while(ranked[rank] != c) rank++;
+        printf("%d,%d,%d,", round, tn->rows, c->time_slice);
+        if(c->status == CANDIDATE_DONE) printf("%.2f,%s\n", c->metric, (rank >= kept) ? "dropped" : (last ? "chosen" : "kept"));
+        else if(c->status == CANDIDATE_STOPPED) printf(",stopped at %lldms\n", c->stopped_at);
+        else printf(",failed\n");
+    }
+    fflush(stdout);
+}
+
+/* FUNCTION DESCRIPTION: make_grid
+* Fills the candidates with count time slices spread geometrically from low to high, without duplicates
+* The return value is the number of candidates
+*/
+int make_grid(struct candidate *candidates, int low, int high, int count){
+    int n = 0, slice;
+
+    for(int i = 0; i < count; i++){
+        slice = (count == 1) ? low : (int) lround(low * pow((double) high / low, (double) i / (count - 1)));
+        if(n > 0 && slice <= candidates[n - 1].time_slice) continue;
+        memset(&candidates[n], 0, sizeof(struct candidate));
+        candidates[n++].time_slice = slice;
+    }
+    return n;
+}
+
+double now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-m wait|turnaround|response] [-r min_slice,max_slice] [-k candidates] [-j jobs] [-n min_rows] "
+        "[-e margin] [-c switch_ms] [-w penalty,decay[,migration]] <input_file.csv>\n", name);
+}
+
+int main(int argc, char *argv[]){
+    struct tuner tn;
+    struct candidate candidates[MAX_CANDIDATES], *survivors[MAX_CANDIDATES];
+    int low = 1, high = 50, count = 16, jobs, min_rows = 500, opt, fields, kept, rounds, finished;
+    double start = now();
+
+    memset(&tn, 0, sizeof(tn));
+    ks_config_default(&tn.base);
+    tn.metric = METRIC_WAIT;
+    tn.margin = 0.1;
+    jobs = (int) sysconf(_SC_NPROCESSORS_ONLN);
+
+    // -m: the metric to minimize, -r: the range of time slices, -k: the number of candidates in it
+    // -j: the simulations run at once, -n: the rows of the first round
+    // -e: how much worse than the best a run must be certain to end to be stopped, 0.1 is 10%
+    // -c, -w: context switch costs, like the simulators
+    while((opt = getopt(argc, argv, "m:r:k:j:n:e:c:w:")) != -1){
+        if(opt == 'm'){
+            for(fields = 0; fields < 3 && strcmp(optarg, METRICS[fields]) != 0; fields++);
+            if(fields == 3){
+                print_usage(argv[0]);
+                return -1;
+            }
+            tn.metric = (enum METRIC) fields;
+        } else if(opt == 'r'){
+            if(sscanf(optarg, "%d,%d", &low, &high) != 2){
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if(opt == 'k'){
+            count = atoi(optarg);
+        } else if(opt == 'j'){
+            jobs = atoi(optarg);
+        } else if(opt == 'n'){
+            min_rows = atoi(optarg);
+        } else if(opt == 'e'){
+            tn.margin = atof(optarg);
+        } else if(opt == 'c'){
+            tn.base.switch_cost = atoi(optarg);
+        } else if(opt == 'w'){
+            fields = sscanf(optarg, "%d,%d,%d", &tn.base.cache_penalty, &tn.base.cache_decay, &tn.base.migration_penalty);
+            if(fields < 2){
+                fprintf(stderr, "Expected <penalty>,<decay>[,<migration>] for the cache, got %s\n", optarg);
+                return -1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - optind != 1 || low < 1 || high < low || count < 1 || count > MAX_CANDIDATES || jobs < 1
+        || min_rows < 1 || tn.margin < 0){
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(load_workload(argv[optind], &tn.w) != 0) return -1;
+    pthread_mutex_init(&tn.lock, NULL);
+
+    tn.round_size = make_grid(candidates, low, high, count);
+    for(int i = 0; i < tn.round_size; i++) survivors[i] = &candidates[i];
+    // Halving the candidates takes ceil(log2(candidates)) rounds, the first one on the smallest prefix
+    for(rounds = 1; (1 << (rounds - 1)) < tn.round_size; rounds++);
+    tn.rows = tn.w.count >> (rounds - 1);
+    if(tn.rows < min_rows) tn.rows = (min_rows < tn.w.count) ? min_rows : tn.w.count;
+
+    printf("Round,Rows,Time slice,%s,Status\n", METRIC_TITLES[tn.metric]);
+    for(int round = 1; ; round++){
+        tn.round = survivors;
+        run_round(&tn, jobs);
+        qsort(survivors, tn.round_size, sizeof(struct candidate *), compare_candidates);
+        for(finished = 0; finished < tn.round_size && survivors[finished]->status == CANDIDATE_DONE; finished++);
+        if(finished == 0){
+            print_round(&tn, round, survivors, 0, 1);
+            fprintf(stderr, "No candidate could be simulated\n");
+            free_workload(&tn.w);
+            return -1;
+        }
+        // The last round has a single candidate on the whole workload
+        if(tn.round_size == 1 && tn.rows == tn.w.count){
+            print_round(&tn, round, survivors, 1, 1);
+            break;
+        }
+        kept = (tn.round_size + 1) / 2;
+        if(kept > finished) kept = finished;
+        print_round(&tn, round, survivors, kept, 0);
+        tn.round_size = kept;
+        tn.rows = (kept == 1 || 2 * (long long) tn.rows >= tn.w.count) ? tn.w.count : 2 * tn.rows;
+    }
+
+    fprintf(stderr, "Chosen time slice: %dms, %s %.2fms on %d processes\n", survivors[0]->time_slice,
+        METRIC_NAMES[tn.metric], survivors[0]->metric, tn.w.count);
+    fprintf(stderr, "%lld simulations, %lld stopped early, %.2fs\n", tn.simulations, tn.stopped, now() - start);
+
+    pthread_mutex_destroy(&tn.lock);
+    free_workload(&tn.w);
+    return 0;
+}
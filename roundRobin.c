@@ -14,6 +14,16 @@
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
+#include <unistd.h>
+#include "ioDevice.h"
+#include "switchCost.h"
+#include "traceExport.h"
+#include "workloadStream.h"
+#include "waitTimers.h"
+#include "flightRecorder.h"
+#include "liveStats.h"
+#include "burstPool.h"
+#include "energyModel.h"
 #define TIME_SLICE 3
 
 // Macro to return the min of a and b
@@ -32,14 +42,24 @@ static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATE
 // A structure containing all the relovant meta data for a process, this is the PCB like struct
 // The io_time_remaining is used in two ways: 
 // it counts how long until the next io call and how long until a current io call is complete
+// cpu_bursts and io_bursts are the sequences of the I/O Frequency and I/O Duration columns, burst counts the I/O done
+// io is the request of the process when it blocks on an I/O device
+// switch_remaining is the dispatch overhead the running process still has to pay before it makes progress
+// The times and the PID are 64 bit (see simTime.h), the CPU times and the timers are durations and stay 32 bit
 struct process {
-    int pid;
-    int arrival_time;
+    sim_pid_t pid;
+    sim_time_t arrival_time;
     int total_cpu_time;
     int cpu_time_remaining;
     int io_frequency;
     int io_duration;
     int io_time_remaining;
+    struct burst_seq cpu_bursts;
+    struct burst_seq io_bursts;
+    int burst;
+    struct io_request io;
+    int switch_remaining;
+    struct cache_state cache;
     enum STATE s;
 };
 
@@ -66,7 +86,7 @@ typedef struct node *node_t;
 *    -io_duration
 * The return value is a pointer to new process structure
 */
-proc_t create_proc(int pid, int arrival_time, int total_cpu_time, int io_frequency, int io_duration){
+proc_t create_proc(sim_pid_t pid, sim_time_t arrival_time, int total_cpu_time, int io_frequency, int io_duration){
     // Initialize memory
     proc_t temp; 
     temp = (proc_t) malloc(sizeof(struct process)); 
@@ -81,6 +101,11 @@ proc_t create_proc(int pid, int arrival_time, int total_cpu_time, int io_frequen
     temp->io_frequency = io_frequency;
     temp->io_duration = io_duration;
     temp->io_time_remaining = io_frequency;
+    temp->cpu_bursts.chunk = temp->io_bursts.chunk = NULL;
+    temp->cpu_bursts.count = temp->io_bursts.count = 1;
+    temp->burst = 0;
+    temp->switch_remaining = 0;
+    cache_state_init(&temp->cache);
     temp->s = STATE_NEW;
     return temp;
 }
@@ -117,8 +142,8 @@ void print_nodes(node_t head) {
 
     while (current != NULL) {
         p = current->p;
-        printf("Process ID: %d\n", p->pid);
-        printf("CPU Arrival Time: %dms\n", p->arrival_time);
+        printf("Process ID: %lld\n", p->pid);
+        printf("CPU Arrival Time: %lldms\n", p->arrival_time);
         printf("Time Remaining: %dms of %dms\n", p->cpu_time_remaining, p->total_cpu_time);
         printf("IO Duration: %dms\n", p->io_duration);
         printf("IO Frequency: %dms\n", p->io_frequency);
@@ -129,6 +154,31 @@ void print_nodes(node_t head) {
     }
 }
 
+/* FUNCTION DESCRIPTION: print_waiting
+* Prints the processes waiting for io, with the time left on their timer
+*/
+void print_waiting(wait_t waiting){
+    node_t node;
+
+    if(wait_count(waiting) == 0){
+        printf("EMPTY\n");
+        return;
+    }
+    for(int i = 0; i < wait_count(waiting); i++){
+        node = (node_t) waiting->owners[i];
+        node->p->io_time_remaining = waiting->remaining[i];
+        print_nodes(node);
+    }
+}
+
+// The number of nodes in a list
+int count_nodes(node_t head){
+    int count = 0;
+
+    for(; head != NULL; head = head->next) count++;
+    return count;
+}
+
 /* FUNCTION DESCRIPTION: push_node
 * This function adds a node to the back of the list (as though its a queue).
 * The parameters are: 
@@ -198,44 +248,58 @@ int remove_node(node_t *head, node_t to_be_removed){
 * The return value is a list of thes new prcesses
 */
 node_t read_proc_from_file(char *input_file){
-    int MAXCHAR = 128;
+    int MAXCHAR = 4096;
     char row[MAXCHAR];
     node_t new_list=NULL, node;
     proc_t proc;
-    int pid, arrival_time, total_cpu_time, io_frequency, io_duration;
+    struct workload_row columns;
 
     FILE* f = fopen(input_file, "r");
     if(f == NULL){
         // file not opened, fail gracefully
         printf("NULL FILE\n\n\n\n");
-      //  assert(false);
+        return NULL;
     } 
     // Get the first row, which has the header values
     //Pid;Arrival Time;Total CPU Time;I/O Frequency;I/O Duration
     fgets(row, MAXCHAR, f);
     // Read the remainder of the rows until you get to the end of the file
-    do {
-        // get the next data row
-        fgets(row, MAXCHAR, f);
-        // make sure it has at least enough char to be valid
-        if(strlen(row)<10) continue;
-        // atoi turns a string into an integer
-        // strtok(row,";") tokenizes the row around the ';' charaters
-        // strtok(NULL, ";") gets the next token in the row
-        // We are assuming that the file is setup as a CSV in the correct format
-        pid = atoi(strtok(row, ","));
-        arrival_time = atoi(strtok(NULL, ","));
-        total_cpu_time = atoi(strtok(NULL, ","));
-        io_frequency = atoi(strtok(NULL, ","));
-        io_duration = atoi(strtok(NULL, ","));
-
+    // The rows are decoded like the streaming input: short rows and rows with a column out of range are skipped,
+    // and the io columns are one value or a sequence of bursts
+    while(stream_read_row(f, 0, 1, &columns) > 0){
         // We create a process struct and pass it too create node, then add this node to the new_list
-        proc = create_proc(pid, arrival_time, total_cpu_time, io_frequency, io_duration);
+        proc = create_proc(columns.pid, columns.arrival_time, columns.total_cpu_time, columns.io_frequency, columns.io_duration);
+        proc->cpu_bursts = columns.cpu_bursts;
+        proc->io_bursts = columns.io_bursts;
         node = create_node(proc);
         new_list = push_node(new_list, node);
-        
-    } while (feof(f) != true);
+    }
 
+    fclose(f);
+    burst_pool_free();
+    return new_list;
+}
+
+/* FUNCTION DESCRIPTION: stream_arrivals
+* In streaming mode, adds to the new list the processes that arrive by cpu_clock and the first one
+* arriving after it, so that only the processes that arrived are in memory
+* The parameters are:
+*    - stream: the input, NULL when every process was loaded up front
+*    - new_list: the list of processes that have yet to arrive
+*    - cpu_clock: Time since the start of the simulation
+* The return value is the new list
+*/
+node_t stream_arrivals(stream_t stream, node_t new_list, sim_time_t cpu_clock){
+    struct workload_row row;
+    proc_t p;
+
+    while(stream_due(stream, cpu_clock)){
+        stream_take(stream, &row);
+        p = create_proc(row.pid, row.arrival_time, row.total_cpu_time, row.io_frequency, row.io_duration);
+        p->cpu_bursts = row.cpu_bursts;
+        p->io_bursts = row.io_bursts;
+        new_list = push_node(new_list, create_node(p));
+    }
     return new_list;
 }
 
@@ -245,16 +309,22 @@ node_t read_proc_from_file(char *input_file){
 *    - cpu_clock: Time since the start of the simulation
 *    - running: The node containing the currently running process
 *    - new queue: The list of precess that have yet to arrive in the cpu
-*    - waiting_list: The list of processes that are waiting for io
+*    - waiting: The I/O timers of the processes that are waiting for io
+*    - devices: The I/O devices, NULL when I/O is not limited by devices
+*    - energy: The energy model, NULL when the CPU always runs at full speed
+*    - slice_left: The time left in the time slice of the running process
 * The return value is the time until the next event
 */
-int get_time_to_next_event(int cpu_clock, node_t running, node_t new_list, node_t waiting_list){
+sim_time_t get_time_to_next_event(sim_time_t cpu_clock, node_t running, node_t new_list, wait_t waiting, io_system_t devices, energy_t energy, int slice_left){
     node_t temp;
-    int next_exit=INT_MAX, next_block=INT_MAX, next_arrival=INT_MAX, next_io=INT_MAX;
+    sim_time_t next_exit=SIM_TIME_MAX, next_block=SIM_TIME_MAX, next_arrival=SIM_TIME_MAX, next_io=SIM_TIME_MAX, next_slice=SIM_TIME_MAX;
 
+    // The sums of two 32 bit durations are computed in 64 bit
     if(running != NULL){
-        next_exit = running->p->cpu_time_remaining;
-        next_block = running->p->io_time_remaining;
+        // The remaining times are progress, which takes longer below the highest frequency
+        next_exit = running->p->switch_remaining + energy_time_for(energy, running->p->pid, running->p->cpu_time_remaining);
+        next_block = running->p->switch_remaining + energy_time_for(energy, running->p->pid, running->p->io_time_remaining);
+        next_slice = running->p->switch_remaining + energy_time_for(energy, running->p->pid, slice_left);
     }
 
     // Search the new queue for the time until its next event 
@@ -264,18 +334,28 @@ int get_time_to_next_event(int cpu_clock, node_t running, node_t new_list, node_
         temp = temp->next;
     }
     
-    // Search the waiting queue for the time until its next event
-    temp = waiting_list;
-    while(temp != NULL){
-        next_io = min(temp->p->io_time_remaining, next_io);
-        temp = temp->next;
+    // Search the waiting timers for the time until their next event
+    next_io = wait_next(waiting);
+    if(io_next_completion(devices) != SIM_TIME_MAX){
+        next_io = min(io_next_completion(devices) - cpu_clock, next_io);
     }
 
-    int min_time = min(min(next_exit, next_block), min(next_arrival, next_io));
+    sim_time_t min_time = min(min(min(next_exit, next_block), min(next_arrival, next_io)), next_slice);
+    // The governor samples the load on its period, as long as something else is left to happen
+    if(min_time != SIM_TIME_MAX) min_time = min(min_time, energy_next_sample(energy, cpu_clock));
     return (min_time == 0) ? 1 : min_time;
 }
 
 
+/* FUNCTION DESCRIPTION: print_transition
+* Prints one state transition, and adds it to the trace and the flight recorder when they are on
+*/
+void print_transition(trace_t trace, recorder_t recorder, sim_time_t cpu_clock, proc_t p, enum STATE old_state, enum STATE new_state){
+    printf("%lld,%lld,%s,%s\n", cpu_clock, p->pid, STATES[old_state], STATES[new_state]);
+    recorder_transition(recorder, cpu_clock, p->pid, STATES[old_state], STATES[new_state]);
+    trace_transition(trace, cpu_clock, p->pid, 0, (enum TRACE_STATE) old_state, (enum TRACE_STATE) new_state);
+}
+
 /* FUNCTION DESCRIPTION: clean_up
 * This function frees all the dynamically allocated heap memory
 * The parameters are: 
@@ -286,38 +366,122 @@ void clean_up(node_t list){
     while(list != NULL){
         temp = list;
         list = list->next;
+        burst_free(&temp->p->cpu_bursts);
+        burst_free(&temp->p->io_bursts);
         free(temp->p);
         free(temp);
     }
 }
 
 int main( int argc, char *argv[]) {
-    int next_step = 0, cpu_clock = 0, current_time = 0;
+    sim_time_t next_step = 0, cpu_clock = 0;
+    int slice_used = 0, time_slice = TIME_SLICE;
     bool simulation_completed = false;
-    node_t ready_list = NULL, new_list = NULL, waiting_list = NULL, terminated = NULL, temp, node;
+    node_t ready_list = NULL, new_list = NULL, terminated = NULL, temp, node;
     node_t running = NULL;
+    io_system_t devices = NULL;
+    wait_t waiting = wait_create(16);
+    struct switch_model costs;
+    trace_t trace = NULL;
+    recorder_t recorder = NULL;
+    live_t live = NULL;
+    char *live_name = NULL;
+    energy_t energy = NULL;
+    char *state_file = NULL, *governor = NULL;
+    long long completed = 0, busy_time = 0;
+    char *trace_file = NULL;
+    stream_t stream = NULL;
+    bool streaming = false, pipelined = false;
+    sim_time_t progress;
+    int used;
     char *input_file;
-    int verbose;
-   
+    int verbose, opt;
+
+    // -d <devices.csv>: processes block on I/O devices with a limited concurrency
+    // -c <ms>: fixed cost of a context switch
+    // -w <penalty>,<decay>[,<migration>]: cache refill penalty of a process that was off the CPU
+    // -t <trace.json>: stream the transitions as a Chrome trace event file
+    // -s: read the input as the simulation goes and free the terminated processes, the input must be sorted by arrival time
+    // -P: like -s, with the input decoded on a parser thread
+    // -F <events>[,<interval>]: keep the last transitions and queue samples instead of printing the queues every step
+    // -L <name>: publish the progress in the shared memory segment <name> for liveMonitor
+    // -e <states.csv>: the frequency and idle states of the CPU and their power, the energy is reported on stderr
+    // -g <governor>[,<sampling_ms>]: how the frequency follows the load, the default states without -e
+    // -q <ms>: the time slice, TIME_SLICE by default
+    switch_model_init(&costs);
+    while((opt = getopt(argc, argv, "d:c:w:t:sPF:L:q:e:g:")) != -1){
+        if(opt == 'q'){
+            time_slice = atoi(optarg);
+            if(time_slice <= 0){
+                printf("The time slice must be at least 1ms.\n");
+                return -1;
+            }
+        } else if(opt == 'd'){
+            devices = io_system_load(optarg);
+            if(devices == NULL) return -1;
+        } else if(opt == 'c'){
+            costs.switch_cost = atoi(optarg);
+        } else if(opt == 'w'){
+            if(switch_model_parse_cache(&costs, optarg) != 0) return -1;
+        } else if(opt == 't'){
+            trace_file = optarg;
+        } else if(opt == 's'){
+            streaming = true;
+        } else if(opt == 'P'){
+            streaming = true;
+            pipelined = true;
+        } else if(opt == 'F'){
+            recorder = recorder_open(optarg, stderr);
+            if(recorder == NULL) return -1;
+        } else if(opt == 'L'){
+            live_name = optarg;
+        } else if(opt == 'e'){
+            state_file = optarg;
+        } else if(opt == 'g'){
+            governor = optarg;
+        } else {
+            printf("Usage: %s [-d devices.csv] [-c switch_ms] [-w penalty,decay[,migration]] [-t trace.json] [-s|-P] [-F events[,interval_ms]] [-L shm_name] [-q time_slice] [-e states.csv] [-g governor[,sampling_ms]] <input_file.csv> [verbose]\n", argv[0]);
+            return -1;
+        }
+    }
 
-    if(argc == 2){
-        input_file = argv[1];
+    if(argc - optind == 1){
+        input_file = argv[optind];
         verbose = 0;
-    } else if( argc == 3 ) {
-        input_file = argv[1];
-        verbose = atoi(argv[2]);
+    } else if(argc - optind == 2) {
+        input_file = argv[optind];
+        verbose = atoi(argv[optind + 1]);
     } else {
         printf("Two or three args expected.\n");
         return -1;
     }
 
     // Process meta data should be read from a text file
-    if(verbose) printf("------------------------------- Loading all processes -------------------------------\n");
-    new_list = read_proc_from_file(input_file);
-    if(verbose) print_nodes(new_list);
-    if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    if(streaming){
+        stream = stream_open(input_file, pipelined);
+        if(stream == NULL) return -1;
+    } else {
+        if(verbose) printf("------------------------------- Loading all processes -------------------------------\n");
+        new_list = read_proc_from_file(input_file);
+        if(verbose) print_nodes(new_list);
+        if(verbose) printf("-------------------------------------------------------------------------------------\n");
+    }
     if(verbose) printf("Starting simulation...\n");
 
+    // The devices are known once all the options are parsed
+    if(trace_file != NULL){
+        trace = trace_open(trace_file, 1, devices);
+        if(trace == NULL) return -1;
+    }
+    if(state_file != NULL || governor != NULL){
+        energy = energy_open(state_file, governor);
+        if(energy == NULL) return -1;
+    }
+    if(live_name != NULL){
+        live = live_open(live_name, "round robin");
+        if(live == NULL) return -1;
+    }
+
     // print the headers
     printf("Time of transition,PID,Old State,New State\n");
     // Simulation loop
@@ -325,28 +489,27 @@ int main( int argc, char *argv[]) {
         // Update timers to reflect next simulation step
         // Advance the cpu clock time
         cpu_clock += next_step;
+        new_list = stream_arrivals(stream, new_list, cpu_clock);
         // Advance all the io timers for processes in waiting state
-        node = waiting_list;
-
-        while(node != NULL){
-            if (node ==NULL) break;
-            node->p->io_time_remaining -= next_step;
-            if(node->p->io_time_remaining <= 0){
-                // This process is ready, it should change states from waiting to ready
-                // Update the time of next io event to the frequency of its occurance
-                // add it to the ready queue and remove it from waiting list
-                node->p->s = STATE_READY;
-                node->p->io_time_remaining = node->p->io_frequency;
-
-                temp = node->next;
-                remove_node(&waiting_list, node);
-                ready_list = push_node(ready_list, node);
-                printf("%d,%d,%s,%s\n", cpu_clock, node->p->pid, STATES[STATE_WAITING], STATES[STATE_READY]);
+        // The processes whose I/O is complete should change states from waiting to ready, in the order they blocked
+        // Update the time of next io event to their next CPU burst and add them to the ready queue
+        wait_advance(waiting, next_step);
+        for(int i = 0; i < waiting->expired_count; i++){
+            node = (node_t) waiting->expired[i];
+            node->p->burst++;
+            node->p->io_time_remaining = burst_at(&node->p->cpu_bursts, node->p->burst, node->p->io_frequency);
+            node->p->s = STATE_READY;
+            ready_list = push_node(ready_list, node);
+            print_transition(trace, recorder, cpu_clock, node->p, STATE_WAITING, STATE_READY);
+        }
 
-                node = temp;
-            } else {
-                node = node->next;
-            }
+        // Move the processes whose I/O completed on a device to the ready queue
+        while((node = (node_t) io_complete(devices, cpu_clock)) != NULL){
+            node->p->burst++;
+            node->p->io_time_remaining = burst_at(&node->p->cpu_bursts, node->p->burst, node->p->io_frequency);
+            node->p->s = STATE_READY;
+            ready_list = push_node(ready_list, node);
+            print_transition(trace, recorder, cpu_clock, node->p, STATE_WAITING, STATE_READY);
         }
 
         // Check if any of the items in new queue should be moved to the ready queue
@@ -359,7 +522,7 @@ int main( int argc, char *argv[]) {
                 temp = node->next;
                 remove_node(&new_list, node);
                 ready_list = push_node(ready_list, node);
-                printf("%d,%d,%s,%s\n", cpu_clock, node->p->pid, STATES[STATE_NEW], STATES[STATE_READY]);
+                print_transition(trace, recorder, cpu_clock, node->p, STATE_NEW, STATE_READY);
                 
                 node = temp;
             } else {
@@ -372,90 +535,122 @@ int main( int argc, char *argv[]) {
             if(ready_list!=NULL){
                 running = ready_list;
                 running->p->s = STATE_RUNNING;
+                running->p->switch_remaining = switch_dispatch(&costs, &running->p->cache, running->p->pid, 0, cpu_clock);
                 remove_node(&ready_list, running);
-                printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_READY], STATES[STATE_RUNNING]);
-
-                current_time = cpu_clock;
+                print_transition(trace, recorder, cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+                slice_used = 0;
             } else{
                 running = NULL; 
-                if(verbose) printf("%d: CPU is idle\n", cpu_clock);
+                if(verbose) printf("%lld: CPU is idle\n", cpu_clock);
+                energy_idle(energy, cpu_clock);
             }
         } else {
             // if it is then remove the time step from remaining time until process completetion and next io event
-            running->p->cpu_time_remaining -= next_step;
-            running->p->io_time_remaining -= next_step;
+            // The time spent switching to the process is not progress
+            // What is left is at most the CPU time remaining, a 32 bit duration
+            progress = next_step;
+            if(running->p->switch_remaining > 0){
+                used = (int) min(progress, running->p->switch_remaining);
+                running->p->switch_remaining -= used;
+                progress -= used;
+            }
+            progress = energy_progress(energy, running->p->pid, progress);
+            running->p->cpu_time_remaining -= (int) progress;
+            running->p->io_time_remaining -= (int) progress;
+            slice_used += (int) progress;
             // if(verbose) printf("%d: PID %d has %dms until completion and %dms until io block\n", cpu_clock,  running->p->pid, running->p->cpu_time_remaining,running->p->io_time_remaining);
             
-            if(current_time >= TIME_SLICE){
-                // The process finished its allocated time, and is forced back to the ready state
-                running->p->s = STATE_READY;
-                ready_list = push_node(ready_list,running);
-                printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_RUNNING], STATES[STATE_READY]);
-
-                if(ready_list != NULL){
-                    running = ready_list;
-                    running->p->s = STATE_RUNNING;
-                    remove_node(&ready_list, running);
-                    printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_READY], STATES[STATE_RUNNING]);
-
-                    current_time = 0;
-                }else{
-                    running = NULL;
-                    if (verbose) printf("%d: CPU is idle\n", cpu_clock);
-                }
-            }   
-
-
-            else if(running->p->cpu_time_remaining <= 0){
+            if(running->p->cpu_time_remaining <= 0){
                 // The process is finished running, terminate it
                 running->p->s = STATE_TERMINATED;
-                terminated = push_node(terminated,running);
-                printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_RUNNING], STATES[STATE_TERMINATED]);
+                switch_leave(&running->p->cache, 0, cpu_clock);
+                print_transition(trace, recorder, cpu_clock, running->p, STATE_RUNNING, STATE_TERMINATED);
+                completed++;
+                if(stream != NULL){
+                    // Keep its metrics and free it, nothing refers to it anymore
+                    stream_retire(stream, running->p->pid, running->p->arrival_time, cpu_clock);
+                    burst_free(&running->p->cpu_bursts);
+                    burst_free(&running->p->io_bursts);
+                    free(running->p);
+                    free(running);
+                } else {
+                    terminated = push_node(terminated,running);
+                }
                 
                 if(ready_list!=NULL){
                     running = ready_list;
                     running->p->s = STATE_RUNNING;
+                    running->p->switch_remaining = switch_dispatch(&costs, &running->p->cache, running->p->pid, 0, cpu_clock);
                     remove_node(&ready_list, running);
-                    printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_READY], STATES[STATE_RUNNING]);
-                          
+                    print_transition(trace, recorder, cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+                    slice_used = 0;
                 } else{
                     running = NULL; 
-                    if(verbose) printf("%d: CPU is idle\n", cpu_clock);
+                    if(verbose) printf("%lld: CPU is idle\n", cpu_clock);
+                    energy_idle(energy, cpu_clock);
                 } 
 
             } else if(running->p->io_time_remaining <= 0){
                 // The process is blocked by io, update the timer and set state to waiting
-                running->p->io_time_remaining = running->p->io_duration;
+                running->p->io_time_remaining = burst_at(&running->p->io_bursts, running->p->burst, running->p->io_duration);
                 running->p->s = STATE_WAITING;
-                waiting_list = push_node(waiting_list,running);
-                printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_RUNNING], STATES[STATE_WAITING]);
+                switch_leave(&running->p->cache, 0, cpu_clock);
+                if(devices != NULL){
+                    io_submit(devices, &running->p->io, running, running->p->pid, running->p->io_time_remaining, cpu_clock);
+                } else {
+                    wait_add(waiting, running, running->p->io_time_remaining);
+                }
+                print_transition(trace, recorder, cpu_clock, running->p, STATE_RUNNING, STATE_WAITING);
 
                 if(ready_list!=NULL){
                     running = ready_list;
                     running->p->s = STATE_RUNNING;
+                    running->p->switch_remaining = switch_dispatch(&costs, &running->p->cache, running->p->pid, 0, cpu_clock);
                     remove_node(&ready_list, running);
-                    printf("%d,%d,%s,%s\n", cpu_clock, running->p->pid, STATES[STATE_READY], STATES[STATE_RUNNING]);
-
+                    print_transition(trace, recorder, cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+                    slice_used = 0;
                 } else {
                     running = NULL; 
-                    if(verbose) printf("%d: CPU is idle\n", cpu_clock);
+                    if(verbose) printf("%lld: CPU is idle\n", cpu_clock);
+                    energy_idle(energy, cpu_clock);
                 } 
-            }          
+            } else if(slice_used >= time_slice){
+                // The process used its time slice, it goes to the back of the ready queue if another process is waiting
+                // Alone, it keeps the CPU for another slice without a context switch
+                if(ready_list != NULL){
+                    running->p->s = STATE_READY;
+                    switch_leave(&running->p->cache, 0, cpu_clock);
+                    ready_list = push_node(ready_list, running);
+                    print_transition(trace, recorder, cpu_clock, running->p, STATE_RUNNING, STATE_READY);
+
+                    running = ready_list;
+                    running->p->s = STATE_RUNNING;
+                    running->p->switch_remaining = switch_dispatch(&costs, &running->p->cache, running->p->pid, 0, cpu_clock);
+                    remove_node(&ready_list, running);
+                    print_transition(trace, recorder, cpu_clock, running->p, STATE_READY, STATE_RUNNING);
+                }
+                slice_used = 0;
+            }
         }
 
+        // The frequency of the next step, the one that ended made its progress at the previous frequency
+        energy_govern(energy, cpu_clock);
+
         // Set the simulation time advance
-        next_step = get_time_to_next_event(cpu_clock, running, new_list, waiting_list);
+        next_step = get_time_to_next_event(cpu_clock, running, new_list, waiting, devices, energy, time_slice - slice_used);
         
         if (next_step == 0) {
             // Avoid infinite loop by terminating the simulation if next_step is 0
             printf("Simulation terminated due to zero time to next event.\n");
+            recorder_dump(recorder, cpu_clock, "zero time to next event");
             break;
         }
         //update current time
 
-        if(verbose){
+        // The flight recorder samples the queues on its interval instead of printing them every step
+        if(verbose && recorder == NULL){
             printf("-------------------------------------------------------------------------------------\n");
-            printf("At CPU time %dms...\n", cpu_clock);
+            printf("At CPU time %lldms...\n", cpu_clock);
             printf("-------------------------------\n");
             printf("The CPU is currently running:\n");
             print_nodes(running);
@@ -467,7 +662,8 @@ int main( int argc, char *argv[]) {
             print_nodes(ready_list);
             printf("-------------------------------\n");
             printf("The waiting list is:\n");
-            print_nodes(waiting_list);
+            print_waiting(waiting);
+            if(devices != NULL) printf("%d processes are blocked on a device\n", io_outstanding(devices));
             printf("-------------------------------\n");
             printf("The terminated list is:\n");
             print_nodes(terminated);
@@ -475,11 +671,44 @@ int main( int argc, char *argv[]) {
         }
 
         // The simulation is completed when all the queues are empty, in otherwords, all programs have run to completion
-        simulation_completed = (ready_list == NULL) && (new_list == NULL) && (waiting_list == NULL) && (running == NULL);
+        simulation_completed = (ready_list == NULL) && (new_list == NULL) && (wait_count(waiting) == 0) && (running == NULL) && io_idle(devices) && stream_done(stream);
+        recorder_poll(recorder, cpu_clock);
+        if(recorder_due(recorder, cpu_clock)){
+            recorder_sample(recorder, cpu_clock, (running != NULL) ? running->p->pid : -1, count_nodes(ready_list),
+                wait_count(waiting), io_outstanding(devices), count_nodes(new_list));
+        }
+        // The CPU is busy until the next event if a process holds it
+        if(running != NULL) busy_time += next_step;
+        energy_account(energy, cpu_clock, next_step, running != NULL);
+        if(live_due(live) || (live != NULL && simulation_completed)){
+            live_update(live, cpu_clock, completed, busy_time, (running != NULL) ? running->p->pid : -1, count_nodes(ready_list),
+                wait_count(waiting), io_outstanding(devices), count_nodes(new_list));
+        }
+        if(!simulation_completed && next_step == SIM_TIME_MAX){
+            // Nothing will ever happen again but processes are left, keep what led here
+            printf("Simulation terminated with processes left and no next event.\n");
+            recorder_dump(recorder, cpu_clock, "no next event");
+            break;
+        }
     } while(!simulation_completed);
     if(verbose) printf("-------------------------------------------------------------------------------------\n");
-    if(verbose) printf("Simulation completed in %d ms.\n", cpu_clock);
+    if(verbose) printf("Simulation completed in %lld ms.\n", cpu_clock);
+
+    // The report goes to stderr so that stdout only has the transitions
+    stream_print_report(stream, stderr);
+    io_print_report(devices, cpu_clock, stderr);
+    switch_print_report(&costs, "Round robin", cpu_clock, stderr);
+    energy_print_report(energy, "Round robin", cpu_clock, completed, stderr);
+
+    if(stream != NULL && stream->unsorted) recorder_dump(recorder, cpu_clock, "unsorted input");
+    trace_close(trace);
+    recorder_close(recorder);
+    live_close(live);
 
     // The simulation is done, all the nodes are in the terminated list, free them
+    stream_close(stream);
+    io_system_free(devices);
+    wait_free(waiting);
+    energy_close(energy);
     clean_up(terminated);
 }
@@ -0,0 +1,191 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* A workload of scripted processes run with          *
+* libkernelsim. Each process is a coroutine that     *
+* yields its CPU bursts, I/O and children to the     *
+* kernel, which a CSV row cannot express:            *
+*    - servers wait for requests on the network and  *
+*      fork a worker for each of them                *
+*    - interactive clients shorten their CPU bursts  *
+*      when they waited long in the ready queue, and *
+*      grow them back when the CPU is free           *
+* The transitions are printed like simulate.c and    *
+* the metrics on stderr.                             *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "kernelSim.h"
+
+static const char *POLICIES[] = { "fcfs", "rr", "priority" };
+static const char *OUTPUTS[] = { "metrics", "text", "binary" };
+
+// The parameters of the workload, shared by all the scripts
+struct scenario {
+    int requests;
+    int request_gap;
+    int work;
+    int disk;
+    int rounds;
+    int burst;
+    int think;
+};
+
+// Where the scripts keep their state across the yields
+#define COUNTER 0
+#define BURST 1
+
+/* FUNCTION DESCRIPTION: worker
+* Handles one request of a server: parses it, reads what it asks for from the disk and writes the answer
+*/
+void worker(struct ks_coroutine *co, struct ks_request *request){
+    const struct scenario *sc = (const struct scenario *) co->arg;
+
+    KS_BEGIN(co);
+    KS_RUN(co, request, 1 + rand() % sc->work);
+    KS_IO(co, request, 1 + rand() % sc->disk);
+    KS_RUN(co, request, 1);
+    KS_END(co, request);
+}
+
+/* FUNCTION DESCRIPTION: server
+* Waits for a request on the network and forks a worker for it, until it served all its requests
+*/
+void server(struct ks_coroutine *co, struct ks_request *request){
+    const struct scenario *sc = (const struct scenario *) co->arg;
+
+    KS_BEGIN(co);
+    for(co->vars[COUNTER] = 0; co->vars[COUNTER] < sc->requests; co->vars[COUNTER]++){
+        KS_IO(co, request, 1 + rand() % sc->request_gap);
+        KS_SPAWN(co, request, worker, co->arg);
+        KS_RUN(co, request, 1);
+    }
+    KS_END(co, request);
+}
+
+/* FUNCTION DESCRIPTION: client
+* Computes and waits for the user in rounds. When the last burst waited longer than it ran in the ready
+* queue the next one is halved, otherwise it grows by 1ms up to the burst of the scenario.
+*/
+void client(struct ks_coroutine *co, struct ks_request *request){
+    const struct scenario *sc = (const struct scenario *) co->arg;
+
+    KS_BEGIN(co);
+    co->vars[BURST] = sc->burst;
+    for(co->vars[COUNTER] = 0; co->vars[COUNTER] < sc->rounds; co->vars[COUNTER]++){
+        KS_RUN(co, request, co->vars[BURST]);
+        if(co->ready_wait > co->vars[BURST]){
+            co->vars[BURST] = (co->vars[BURST] > 1) ? co->vars[BURST] / 2 : 1;
+        } else if(co->vars[BURST] < sc->burst){
+            co->vars[BURST]++;
+        }
+        KS_IO(co, request, sc->think);
+    }
+    KS_END(co, request);
+}
+
+double now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-p rr|priority|fcfs] [-q time_slice] [-o text|binary|metrics] [-n servers] [-r requests] "
+        "[-c clients] [-k rounds] [-s seed]\n", name);
+}
+
+int main(int argc, char *argv[]){
+    struct scenario sc = { 20, 50, 8, 10, 10, 8, 20 };
+    struct ks_config config;
+    struct ks_metrics m;
+    enum KS_OUTPUT output = KS_OUTPUT_TEXT;
+    int servers = 100, clients = 1000, opt, found, pid = 1, arrival;
+    unsigned int seed = 1;
+    ks_sim_t *sim;
+    double start;
+
+    // -n servers with -r requests each, -c clients computing and waiting -k times, -s: the seed of the workload
+    ks_config_default(&config);
+    while((opt = getopt(argc, argv, "p:q:o:n:r:c:k:s:")) != -1){
+        found = 1;
+        if(opt == 'p'){
+            found = 0;
+            for(int i = KS_FCFS; i <= KS_PRIORITY; i++){
+                if(strcmp(optarg, POLICIES[i]) == 0){
+                    config.policy = (enum KS_POLICY) i;
+                    found = 1;
+                }
+            }
+        } else if(opt == 'q'){
+            config.time_slice = atoi(optarg);
+        } else if(opt == 'o'){
+            found = 0;
+            for(int i = KS_OUTPUT_METRICS; i <= KS_OUTPUT_BINARY; i++){
+                if(strcmp(optarg, OUTPUTS[i]) == 0){
+                    output = (enum KS_OUTPUT) i;
+                    found = 1;
+                }
+            }
+        } else if(opt == 'n'){
+            servers = atoi(optarg);
+        } else if(opt == 'r'){
+            sc.requests = atoi(optarg);
+        } else if(opt == 'c'){
+            clients = atoi(optarg);
+        } else if(opt == 'k'){
+            sc.rounds = atoi(optarg);
+        } else if(opt == 's'){
+            seed = (unsigned int) atoi(optarg);
+        } else {
+            found = 0;
+        }
+        if(!found){
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(optind != argc || servers < 0 || clients < 0 || sc.requests < 0 || sc.rounds < 0){
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    sim = ks_create();
+    if(sim == NULL || ks_configure(sim, &config) != KS_OK){
+        fprintf(stderr, "Invalid configuration\n");
+        ks_destroy(sim);
+        return -1;
+    }
+    // The scripts draw their bursts from rand, the same seed gives the same run
+    srand(seed);
+    for(int i = 0; i < servers + clients; i++){
+        arrival = rand() % 100;
+        if(ks_add_script(sim, pid++, arrival, (i < servers) ? server : client, &sc) != KS_OK){
+            fprintf(stderr, "Cannot add the process %d\n", pid - 1);
+            ks_destroy(sim);
+            return -1;
+        }
+    }
+
+    if(output == KS_OUTPUT_TEXT) printf("Time of transition,PID,Old State,New State\n");
+    start = now();
+    ks_run_output(sim, output, stdout);
+    fflush(stdout);
+
+    ks_get_metrics(sim, &m);
+    fprintf(stderr, "Simulation completed in %lldms: %d of %d processes, %lld transitions, %.2f%% utilization\n",
+        m.end_time, m.completed, m.processes, m.transitions, 100.0 * m.utilization);
+    fprintf(stderr, "Mean turnaround %.2fms, mean ready time %.2fms, mean response %.2fms\n",
+        m.mean_turnaround, m.mean_ready_time, m.mean_response);
+    fprintf(stderr, "%d scripted processes (%d forked by the servers) ran in %.3fs\n", m.processes,
+        m.processes - servers - clients, now() - start);
+    ks_destroy(sim);
+    return 0;
+}
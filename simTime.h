@@ -0,0 +1,103 @@
+/*****************************************************
+* Simulated time and process IDs of the simulators   *
+******************************************************
+* Timestamps (the clock, arrivals, I/O completions)  *
+* and PIDs are 64 bit, so a simulation can run for   *
+* centuries of simulated ms and keep any ID. The     *
+* durations stay 32 bit: the bursts, the total CPU   *
+* time and the timers counting down to the next      *
+* event of a process are relative, at most INT_MAX   *
+* ms, which keeps the process structures and the     *
+* waiting timers small. The columns of the input are *
+* parsed with range checks instead of atoi, a row    *
+* with a value out of range is reported and skipped. *
+******************************************************/
+
+#ifndef SIM_TIME_H
+#define SIM_TIME_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+typedef long long sim_time_t;
+typedef long long sim_pid_t;
+
+// No next event
+#define SIM_TIME_MAX LLONG_MAX
+// The latest arrival time, 10^15 ms (about 31 700 years): the clock can add durations to it and the
+// timeline export can write it in microseconds without overflowing
+#define SIM_TIME_LIMIT 1000000000000000LL
+#define SIM_DURATION_MAX INT_MAX
+
+/* FUNCTION DESCRIPTION: sim_parse_number
+* Reads an integer column, checking that it is a number in [low, high] and that only spaces or the end of
+* the line follow it, so that 12abc or 1.5 are not read as 12 or 1. Nothing is printed, for the library.
+* The parameters are:
+*    -field, the text of the column
+*    -low, high, the range of the column
+*    -value, set to the number
+* The return value is 0, or -1 if the column is not valid
+*/
+static inline int sim_parse_number(const char *field, long long low, long long high, long long *value){
+    char *end;
+
+    errno = 0;
+    *value = strtoll(field, &end, 10);
+    while(*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') end++;
+    if(end == field || *end != '\0' || errno == ERANGE || *value < low || *value > high) return -1;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: sim_parse_field
+* Reads an integer column like sim_parse_number, for the simulators
+* The parameters are:
+*    -field, the text of the column
+*    -column, the name of the column for the message
+*    -low, high, the range of the column
+*    -value, set to the number
+* The return value is 0, or -1 after printing why the column is not valid
+*/
+static inline int sim_parse_field(const char *field, const char *column, long long low, long long high, long long *value){
+    if(sim_parse_number(field, low, high, value) != 0){
+        fprintf(stderr, "%s \"%.*s\" is not a number from %lld to %lld, the row is skipped\n", column,
+            (int) strcspn(field, "\r\n"), field, low, high);
+        return -1;
+    }
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: sim_parse_columns
+* Reads the Pid, Arrival Time and Total CPU Time columns of a row
+* The return value is 0, or -1 if one of them is out of range
+*/
+static inline int sim_parse_columns(char *const fields[3], sim_pid_t *pid, sim_time_t *arrival_time, int *total_cpu_time){
+    long long total;
+
+    // -1 is no process for the live statistics and the flight recorder
+    if(sim_parse_field(fields[0], "Pid", 0, LLONG_MAX, pid) != 0) return -1;
+    if(sim_parse_field(fields[1], "Arrival Time", 0, SIM_TIME_LIMIT, arrival_time) != 0) return -1;
+    if(sim_parse_field(fields[2], "Total CPU Time", 0, SIM_DURATION_MAX, &total) != 0) return -1;
+    *total_cpu_time = (int) total;
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: sim_check_columns
+* Checks the columns of a row that were not parsed with sim_parse_field: every column of a binary row,
+* and the I/O Frequency and I/O Duration of a CSV row, whose first bursts must not be negative
+* The return value is 0, or -1 after printing why the row is not valid
+*/
+static inline int sim_check_columns(sim_pid_t pid, sim_time_t arrival_time, long long total_cpu_time,
+    long long io_frequency, long long io_duration){
+    if(pid < 0 || arrival_time < 0 || arrival_time > SIM_TIME_LIMIT || total_cpu_time < 0 || total_cpu_time > SIM_DURATION_MAX
+        || io_frequency < 0 || io_frequency > SIM_DURATION_MAX || io_duration < 0 || io_duration > SIM_DURATION_MAX){
+        fprintf(stderr, "Pid %lld, Arrival Time %lld, Total CPU Time %lld, I/O Frequency %lld, I/O Duration %lld: "
+            "a column is out of range, the row is skipped\n", pid, arrival_time, total_cpu_time, io_frequency, io_duration);
+        return -1;
+    }
+    return 0;
+}
+
+#endif
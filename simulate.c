@@ -0,0 +1,330 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Command line front end of libkernelsim. It runs    *
+* the round robin, priority or first come first      *
+* served simulation of a CSV file, prints the        *
+* transitions like roundRobin.c (or as binary        *
+* records, or not at all) and the metrics on         *
+* stderr. It can save a snapshot of the simulation   *
+* at regular intervals and resume from one, or run   *
+* to a time and fork the simulation into branches    *
+* with other policies that finish on their own       *
+* threads.                                           *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "kernelSim.h"
+
+#define MAX_BRANCHES 32
+
+static const char *STATES[] = { "NEW", "READY", "RUNNING", "WAITING", "TERMINATED"};
+static const char *POLICIES[] = { "fcfs", "rr", "priority" };
+static const char *OUTPUTS[] = { "metrics", "text", "binary" };
+
+// One what-if branch, run on its own thread
+struct branch {
+    struct ks_config config;
+    ks_sim_t *sim;
+    pthread_t thread;
+};
+
+/* FUNCTION DESCRIPTION: print_transition
+* The transition callback, prints the transition on stdout
+*/
+void print_transition(void *context, sim_time_t time, sim_pid_t pid, enum KS_STATE old_state, enum KS_STATE new_state){
+    (void) context;
+    printf("%lld,%lld,%s,%s\n", time, pid, STATES[old_state], STATES[new_state]);
+}
+
+/* FUNCTION DESCRIPTION: write_record
+* The transition callback of the binary output, writes the record on stdout
+*/
+void write_record(void *context, sim_time_t time, sim_pid_t pid, enum KS_STATE old_state, enum KS_STATE new_state){
+    struct ks_transition_record record = { time, pid, (uint8_t) old_state, (uint8_t) new_state, { 0 } };
+
+    (void) context;
+    fwrite(&record, sizeof(record), 1, stdout);
+}
+
+/* FUNCTION DESCRIPTION: print_metrics
+* Prints the metrics of the simulation on stderr, so that stdout only has the transitions
+*/
+void print_metrics(ks_sim_t *sim){
+    struct ks_metrics m;
+
+    ks_get_metrics(sim, &m);
+    fprintf(stderr, "Simulation completed in %lldms: %d of %d processes, %lld transitions, %.2f%% utilization\n",
+        m.end_time, m.completed, m.processes, m.transitions, 100.0 * m.utilization);
+    fprintf(stderr, "Mean turnaround %.2fms, mean ready time %.2fms, mean response %.2fms\n",
+        m.mean_turnaround, m.mean_ready_time, m.mean_response);
+    if(m.max_ready_wait_pid >= 0){
+        fprintf(stderr, "Maximum ready queue wait: %lldms (PID %lld)\n", m.max_ready_wait, m.max_ready_wait_pid);
+    }
+    if(m.switches > 0 && m.switch_time + m.cache_time > 0){
+        fprintf(stderr, "Context switches: %lld, %lldms switching, %lldms refilling caches\n",
+            m.switches, m.switch_time, m.cache_time);
+    }
+}
+
+/* FUNCTION DESCRIPTION: parse_policy
+* Parses a policy name
+* The return value is 0 on success, -1 if the name is unknown
+*/
+int parse_policy(const char *name, enum KS_POLICY *policy){
+    for(int i = KS_FCFS; i <= KS_PRIORITY; i++){
+        if(strcmp(name, POLICIES[i]) == 0){
+            *policy = (enum KS_POLICY) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* FUNCTION DESCRIPTION: parse_output
+* Parses an output name
+* The return value is 0 on success, -1 if the name is unknown
+*/
+int parse_output(const char *name, enum KS_OUTPUT *output){
+    for(int i = KS_OUTPUT_METRICS; i <= KS_OUTPUT_BINARY; i++){
+        if(strcmp(name, OUTPUTS[i]) == 0){
+            *output = (enum KS_OUTPUT) i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* FUNCTION DESCRIPTION: parse_branch
+* Parses a branch "<policy>[:<time slice>[:<aging interval>]]", the rest of the configuration is the one of the options
+* An empty field keeps the value of the options, so "priority::9" only changes the aging interval
+* The return value is 0 on success, -1 if the branch is malformed
+*/
+int parse_branch(const char *option, const struct ks_config *base, struct ks_config *config){
+    int *values[2] = { &config->time_slice, &config->aging_interval };
+    const char *field = option, *colon = strchr(option, ':');
+    size_t length = (colon != NULL) ? (size_t) (colon - option) : strlen(option);
+    char name[16], *end;
+    long value;
+
+    *config = *base;
+    if(length >= sizeof(name)) goto malformed;
+    memcpy(name, option, length);
+    name[length] = '\0';
+    if(parse_policy(name, &config->policy) != 0) goto malformed;
+    // The fields are split on every ':', sscanf would stop at an empty one and drop the fields after it
+    for(int i = 0; i < 2 && colon != NULL; i++){
+        field = colon + 1;
+        colon = strchr(field, ':');
+        if(*field == ':' || *field == '\0') continue;
+        errno = 0;
+        value = strtol(field, &end, 10);
+        if(end == field || (*end != ':' && *end != '\0') || errno == ERANGE || value < 0 || value > INT_MAX) goto malformed;
+        *values[i] = (int) value;
+    }
+    // A third ':' starts a field no branch has
+    if(colon == NULL) return 0;
+
+malformed:
+    fprintf(stderr, "Expected <policy>[:<time slice>[:<aging interval>]] for a branch, got %s\n", option);
+    return -1;
+}
+
+// The thread of a branch, it runs its copy of the simulation to completion
+void *run_branch(void *arg){
+    struct branch *b = (struct branch *) arg;
+
+    ks_run(b->sim);
+    return NULL;
+}
+
+/* FUNCTION DESCRIPTION: run_branches
+* Runs the simulation to fork_time, forks it into the branches and runs them in parallel
+* The return value is 0 on success, -1 if a branch cannot be created
+*/
+int run_branches(ks_sim_t *sim, sim_time_t fork_time, struct branch *branches, int num_branches){
+    struct ks_metrics m;
+    int created = 0, result = 0;
+
+    // The shared prefix runs once, up to the first event at or after the fork time
+    while(ks_time(sim) < fork_time && ks_step(sim) > 0);
+
+    for(int i = 0; i < num_branches; i++){
+        branches[i].sim = ks_fork(sim, &branches[i].config);
+        if(branches[i].sim == NULL){
+            fprintf(stderr, "Invalid configuration for branch %d\n", i + 1);
+            result = -1;
+            break;
+        }
+        if(pthread_create(&branches[i].thread, NULL, run_branch, &branches[i]) != 0){
+            // No more threads, run it on this one
+            run_branch(&branches[i]);
+            branches[i].thread = pthread_self();
+        }
+        created++;
+    }
+    for(int i = 0; i < created; i++){
+        if(!pthread_equal(branches[i].thread, pthread_self())) pthread_join(branches[i].thread, NULL);
+    }
+
+    printf("Forked at %lldms\n", ks_time(sim));
+    printf("Branch,Policy,Time slice,Aging interval,End time,Mean turnaround,Mean ready time,Mean response,Max ready wait,Utilization,Context switches\n");
+    for(int i = 0; i < created; i++){
+        ks_get_metrics(branches[i].sim, &m);
+        printf("%d,%s,%d,%d,%lld,%.2f,%.2f,%.2f,%lld,%.2f%%,%lld\n", i + 1, POLICIES[branches[i].config.policy],
+            branches[i].config.time_slice, branches[i].config.aging_interval, m.end_time, m.mean_turnaround,
+            m.mean_ready_time, m.mean_response, m.max_ready_wait, 100.0 * m.utilization, m.switches);
+        ks_destroy(branches[i].sim);
+    }
+    return result;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-p rr|priority|fcfs] [-q time_slice] [-a aging_interval_ms] [-c switch_ms] "
+        "[-w penalty,decay[,migration]] [-o text|binary|metrics] [-s interval_ms -S snapshot] <input_file.csv>\n", name);
+    printf("       %s [-o text|binary|metrics] [-s interval_ms -S snapshot] -r snapshot\n", name);
+    printf("       %s [options] -f fork_time_ms -b policy[:time_slice[:aging_interval_ms]] [-b ...] <input_file.csv>\n", name);
+}
+
+int main(int argc, char *argv[]){
+    struct ks_config config;
+    enum KS_OUTPUT output = KS_OUTPUT_TEXT;
+    ks_transition_fn callbacks[] = { NULL, print_transition, write_record };
+    ks_sim_t *sim;
+    char *snapshot_file = NULL, *resume_file = NULL;
+    int snapshot_interval = 0, opt, error, fields, num_branches = 0, result;
+    sim_time_t next_snapshot, fork_time = -1;
+    char *branch_options[MAX_BRANCHES];
+    struct branch branches[MAX_BRANCHES];
+
+    // -p: the policy, -q: the round robin time slice, -a: the priority aging interval
+    // -c, -w: context switch costs, like the simulators
+    // -s <ms> -S <file>: save the state to <file> every <ms> of simulated time
+    // -r <file>: resume a saved simulation, the output goes on where the saved run stopped
+    // -f <ms> -b <branch>...: run to <ms> once, then finish a copy of the simulation for every branch in parallel
+    // -o <output>: the transitions as text, as binary records (struct ks_transition_record) or only the metrics
+    ks_config_default(&config);
+    while((opt = getopt(argc, argv, "p:q:a:c:w:s:S:r:f:b:o:")) != -1){
+        if(opt == 'o'){
+            if(parse_output(optarg, &output) != 0){
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if(opt == 'p'){
+            if(parse_policy(optarg, &config.policy) != 0){
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if(opt == 'q'){
+            config.time_slice = atoi(optarg);
+        } else if(opt == 'a'){
+            config.aging_interval = atoi(optarg);
+        } else if(opt == 'c'){
+            config.switch_cost = atoi(optarg);
+        } else if(opt == 'w'){
+            fields = sscanf(optarg, "%d,%d,%d", &config.cache_penalty, &config.cache_decay, &config.migration_penalty);
+            if(fields < 2){
+                fprintf(stderr, "Expected <penalty>,<decay>[,<migration>] for the cache, got %s\n", optarg);
+                return -1;
+            }
+        } else if(opt == 's'){
+            snapshot_interval = atoi(optarg);
+        } else if(opt == 'S'){
+            snapshot_file = optarg;
+        } else if(opt == 'r'){
+            resume_file = optarg;
+        } else if(opt == 'f'){
+            if(sim_parse_number(optarg, 0, SIM_TIME_LIMIT, &fork_time) != 0){
+                print_usage(argv[0]);
+                return -1;
+            }
+        } else if(opt == 'b'){
+            if(num_branches == MAX_BRANCHES){
+                fprintf(stderr, "At most %d branches\n", MAX_BRANCHES);
+                return -1;
+            }
+            // The options after -b do not apply to it, branches are parsed once all the options are known
+            branch_options[num_branches++] = optarg;
+        } else {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if((resume_file == NULL && argc - optind != 1) || (resume_file != NULL && argc - optind != 0)
+        || (snapshot_interval > 0 && snapshot_file == NULL) || ((fork_time >= 0) != (num_branches > 0))){
+        print_usage(argv[0]);
+        return -1;
+    }
+    for(int i = 0; i < num_branches; i++){
+        if(parse_branch(branch_options[i], &config, &branches[i].config) != 0) return -1;
+    }
+
+    if(resume_file != NULL){
+        // The configuration comes with the snapshot
+        sim = ks_snapshot_load(resume_file, &error);
+        if(sim == NULL){
+            fprintf(stderr, "Cannot resume from %s (error %d)\n", resume_file, error);
+            return -1;
+        }
+    } else {
+        sim = ks_create();
+        if(sim == NULL || ks_configure(sim, &config) != KS_OK){
+            fprintf(stderr, "Invalid configuration\n");
+            ks_destroy(sim);
+            return -1;
+        }
+        error = ks_load_csv(sim, argv[optind]);
+        if(error != KS_OK){
+            if(error == KS_ERROR_FILE){
+                fprintf(stderr, "Cannot read %s\n", argv[optind]);
+            } else {
+                fprintf(stderr, "%s has a row that cannot be simulated: a value out of range, or burst sequences that need the simulators\n", argv[optind]);
+            }
+            ks_destroy(sim);
+            return -1;
+        }
+        // print the headers, a resumed run continues the output of the saved one
+        if(num_branches == 0 && output == KS_OUTPUT_TEXT) printf("Time of transition,PID,Old State,New State\n");
+    }
+
+    // The branches only report their metrics
+    if(num_branches > 0){
+        result = run_branches(sim, fork_time, branches, num_branches);
+        ks_destroy(sim);
+        return result;
+    }
+
+    // Without snapshots nothing happens between the steps, the loop specialized for the policy and output runs it
+    if(snapshot_interval == 0){
+        ks_run_output(sim, output, stdout);
+        print_metrics(sim);
+        ks_destroy(sim);
+        return 0;
+    }
+    ks_set_transition_callback(sim, callbacks[output], NULL);
+
+    // Snapshots are taken between two steps, once the clock passes every interval
+    next_snapshot = ks_time(sim) + snapshot_interval;
+    while(ks_step(sim) > 0){
+        if(snapshot_interval > 0 && ks_time(sim) >= next_snapshot){
+            // Everything printed so far must reach the output before the snapshot that follows it
+            fflush(stdout);
+            if(ks_snapshot_save(sim, snapshot_file) != KS_OK){
+                fprintf(stderr, "Cannot save the snapshot to %s\n", snapshot_file);
+            }
+            next_snapshot = ks_time(sim) + snapshot_interval;
+        }
+    }
+
+    print_metrics(sim);
+    ks_destroy(sim);
+    return 0;
+}
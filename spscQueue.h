@@ -0,0 +1,104 @@
+/*****************************************************
+* Single producer single consumer queue              *
+******************************************************
+* A lock free ring of pointers between exactly one   *
+* producer thread and one consumer thread. The       *
+* producer only writes the tail and the consumer     *
+* only writes the head, each on its own cache line,  *
+* and the slots are published with release/acquire   *
+* ordering. A full or empty queue makes the caller   *
+* spin a little, then yield the CPU.                 *
+******************************************************/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <sched.h>
+
+#define SPSC_CACHE_LINE 64
+#define SPSC_SPINS 64
+
+struct spsc_queue {
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;
+    _Alignas(SPSC_CACHE_LINE) size_t mask;
+    void **slots;
+};
+
+typedef struct spsc_queue *spsc_t;
+
+/* FUNCTION DESCRIPTION: spsc_create
+* Creates an empty queue
+* The parameters are:
+*    -capacity, the number of slots, rounded up to a power of two
+* The return value is the queue
+*/
+static inline spsc_t spsc_create(size_t capacity){
+    size_t size = 2;
+    spsc_t q;
+
+    while(size < capacity) size *= 2;
+    q = (spsc_t) aligned_alloc(SPSC_CACHE_LINE, sizeof(struct spsc_queue));
+    assert(q != NULL);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->mask = size - 1;
+    q->slots = (void **) calloc(size, sizeof(void *));
+    assert(q->slots != NULL);
+    return q;
+}
+
+/* FUNCTION DESCRIPTION: spsc_try_push
+* Producer side. The return value is false if the queue is full
+*/
+static inline int spsc_try_push(spsc_t q, void *item){
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    if(tail - atomic_load_explicit(&q->head, memory_order_acquire) > q->mask) return 0;
+    q->slots[tail & q->mask] = item;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+/* FUNCTION DESCRIPTION: spsc_try_pop
+* Consumer side. The return value is the oldest item, or NULL if the queue is empty
+*/
+static inline void *spsc_try_pop(spsc_t q){
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    void *item;
+
+    if(head == atomic_load_explicit(&q->tail, memory_order_acquire)) return NULL;
+    item = q->slots[head & q->mask];
+    atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    return item;
+}
+
+// Pushes an item, waiting for a free slot
+static inline void spsc_push(spsc_t q, void *item){
+    for(int spins = 0; !spsc_try_push(q, item); spins++){
+        if(spins >= SPSC_SPINS) sched_yield();
+    }
+}
+
+// Pops an item, waiting for one
+static inline void *spsc_pop(spsc_t q){
+    void *item;
+
+    for(int spins = 0; (item = spsc_try_pop(q)) == NULL; spins++){
+        if(spins >= SPSC_SPINS) sched_yield();
+    }
+    return item;
+}
+
+/* FUNCTION DESCRIPTION: spsc_free
+* Frees the queue, not the items still in it
+*/
+static inline void spsc_free(spsc_t q){
+    free(q->slots);
+    free(q);
+}
+
+#endif
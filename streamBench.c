@@ -0,0 +1,134 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Benchmark of the streaming input. It generates a   *
+* large workload sorted by arrival time, as a CSV    *
+* and as a binary file, and times the simulators     *
+* reading it on their own thread (-s) and through    *
+* the parser thread (-P).                            *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "workloadStream.h"
+
+#define MAX_COMMAND 4096
+
+/* FUNCTION DESCRIPTION: generate_workload
+* Writes a CSV of num_rows processes sorted by arrival time, with enough idle time between the arrivals
+* that the simulation stays linear in the number of processes
+*/
+int generate_workload(const char *file, long long num_rows, unsigned int seed){
+    int arrival = 0;
+
+    FILE *f = fopen(file, "w");
+    if(f == NULL){
+        perror("Cannot write the workload");
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+    srand(seed);
+    fprintf(f, "Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration\n");
+    for(long long i = 0; i < num_rows; i++){
+        arrival += rand() % 40;
+        fprintf(f, "%lld,%d,%d,%d,%d\n", i + 1, arrival, 1 + rand() % 30, 1 + rand() % 12, 1 + rand() % 15);
+    }
+    fclose(f);
+    return 0;
+}
+
+// Wall clock time in seconds
+double now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/* FUNCTION DESCRIPTION: time_run
+* Runs a simulator on the workload, its output is discarded
+* The return value is the best wall clock time of the repetitions, or -1 if the simulator fails
+*/
+double time_run(const char *simulator, const char *mode, const char *file, int repetitions){
+    char command[MAX_COMMAND];
+    double best = -1, start, elapsed;
+
+    snprintf(command, sizeof(command), "%s %s %s > /dev/null 2>&1", simulator, mode, file);
+    for(int i = 0; i < repetitions; i++){
+        start = now();
+        if(system(command) != 0) return -1;
+        elapsed = now() - start;
+        if(best < 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-n rows] [-r repetitions] <simulator>...\n", name);
+    printf("For example: %s -n 2000000 ./roundRobin ./priority ./FCFS\n", name);
+}
+
+int main(int argc, char *argv[]){
+    long long num_rows = 1000000;
+    int repetitions = 3, opt;
+    char csv_file[64], binary_file[64], output_file[96];
+    const char *inputs[2], *names[2] = { "csv", "binary" };
+    double sequential, pipelined;
+
+    // -n: the number of processes, -r: runs of every configuration, the best one is kept
+    while((opt = getopt(argc, argv, "n:r:")) != -1){
+        if(opt == 'n'){
+            num_rows = atoll(optarg);
+        } else if(opt == 'r'){
+            repetitions = atoi(optarg);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if(optind >= argc || num_rows <= 0 || repetitions <= 0){
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // The files are in the current directory, FCFS.c names its output after the input file
+    snprintf(csv_file, sizeof(csv_file), "bench_%d.csv", (int) getpid());
+    snprintf(binary_file, sizeof(binary_file), "bench_%d.bin", (int) getpid());
+    if(generate_workload(csv_file, num_rows, 1) != 0) return 1;
+    if(stream_write_binary(csv_file, binary_file) != num_rows){
+        fprintf(stderr, "Cannot write the binary workload\n");
+        unlink(csv_file);
+        return 1;
+    }
+    inputs[0] = csv_file;
+    inputs[1] = binary_file;
+    // The parser thread and the simulation share the only CPU, -P cannot be faster
+    if(sysconf(_SC_NPROCESSORS_ONLN) < 2) fprintf(stderr, "Only one CPU is online, -P runs its parser on the same CPU as the simulation\n");
+
+    printf("Simulator,Input,Processes,Sequential (s),Pipelined (s),Speedup\n");
+    for(int i = optind; i < argc; i++){
+        for(int j = 0; j < 2; j++){
+            sequential = time_run(argv[i], "-s", inputs[j], repetitions);
+            pipelined = time_run(argv[i], "-P", inputs[j], repetitions);
+            if(sequential < 0 || pipelined < 0){
+                printf("%s,%s,%lld,failed\n", argv[i], names[j], num_rows);
+                continue;
+            }
+            printf("%s,%s,%lld,%.3f,%.3f,%.2fx\n", argv[i], names[j], num_rows, sequential, pipelined,
+                (pipelined > 0) ? sequential / pipelined : 0.0);
+            fflush(stdout);
+        }
+    }
+
+    for(int j = 0; j < 2; j++){
+        snprintf(output_file, sizeof(output_file), "output_%s.txt", inputs[j]);
+        unlink(output_file);
+        unlink(inputs[j]);
+    }
+    return 0;
+}
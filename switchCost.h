@@ -0,0 +1,141 @@
+/*****************************************************
+* Context switch cost shared by the simulators       *
+******************************************************
+* Dispatching a process other than the one that ran  *
+* last costs a fixed switch time. On top of it the   *
+* process pays to refill its cache: nothing if it    *
+* ran a moment ago on the same CPU, up to the full   *
+* penalty once it has been off the CPU for the decay *
+* time, and the full penalty plus a migration cost   *
+* if it last ran on another CPU.                     *
+* The simulators have a single CPU, they dispatch    *
+* everything on CPU 0.                               *
+******************************************************/
+
+#ifndef SWITCH_COST_H
+#define SWITCH_COST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "simTime.h"
+
+// Cache state of one process, embedded in the process structure
+// last_ran is -1 until the process first leaves the CPU
+struct cache_state {
+    sim_time_t last_ran;
+    int last_cpu;
+};
+
+struct switch_model {
+    int switch_cost;
+    int cache_penalty;
+    int cache_decay;
+    int migration_penalty;
+    sim_pid_t last_pid;
+    // statistics
+    long long dispatches;
+    long long switches;
+    long long switch_time;
+    long long cache_time;
+};
+
+/* FUNCTION DESCRIPTION: switch_model_init
+* Initializes a model where dispatching is free, the simulators then behave as without the model
+*/
+static inline void switch_model_init(struct switch_model *m){
+    m->switch_cost = 0;
+    m->cache_penalty = 0;
+    m->cache_decay = 0;
+    m->migration_penalty = 0;
+    m->last_pid = -1;
+    m->dispatches = 0;
+    m->switches = 0;
+    m->switch_time = 0;
+    m->cache_time = 0;
+}
+
+/* FUNCTION DESCRIPTION: switch_model_parse_cache
+* Parses the cache option "<penalty>,<decay>[,<migration>]", all in ms
+* The return value is 0 on success, -1 if the option is malformed
+*/
+static inline int switch_model_parse_cache(struct switch_model *m, const char *option){
+    int fields = sscanf(option, "%d,%d,%d", &m->cache_penalty, &m->cache_decay, &m->migration_penalty);
+
+    if(fields < 2 || m->cache_penalty < 0 || m->cache_decay < 0){
+        fprintf(stderr, "Expected <penalty>,<decay>[,<migration>] for the cache, got %s\n", option);
+        return -1;
+    }
+    if(fields == 2) m->migration_penalty = 0;
+    return 0;
+}
+
+static inline void cache_state_init(struct cache_state *c){
+    c->last_ran = -1;
+    c->last_cpu = -1;
+}
+
+/* FUNCTION DESCRIPTION: switch_dispatch
+* Computes the overhead of dispatching a process
+* The parameters are:
+*    -m, the switch model
+*    -c, the cache state of the process
+*    -pid, the process being dispatched
+*    -cpu, the CPU it is dispatched on
+*    -now, the current time
+* The return value is the overhead in ms, during which the process runs without making progress
+*/
+static inline int switch_dispatch(struct switch_model *m, struct cache_state *c, sim_pid_t pid, int cpu, sim_time_t now){
+    int overhead = 0, refill;
+    long long idle;
+
+    m->dispatches++;
+    // Running the same process again does not switch anything, its cache is still warm
+    if(pid == m->last_pid && c->last_cpu == cpu && c->last_ran == now) return 0;
+    m->last_pid = pid;
+
+    m->switches++;
+    overhead += m->switch_cost;
+    m->switch_time += m->switch_cost;
+
+    if(c->last_ran < 0 || c->last_cpu != cpu){
+        // Never ran, or ran elsewhere: nothing useful in this cache
+        refill = m->cache_penalty + ((c->last_ran < 0) ? 0 : m->migration_penalty);
+    } else if(m->cache_decay <= 0){
+        refill = (now > c->last_ran) ? m->cache_penalty : 0;
+    } else {
+        // The cache cools down linearly while the process is off the CPU
+        idle = now - c->last_ran;
+        if(idle > m->cache_decay) idle = m->cache_decay;
+        refill = (int) ((m->cache_penalty * idle + m->cache_decay - 1) / m->cache_decay);
+    }
+    overhead += refill;
+    m->cache_time += refill;
+    return overhead;
+}
+
+/* FUNCTION DESCRIPTION: switch_leave
+* Records that a process left the CPU, its cache starts cooling down
+*/
+static inline void switch_leave(struct cache_state *c, int cpu, sim_time_t now){
+    c->last_ran = now;
+    c->last_cpu = cpu;
+}
+
+/* FUNCTION DESCRIPTION: switch_print_report
+* Prints the time lost to context switches
+* The parameters are:
+*    -m, the switch model
+*    -policy, the name of the scheduling policy
+*    -end_time, the time the simulation completed
+*    -out, where to print the report
+*/
+static inline void switch_print_report(struct switch_model *m, const char *policy, sim_time_t end_time, FILE *out){
+    long long lost = m->switch_time + m->cache_time;
+
+    if(m->switch_cost == 0 && m->cache_penalty == 0 && m->migration_penalty == 0) return;
+    fprintf(out, "%s context switches: %lld of %lld dispatches, %lldms switching, %lldms refilling caches, "
+        "%lldms lost (%.2f%% of %lldms)\n", policy, m->switches, m->dispatches, m->switch_time, m->cache_time,
+        lost, (end_time > 0) ? 100.0 * lost / end_time : 0.0, end_time);
+}
+
+#endif
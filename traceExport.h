@@ -0,0 +1,160 @@
+/*****************************************************
+* Chrome trace event export shared by the simulators *
+******************************************************
+* Turns the state transitions into a JSON trace that *
+* chrome://tracing and Perfetto can open. Running    *
+* slices go on one track per simulated CPU, I/O      *
+* slices on one track per device and the time spent  *
+* ready on a ready queue track. Events are written   *
+* as the simulation runs, nothing is kept in memory. *
+* Trace timestamps are simulated ms times 1000, in   *
+* microseconds.                                      *
+******************************************************/
+
+#ifndef TRACE_EXPORT_H
+#define TRACE_EXPORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include "ioDevice.h"
+
+// Same order as the STATE enumerators of the simulators
+enum TRACE_STATE {
+    TRACE_NEW,
+    TRACE_READY,
+    TRACE_RUNNING,
+    TRACE_WAITING,
+    TRACE_TERMINATED
+};
+static const char *TRACE_STATES[] = { "new", "ready", "running", "waiting", "terminated" };
+
+// Trace processes (track groups)
+#define TRACE_CPU_TRACKS 1
+#define TRACE_READY_TRACK 2
+#define TRACE_IO_TRACKS 3
+
+#define TRACE_BUFFER_SIZE (1 << 20)
+
+struct trace_writer {
+    FILE *f;
+    io_system_t devices;
+    long long events;
+};
+
+typedef struct trace_writer *trace_t;
+
+// Writes the metadata event that names a track group or a track
+static inline void trace_name(trace_t t, const char *what, int pid, int tid, const char *name){
+    fprintf(t->f, "{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+        what, pid, tid, name);
+}
+
+/* FUNCTION DESCRIPTION: trace_open
+* Creates the trace file and names its tracks
+* The parameters are:
+*    -path, the name of the trace file
+*    -num_cpus, the number of simulated CPUs
+*    -devices, the I/O devices, NULL when I/O is not limited by devices
+* The return value is the trace writer, or NULL if the file cannot be created
+*/
+static inline trace_t trace_open(const char *path, int num_cpus, io_system_t devices){
+    char name[64];
+    trace_t t;
+
+    FILE *f = fopen(path, "w");
+    if(f == NULL){
+        perror("Cannot create the trace file");
+        return NULL;
+    }
+    t = (trace_t) malloc(sizeof(struct trace_writer));
+    assert(t != NULL);
+    t->f = f;
+    t->devices = devices;
+    t->events = 0;
+    setvbuf(f, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    // The array format stays readable even if the simulation stops before trace_close
+    fprintf(f, "[\n");
+    trace_name(t, "process_name", TRACE_CPU_TRACKS, 0, "CPUs");
+    for(int cpu = 0; cpu < num_cpus; cpu++){
+        snprintf(name, sizeof(name), "CPU %d", cpu);
+        trace_name(t, "thread_name", TRACE_CPU_TRACKS, cpu, name);
+    }
+    trace_name(t, "process_name", TRACE_READY_TRACK, 0, "Ready queue");
+    if(devices == NULL){
+        trace_name(t, "process_name", TRACE_IO_TRACKS, 0, "I/O");
+    } else {
+        for(int i = 0; i < devices->count; i++){
+            snprintf(name, sizeof(name), "I/O %s", devices->devices[i].name);
+            trace_name(t, "process_name", TRACE_IO_TRACKS + i, 0, name);
+        }
+    }
+    return t;
+}
+
+// A slice on a CPU, they never overlap so they are duration events
+static inline void trace_cpu(trace_t t, char phase, sim_time_t time, int cpu, sim_pid_t pid){
+    fprintf(t->f, "{\"name\":\"PID %lld\",\"cat\":\"cpu\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%d},\n",
+        pid, phase, time * 1000, TRACE_CPU_TRACKS, cpu);
+}
+
+// A slice of a process waiting, many overlap so they are async events keyed on the PID
+static inline void trace_async(trace_t t, char phase, sim_time_t time, int track, const char *cat, sim_pid_t pid){
+    fprintf(t->f, "{\"name\":\"PID %lld\",\"cat\":\"%s\",\"ph\":\"%c\",\"id\":%lld,\"ts\":%lld,\"pid\":%d,\"tid\":0},\n",
+        pid, cat, phase, pid, time * 1000, track);
+}
+
+// The track of the device a process blocks on
+static inline int trace_io_track(trace_t t, sim_pid_t pid){
+    if(t->devices == NULL) return TRACE_IO_TRACKS;
+    return TRACE_IO_TRACKS + (int) (((pid % t->devices->count) + t->devices->count) % t->devices->count);
+}
+
+/* FUNCTION DESCRIPTION: trace_transition
+* Writes the events of one state transition: the slice of the old state ends and the one of the new state begins
+* The parameters are:
+*    -t, the trace writer, nothing is written if it is NULL
+*    -time, the time of the transition
+*    -pid, the process
+*    -cpu, the CPU the process runs on
+*    -old_state, new_state, the states of the transition
+*/
+static inline void trace_transition(trace_t t, sim_time_t time, sim_pid_t pid, int cpu, enum TRACE_STATE old_state, enum TRACE_STATE new_state){
+    if(t == NULL) return;
+    t->events++;
+
+    if(old_state == TRACE_RUNNING) trace_cpu(t, 'E', time, cpu, pid);
+    if(old_state == TRACE_READY) trace_async(t, 'e', time, TRACE_READY_TRACK, "ready", pid);
+    if(old_state == TRACE_WAITING) trace_async(t, 'e', time, trace_io_track(t, pid), "io", pid);
+
+    if(new_state == TRACE_RUNNING) trace_cpu(t, 'B', time, cpu, pid);
+    if(new_state == TRACE_READY) trace_async(t, 'b', time, TRACE_READY_TRACK, "ready", pid);
+    if(new_state == TRACE_WAITING) trace_async(t, 'b', time, trace_io_track(t, pid), "io", pid);
+}
+
+/* FUNCTION DESCRIPTION: trace_state_from_name
+* Maps a state name, in any case, to its trace state
+* The return value is the state, or -1 if the name is unknown
+*/
+static inline int trace_state_from_name(const char *name){
+    for(int i = TRACE_NEW; i <= TRACE_TERMINATED; i++){
+        if(strcasecmp(name, TRACE_STATES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/* FUNCTION DESCRIPTION: trace_close
+* Ends the JSON array and closes the trace file
+*/
+static inline void trace_close(trace_t t){
+    if(t == NULL) return;
+    // The last event ends with a comma, an empty metadata event keeps the JSON valid
+    fprintf(t->f, "{\"name\":\"trace_end\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"events\":%lld}}\n]\n", t->events);
+    fclose(t->f);
+    free(t);
+}
+
+#endif
@@ -0,0 +1,681 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Converts a scheduler trace into a workload. It     *
+* reads the sched_switch, sched_wakeup and           *
+* sched_process_exit events of an ftrace text dump   *
+* (trace or trace_pipe) or of perf sched script, in  *
+* one pass. Every task becomes a process whose CPU   *
+* bursts are the time it ran between two sleeps and  *
+* whose I/O durations are the time it slept until it *
+* was woken up; being preempted does not end a       *
+* burst. The rows are written sorted by arrival time *
+* with the bursts as ; sequences.                    *
+*                                                    *
+* The memory does not grow with the trace: a task is *
+* only kept while it is alive, and it is cut into a  *
+* new process once it has used the maximum number of *
+* bursts or once its process started longer than the *
+* window ago, so a finished row never waits more     *
+* than the window for the rows arriving before it.   *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include "minHeap.h"
+
+#define READ_BUFFER_SIZE (1 << 20)
+#define COMM_SIZE 16
+#define DEFAULT_UNIT_US 1000
+#define DEFAULT_MAX_BURSTS 64
+#define DEFAULT_WINDOW_S 1.0
+
+enum TASK_STATE {
+    TASK_RUNNABLE,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_FREE
+};
+
+// A task of the trace, the process of its current segment is built in the burst arrays
+struct task {
+    long pid;
+    char comm[COMM_SIZE];
+    enum TASK_STATE state;
+    long long segment_start;
+    long long run_start;
+    long long block_start;
+    long long cpu_time;
+    int cpu_count;
+    int io_count;
+    int *cpu_bursts;
+    int *io_bursts;
+    struct task *next;
+};
+
+// A finished process waiting for the processes that arrived before it
+struct row {
+    long long arrival;
+    long pid;
+    char comm[COMM_SIZE];
+    char *columns;
+};
+
+// The live tasks by PID, chained, with the freed tasks kept for reuse
+struct task_table {
+    struct task **buckets;
+    int size;
+    int count;
+    int peak;
+    struct task *free_tasks;
+};
+
+struct importer {
+    struct task_table tasks;
+    heap_t segments;
+    heap_t rows;
+    long long unit;
+    long long window;
+    int max_bursts;
+    long long first_time;
+    long long last_time;
+    long long lines;
+    long long events;
+    long long malformed;
+    long long cuts;
+    int written;
+    FILE *out;
+    FILE *map;
+};
+
+unsigned int hash_pid(long pid, int size){
+    return (unsigned int) ((unsigned long) pid * 2654435761UL) & (size - 1);
+}
+
+struct task *task_find(struct task_table *t, long pid){
+    struct task *task = t->buckets[hash_pid(pid, t->size)];
+
+    while(task != NULL && task->pid != pid) task = task->next;
+    return task;
+}
+
+// Doubles the buckets once there are more tasks than buckets
+void table_grow(struct task_table *t){
+    struct task **old = t->buckets;
+    int old_size = t->size;
+
+    t->size *= 2;
+    t->buckets = (struct task **) calloc(t->size, sizeof(struct task *));
+    assert(t->buckets != NULL);
+    for(int i = 0; i < old_size; i++){
+        while(old[i] != NULL){
+            struct task *task = old[i];
+            unsigned int h = hash_pid(task->pid, t->size);
+            old[i] = task->next;
+            task->next = t->buckets[h];
+            t->buckets[h] = task;
+        }
+    }
+    free(old);
+}
+
+/* FUNCTION DESCRIPTION: task_create
+* Adds a task that arrives at time now, ready to run
+* The freed tasks are reused and never given back, the segment heap may still point to them
+*/
+struct task *task_create(struct importer *im, long pid, const char *comm, long long now){
+    struct task_table *t = &im->tasks;
+    struct task *task = t->free_tasks;
+    unsigned int h;
+
+    if(task != NULL){
+        t->free_tasks = task->next;
+    } else {
+        task = (struct task *) calloc(1, sizeof(struct task));
+        assert(task != NULL);
+        task->cpu_bursts = (int *) malloc(im->max_bursts * sizeof(int));
+        task->io_bursts = (int *) malloc(im->max_bursts * sizeof(int));
+        assert(task->cpu_bursts != NULL && task->io_bursts != NULL);
+    }
+    task->pid = pid;
+    snprintf(task->comm, COMM_SIZE, "%s", comm);
+    task->state = TASK_RUNNABLE;
+    task->segment_start = now;
+    task->cpu_time = 0;
+    task->cpu_count = task->io_count = 0;
+
+    if(t->count >= t->size) table_grow(t);
+    h = hash_pid(pid, t->size);
+    task->next = t->buckets[h];
+    t->buckets[h] = task;
+    t->count++;
+    if(t->count > t->peak) t->peak = t->count;
+    heap_push(im->segments, now, task);
+    return task;
+}
+
+// Removes a task from the table, its memory goes to the free list
+void task_release(struct importer *im, struct task *task){
+    struct task_table *t = &im->tasks;
+    struct task **link = &t->buckets[hash_pid(task->pid, t->size)];
+
+    while(*link != task) link = &(*link)->next;
+    *link = task->next;
+    t->count--;
+    task->state = TASK_FREE;
+    task->next = t->free_tasks;
+    t->free_tasks = task;
+}
+
+// A duration of the trace in simulated ms, rounded and at least 1ms
+int to_units(struct importer *im, long long ns){
+    long long units = (ns + im->unit / 2) / im->unit;
+
+    if(units < 1) return 1;
+    return (units > INT_MAX) ? INT_MAX : (int) units;
+}
+
+/* FUNCTION DESCRIPTION: emit_segment
+* Turns the bursts of the current segment of a task into a row, a segment without CPU time is dropped
+* The I/O after the last CPU burst is not written, the process terminates at the end of that burst
+*/
+void emit_segment(struct importer *im, struct task *task){
+    struct row *row;
+    long long total = 0;
+    int io_count = (task->io_count < task->cpu_count) ? task->io_count : task->cpu_count - 1;
+    size_t size, used;
+
+    if(task->cpu_count == 0) return;
+    for(int i = 0; i < task->cpu_count; i++) total += task->cpu_bursts[i];
+
+    row = (struct row *) malloc(sizeof(struct row));
+    assert(row != NULL);
+    size = 32 + 12 * (size_t) (task->cpu_count + io_count);
+    row->columns = (char *) malloc(size);
+    assert(row->columns != NULL);
+    row->arrival = task->segment_start;
+    row->pid = task->pid;
+    memcpy(row->comm, task->comm, COMM_SIZE);
+
+    // A process that never blocks gets its whole time as a single burst and an unused I/O duration
+    used = snprintf(row->columns, size, "%lld,", (total > INT_MAX) ? (long long) INT_MAX : total);
+    for(int i = 0; i < task->cpu_count; i++){
+        used += snprintf(row->columns + used, size - used, "%s%d", (i > 0) ? ";" : "", task->cpu_bursts[i]);
+    }
+    if(io_count == 0){
+        snprintf(row->columns + used, size - used, ",1");
+    } else {
+        for(int i = 0; i < io_count; i++){
+            used += snprintf(row->columns + used, size - used, "%c%d", (i > 0) ? ';' : ',', task->io_bursts[i]);
+        }
+    }
+    heap_push(im->rows, row->arrival, row);
+    task->cpu_count = task->io_count = 0;
+}
+
+// Ends the CPU burst of a task, the time it ran since it last slept
+void end_cpu_burst(struct importer *im, struct task *task){
+    if(task->cpu_time > 0 && task->cpu_count < im->max_bursts){
+        task->cpu_bursts[task->cpu_count++] = to_units(im, task->cpu_time);
+    }
+    task->cpu_time = 0;
+}
+
+// Adds the time a task ran since it was switched in
+void stop_running(struct task *task, long long now){
+    if(task->state == TASK_RUNNING){
+        task->cpu_time += now - task->run_start;
+        task->state = TASK_RUNNABLE;
+    }
+}
+
+/* FUNCTION DESCRIPTION: task_wake
+* Ends the sleep of a task, which becomes the I/O duration after its last CPU burst
+* A task that slept twice without running in between gets one longer I/O
+*/
+void task_wake(struct importer *im, struct task *task, long long now){
+    int duration;
+
+    if(task->state != TASK_BLOCKED) return;
+    task->state = TASK_RUNNABLE;
+    if(task->cpu_count == 0) return;
+    duration = to_units(im, now - task->block_start);
+    if(task->io_count < task->cpu_count){
+        task->io_bursts[task->io_count++] = duration;
+    } else if(task->io_bursts[task->io_count - 1] <= INT_MAX - duration){
+        task->io_bursts[task->io_count - 1] += duration;
+    }
+}
+
+/* FUNCTION DESCRIPTION: task_block
+* A task went to sleep at time now, which ends its CPU burst
+* A task that did not run yet has not arrived, and a task that used all its bursts is written out
+*/
+void task_block(struct importer *im, struct task *task, long long now){
+    stop_running(task, now);
+    end_cpu_burst(im, task);
+    task->state = TASK_BLOCKED;
+    task->block_start = now;
+    if(task->cpu_count == 0){
+        task_release(im, task);
+    } else if(task->cpu_count == im->max_bursts){
+        // The rest of the task arrives as a new process when it wakes up
+        emit_segment(im, task);
+        task_release(im, task);
+        im->cuts++;
+    }
+}
+
+// A task terminated, or the trace ended, at time now
+void task_exit(struct importer *im, struct task *task, long long now){
+    stop_running(task, now);
+    end_cpu_burst(im, task);
+    emit_segment(im, task);
+    task_release(im, task);
+}
+
+/* FUNCTION DESCRIPTION: task_cut
+* Writes out the process of a task whose segment started longer than the window ago
+* A sleeping task is dropped until it wakes up, the others go on as a new process arriving now
+*/
+void task_cut(struct importer *im, struct task *task, long long now){
+    int running = (task->state == TASK_RUNNING);
+
+    im->cuts++;
+    if(task->state == TASK_BLOCKED){
+        emit_segment(im, task);
+        task_release(im, task);
+        return;
+    }
+    stop_running(task, now);
+    end_cpu_burst(im, task);
+    emit_segment(im, task);
+    task->segment_start = now;
+    if(running){
+        task->state = TASK_RUNNING;
+        task->run_start = now;
+    }
+    heap_push(im->segments, now, task);
+}
+
+/* FUNCTION DESCRIPTION: oldest_segment
+* Drops the stale entries at the top of the segment heap: freed tasks and segments that were cut
+* The return value is the task whose segment started first, or NULL if no task is alive
+*/
+struct task *oldest_segment(struct importer *im){
+    struct task *task;
+
+    while((task = (struct task *) heap_peek(im->segments)) != NULL){
+        if(task->state != TASK_FREE && task->segment_start == heap_peek_key(im->segments)) return task;
+        heap_pop(im->segments);
+    }
+    return NULL;
+}
+
+/* FUNCTION DESCRIPTION: write_rows
+* Writes the finished rows that no live task can arrive before, then all of them when flush is set
+*/
+void write_rows(struct importer *im, int flush){
+    struct task *oldest = oldest_segment(im);
+    struct row *row;
+
+    while(!heap_empty(im->rows)){
+        if(!flush && oldest != NULL && heap_peek_key(im->rows) > oldest->segment_start) break;
+        row = (struct row *) heap_pop(im->rows);
+        im->written++;
+        fprintf(im->out, "%d,%lld,%s\n", im->written, (row->arrival - im->first_time + im->unit / 2) / im->unit,
+            row->columns);
+        if(im->map != NULL) fprintf(im->map, "%d,%ld,%s\n", im->written, row->pid, row->comm);
+        free(row->columns);
+        free(row);
+    }
+}
+
+/* FUNCTION DESCRIPTION: advance
+* Moves the trace clock to an event, cutting the segments that are older than the window
+* The events of a trace are sorted, the few that are not are moved to the last time
+* The return value is the time of the event
+*/
+long long advance(struct importer *im, long long now){
+    struct task *task;
+
+    if(im->events++ == 0) im->first_time = im->last_time = now;
+    if(now < im->last_time) now = im->last_time;
+    im->last_time = now;
+    while((task = oldest_segment(im)) != NULL && task->segment_start < now - im->window){
+        heap_pop(im->segments);
+        task_cut(im, task, now);
+    }
+    return now;
+}
+
+/* FUNCTION DESCRIPTION: parse_time
+* Reads the timestamp in front of the event name, "1234.567890: sched_switch:" or "... sched:sched_switch:"
+* The return value is the time in ns, or -1 if there is none
+*/
+long long parse_time(const char *line, const char *event){
+    const char *p = event, *end;
+    long long seconds = 0, fraction = 0;
+    int digits = 0;
+
+    if(p - line >= 6 && strncmp(p - 6, "sched:", 6) == 0) p -= 6;
+    while(p > line && p[-1] == ' ') p--;
+    if(p == line || p[-1] != ':') return -1;
+    end = --p;
+    while(p > line && (isdigit((unsigned char) p[-1]) || p[-1] == '.')) p--;
+    if(p == end) return -1;
+    for(; p < end && *p != '.'; p++) seconds = seconds * 10 + (*p - '0');
+    if(p < end) p++;
+    for(; p < end && isdigit((unsigned char) *p); p++){
+        if(digits < 9){
+            fraction = fraction * 10 + (*p - '0');
+            digits++;
+        }
+    }
+    for(; digits < 9; digits++) fraction *= 10;
+    return seconds * 1000000000LL + fraction;
+}
+
+// Copies the text from start to end, cut to the size of a command name
+void copy_comm(char *comm, const char *start, const char *end){
+    size_t length = end - start;
+
+    if(length >= COMM_SIZE) length = COMM_SIZE - 1;
+    memcpy(comm, start, length);
+    comm[length] = '\0';
+}
+
+/* FUNCTION DESCRIPTION: parse_key
+* Reads "<key>=<value>" in the fields of an event, the value ends at the next key when it is a command name
+* The parameters are:
+*    -fields, the text after the event name
+*    -key, the key with its =, like "prev_pid="
+*    -next_key, the key after a command name, or NULL for a value without spaces
+*    -value, set to the value, at most COMM_SIZE characters
+* The return value is 0, or -1 if the key is not there
+*/
+int parse_key(const char *fields, const char *key, const char *next_key, char *value){
+    const char *start = fields, *end;
+
+    // A key is the first field or follows a space, pid= must not match prev_pid=
+    while((start = strstr(start, key)) != NULL && start != fields && start[-1] != ' ') start++;
+    if(start == NULL) return -1;
+    start += strlen(key);
+    end = (next_key != NULL) ? strstr(start, next_key) : NULL;
+    if(end == NULL) end = start + strcspn(start, " \n");
+    else while(end > start && end[-1] == ' ') end--;
+    copy_comm(value, start, end);
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: parse_compact_task
+* Reads a task written "comm:pid [prio]" by perf, comm may hold colons and spaces
+* The parameters are:
+*    -start, the first character of the command name
+*    -bracket, the [ of the priority
+* The return value is the PID, or -1 if the text is not a task
+*/
+long parse_compact_task(const char *start, const char *bracket, char *comm){
+    const char *p = bracket;
+
+    while(p > start && p[-1] == ' ') p--;
+    bracket = p;
+    while(p > start && isdigit((unsigned char) p[-1])) p--;
+    if(p == bracket || p == start || p[-1] != ':') return -1;
+    copy_comm(comm, start, p - 1);
+    return strtol(p, NULL, 10);
+}
+
+// True for the prev_state of a task that was preempted, R or R+
+int is_preempted(const char *state){
+    return state[0] == 'R';
+}
+
+// True for the prev_state of a task that is dead
+int is_dead(const char *state){
+    return state[0] == 'X' || state[0] == 'Z' || state[0] == 'x';
+}
+
+/* FUNCTION DESCRIPTION: on_switch
+* The CPU went from the previous task to the next one, pid 0 is the idle task
+* The fields are "prev_comm=... prev_pid=... prev_state=... ==> next_comm=... next_pid=..." in ftrace and
+* perf with the raw format, "comm:pid [prio] state ==> comm:pid [prio]" in the default format of perf
+* The return value is 0, or -1 if the fields cannot be read
+*/
+int on_switch(struct importer *im, long long now, const char *fields){
+    char prev_comm[COMM_SIZE], next_comm[COMM_SIZE], state[COMM_SIZE], number[COMM_SIZE];
+    long prev_pid, next_pid;
+    struct task *task;
+
+    if(strstr(fields, "prev_pid=") != NULL){
+        if(parse_key(fields, "prev_comm=", " prev_pid=", prev_comm) != 0
+            || parse_key(fields, "prev_pid=", NULL, number) != 0) return -1;
+        prev_pid = strtol(number, NULL, 10);
+        if(parse_key(fields, "prev_state=", NULL, state) != 0
+            || parse_key(fields, "next_comm=", " next_pid=", next_comm) != 0
+            || parse_key(fields, "next_pid=", NULL, number) != 0) return -1;
+        next_pid = strtol(number, NULL, 10);
+    } else {
+        const char *arrow = strstr(fields, "==>"), *bracket = NULL, *p;
+
+        if(arrow == NULL) return -1;
+        for(p = fields; p < arrow; p++) if(*p == '[') bracket = p;
+        if(bracket == NULL || (prev_pid = parse_compact_task(fields, bracket, prev_comm)) < 0) return -1;
+        p = strchr(bracket, ']');
+        if(p == NULL || p > arrow) return -1;
+        p += 1 + strspn(p + 1, " ");
+        copy_comm(state, p, p + strcspn(p, " "));
+        p = arrow + 3 + strspn(arrow + 3, " ");
+        bracket = strrchr(p, '[');
+        if(bracket == NULL || (next_pid = parse_compact_task(p, bracket, next_comm)) < 0) return -1;
+    }
+
+    now = advance(im, now);
+    if(prev_pid != 0){
+        task = task_find(&im->tasks, prev_pid);
+        if(is_dead(state)){
+            if(task != NULL) task_exit(im, task, now);
+        } else if(is_preempted(state)){
+            // A task running since before the trace arrives when it is first switched out
+            if(task == NULL) task = task_create(im, prev_pid, prev_comm, now);
+            stop_running(task, now);
+        } else if(task != NULL){
+            task_block(im, task, now);
+        }
+    }
+    if(next_pid != 0){
+        task = task_find(&im->tasks, next_pid);
+        if(task == NULL) task = task_create(im, next_pid, next_comm, now);
+        task_wake(im, task, now);
+        task->state = TASK_RUNNING;
+        task->run_start = now;
+    }
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: on_wakeup
+* A task was woken up, or created for sched_wakeup_new
+* The fields are "comm=... pid=... prio=..." in ftrace, "comm:pid [prio] ..." in perf
+* The return value is 0, or -1 if the fields cannot be read
+*/
+int on_wakeup(struct importer *im, long long now, const char *fields){
+    char comm[COMM_SIZE], number[COMM_SIZE];
+    struct task *task;
+    long pid;
+
+    if(parse_key(fields, "pid=", NULL, number) == 0){
+        if(parse_key(fields, "comm=", " pid=", comm) != 0) return -1;
+        pid = strtol(number, NULL, 10);
+    } else {
+        const char *bracket = strchr(fields, '[');
+        if(bracket == NULL || (pid = parse_compact_task(fields, bracket, comm)) < 0) return -1;
+    }
+
+    now = advance(im, now);
+    if(pid == 0) return 0;
+    task = task_find(&im->tasks, pid);
+    if(task == NULL) task_create(im, pid, comm, now);
+    else task_wake(im, task, now);
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: on_task_exit
+* A task terminated, its last CPU burst ended when it was switched out
+*/
+int on_task_exit(struct importer *im, long long now, const char *fields){
+    char comm[COMM_SIZE], number[COMM_SIZE];
+    struct task *task;
+    long pid;
+
+    if(parse_key(fields, "pid=", NULL, number) == 0){
+        pid = strtol(number, NULL, 10);
+    } else {
+        const char *bracket = strchr(fields, '[');
+        if(bracket == NULL || (pid = parse_compact_task(fields, bracket, comm)) < 0) return -1;
+    }
+
+    now = advance(im, now);
+    task = task_find(&im->tasks, pid);
+    if(task != NULL) task_exit(im, task, now);
+    return 0;
+}
+
+/* FUNCTION DESCRIPTION: import_line
+* Applies the scheduler event of one line of the trace, the other lines are skipped
+* The return value is 0, or -1 if the line has an event that cannot be read
+*/
+int import_line(struct importer *im, const char *line){
+    static const char *names[] = { "sched_switch:", "sched_wakeup:", "sched_wakeup_new:", "sched_process_exit:" };
+    const char *event = NULL, *fields;
+    long long now;
+    int kind;
+
+    for(kind = 0; kind < 4; kind++){
+        event = strstr(line, names[kind]);
+        if(event != NULL) break;
+    }
+    if(event == NULL) return 0;
+    now = parse_time(line, event);
+    if(now < 0) return -1;
+    fields = event + strlen(names[kind]);
+    fields += strspn(fields, " ");
+    if(kind == 0) return on_switch(im, now, fields);
+    if(kind == 3) return on_task_exit(im, now, fields);
+    return on_wakeup(im, now, fields);
+}
+
+/* FUNCTION DESCRIPTION: import_trace
+* Reads the trace line by line and writes the workload, the rows come out as soon as they are sorted
+* The tasks still alive at the end of the trace terminate there
+*/
+void import_trace(struct importer *im, FILE *trace){
+    char *line = NULL;
+    size_t capacity = 0;
+    struct task *task;
+
+    fprintf(im->out, "Pid,Arrival Time,Total CPU Time,I/O Frequency,I/O Duration\n");
+    if(im->map != NULL) fprintf(im->map, "Pid,Trace PID,Command\n");
+    while(getline(&line, &capacity, trace) != -1){
+        im->lines++;
+        if(import_line(im, line) != 0){
+            if(im->malformed++ == 0) fprintf(stderr, "Cannot read the event on line %lld: %s", im->lines, line);
+            continue;
+        }
+        if(im->lines % 4096 == 0) write_rows(im, 0);
+    }
+    free(line);
+
+    while((task = oldest_segment(im)) != NULL){
+        heap_pop(im->segments);
+        task_exit(im, task, im->last_time);
+    }
+    write_rows(im, 1);
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-u us_per_ms] [-b max_bursts] [-w window_s] [-m map.csv] <trace.txt|-> <workload.csv>\n", name);
+    printf("The trace is an ftrace text dump or the output of perf sched script\n");
+}
+
+int main(int argc, char *argv[]){
+    struct importer im;
+    FILE *trace;
+    double window = DEFAULT_WINDOW_S;
+    long long unit = DEFAULT_UNIT_US;
+    char *map = NULL;
+    struct task *task;
+    int opt;
+
+    memset(&im, 0, sizeof(im));
+    im.max_bursts = DEFAULT_MAX_BURSTS;
+    // -u: the trace microseconds that make one simulated ms, -b: the most bursts of a process,
+    // -w: the trace seconds a process spans at most, -m: writes which task each process comes from
+    while((opt = getopt(argc, argv, "u:b:w:m:")) != -1){
+        if(opt == 'u'){
+            unit = atoll(optarg);
+        } else if(opt == 'b'){
+            im.max_bursts = atoi(optarg);
+        } else if(opt == 'w'){
+            window = atof(optarg);
+        } else if(opt == 'm'){
+            map = optarg;
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if(argc - optind != 2 || unit <= 0 || im.max_bursts <= 0 || window <= 0){
+        print_usage(argv[0]);
+        return 2;
+    }
+    im.unit = unit * 1000;
+    im.window = (long long) (window * 1e9);
+
+    trace = (strcmp(argv[optind], "-") == 0) ? stdin : fopen(argv[optind], "r");
+    if(trace == NULL){
+        perror("Cannot open the trace");
+        return 1;
+    }
+    setvbuf(trace, NULL, _IOFBF, READ_BUFFER_SIZE);
+    im.out = fopen(argv[optind + 1], "w");
+    if(im.out == NULL){
+        perror("Cannot write the workload");
+        return 1;
+    }
+    if(map != NULL && (im.map = fopen(map, "w")) == NULL){
+        perror("Cannot write the map");
+        return 1;
+    }
+
+    im.tasks.size = 1024;
+    im.tasks.buckets = (struct task **) calloc(im.tasks.size, sizeof(struct task *));
+    assert(im.tasks.buckets != NULL);
+    im.segments = heap_create(1024);
+    im.rows = heap_create(1024);
+
+    import_trace(&im, trace);
+    fprintf(stderr, "%lld lines, %lld scheduler events (%lld not read), %.3fs of trace\n", im.lines, im.events,
+        im.malformed, (im.last_time - im.first_time) / 1e9);
+    fprintf(stderr, "%d processes written, %lld cut at %d bursts or %gs, at most %d tasks alive\n", im.written,
+        im.cuts, im.max_bursts, window, im.tasks.peak);
+
+    if(trace != stdin) fclose(trace);
+    fclose(im.out);
+    if(im.map != NULL) fclose(im.map);
+    while((task = im.tasks.free_tasks) != NULL){
+        im.tasks.free_tasks = task->next;
+        free(task->cpu_bursts);
+        free(task->io_bursts);
+        free(task);
+    }
+    free(im.tasks.buckets);
+    heap_free(im.segments);
+    heap_free(im.rows);
+    return 0;
+}
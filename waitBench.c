@@ -0,0 +1,169 @@
+/*****************************************************
+* Author:                                            *
+* Alizee Drolet                                      *
+******************************************************
+* Benchmark of the waiting timers. A large number of *
+* processes wait for I/O; every step advances the    *
+* clock to the next expiry and blocks the processes  *
+* that woke up again. The linked list scan the       *
+* simulators used is timed against the timer array   *
+* of waitTimers.h with every instruction set this    *
+* CPU runs.                                          *
+******************************************************/
+
+// Header file for input output functions
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "waitTimers.h"
+
+// A waiting process of the linked list version, like the nodes of the simulators
+struct waiter {
+    int pid;
+    int io_time_remaining;
+    unsigned int seed;
+    struct waiter *next;
+};
+
+// The next I/O duration of a process, the same whatever the order the processes wake up in
+int next_duration(struct waiter *w){
+    w->seed = w->seed * 1103515245 + 12345;
+    return 1 + (w->seed >> 16) % 1000;
+}
+
+double now(void){
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// The processes get their first durations from their PID
+void reset(struct waiter *processes, int n){
+    for(int i = 0; i < n; i++){
+        processes[i].pid = i;
+        processes[i].seed = i + 1;
+        processes[i].io_time_remaining = next_duration(&processes[i]);
+        processes[i].next = NULL;
+    }
+}
+
+/* FUNCTION DESCRIPTION: run_list
+* The loop of the simulators: the waiting list is walked to advance the timers and walked again for the next event
+* The return value is the simulated time, to check that every version did the same work
+*/
+long long run_list(struct waiter *processes, int n, int steps){
+    struct waiter *head = NULL, *node;
+    long long clock = 0;
+    int next_step = 0, next_io;
+
+    // The list is built in PID order, the nodes are scattered like the allocations of the simulators
+    for(int i = n - 1; i >= 0; i--){
+        node = &processes[(long long) i * 7919 % n];
+        node->next = head;
+        head = node;
+    }
+    for(int s = 0; s < steps; s++){
+        clock += next_step;
+        for(node = head; node != NULL; node = node->next){
+            node->io_time_remaining -= next_step;
+            if(node->io_time_remaining <= 0) node->io_time_remaining = next_duration(node);
+        }
+        next_io = INT_MAX;
+        for(node = head; node != NULL; node = node->next){
+            if(node->io_time_remaining < next_io) next_io = node->io_time_remaining;
+        }
+        next_step = next_io;
+    }
+    return clock;
+}
+
+/* FUNCTION DESCRIPTION: run_array
+* The same loop on the timer array, the woken processes block again at the end of the array
+*/
+long long run_array(struct waiter *processes, int n, int steps, enum WAIT_SIMD simd){
+    wait_t waiting = wait_create(n);
+    struct waiter *node;
+    long long clock = 0;
+    sim_time_t next_step = 0;
+
+    waiting->simd = simd;
+    for(int i = 0; i < n; i++){
+        node = &processes[(long long) i * 7919 % n];
+        wait_add(waiting, node, node->io_time_remaining);
+    }
+    for(int s = 0; s < steps; s++){
+        clock += next_step;
+        wait_advance(waiting, next_step);
+        for(int i = 0; i < waiting->expired_count; i++){
+            node = (struct waiter *) waiting->expired[i];
+            wait_add(waiting, node, next_duration(node));
+        }
+        next_step = wait_next(waiting);
+    }
+    wait_free(waiting);
+    return clock;
+}
+
+void print_usage(char *name){
+    printf("Usage: %s [-n waiting processes] [-k steps] [-r repetitions]\n", name);
+}
+
+int main(int argc, char *argv[]){
+    int n = 100000, steps = 500, repetitions = 3, opt;
+    struct waiter *processes;
+    enum WAIT_SIMD best = wait_detect_simd();
+    enum WAIT_SIMD versions[] = { WAIT_SIMD_NONE, WAIT_SIMD_SSE2, WAIT_SIMD_AVX2, WAIT_SIMD_NEON };
+    double start, elapsed, list_time = -1, fastest;
+    long long expected = 0, clock;
+
+    while((opt = getopt(argc, argv, "n:k:r:")) != -1){
+        if(opt == 'n'){
+            n = atoi(optarg);
+        } else if(opt == 'k'){
+            steps = atoi(optarg);
+        } else if(opt == 'r'){
+            repetitions = atoi(optarg);
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if(n <= 0 || steps <= 0 || repetitions <= 0){
+        print_usage(argv[0]);
+        return 2;
+    }
+    processes = (struct waiter *) malloc(n * sizeof(struct waiter));
+    if(processes == NULL){
+        perror("Cannot allocate the processes");
+        return 1;
+    }
+
+    printf("Version,Waiting,Steps,Time (s),ns per timer step,Speedup\n");
+    for(int v = -1; v < (int) (sizeof(versions) / sizeof(versions[0])); v++){
+        // The vector versions this CPU does not run are skipped, SSE2 is always there on x86-64
+        if(v >= 0 && versions[v] != WAIT_SIMD_NONE && versions[v] != best
+            && !(versions[v] == WAIT_SIMD_SSE2 && best == WAIT_SIMD_AVX2)) continue;
+        fastest = -1;
+        for(int r = 0; r < repetitions; r++){
+            reset(processes, n);
+            start = now();
+            clock = (v < 0) ? run_list(processes, n, steps) : run_array(processes, n, steps, versions[v]);
+            elapsed = now() - start;
+            if(fastest < 0 || elapsed < fastest) fastest = elapsed;
+        }
+        if(v < 0){
+            expected = clock;
+            list_time = fastest;
+        } else if(clock != expected){
+            fprintf(stderr, "%s reached %lldms instead of %lldms\n", wait_simd_name(versions[v]), clock, expected);
+            free(processes);
+            return 1;
+        }
+        printf("%s,%d,%d,%.3f,%.2f,%.2fx\n", (v < 0) ? "linked list" : wait_simd_name(versions[v]), n, steps,
+            fastest, fastest * 1e9 / ((double) n * steps), list_time / fastest);
+    }
+    free(processes);
+    return 0;
+}
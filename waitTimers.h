@@ -0,0 +1,250 @@
+/*****************************************************
+* Waiting timers shared by the simulators            *
+******************************************************
+* The I/O timers of the waiting processes are kept   *
+* in a contiguous array, in the order the processes  *
+* started waiting, next to an array of their owners. *
+* Advancing the clock subtracts the step from every  *
+* timer and takes their minimum in the same pass,    *
+* several timers per instruction with SSE2 or AVX2   *
+* on x86-64 and NEON on AArch64, or one at a time    *
+* elsewhere. Only when a timer ran out are the       *
+* arrays compacted to pull the expired owners out.   *
+* The minimum is kept, so the time to the next       *
+* expiry costs no pass over the timers.              *
+******************************************************/
+
+#ifndef WAIT_TIMERS_H
+#define WAIT_TIMERS_H
+
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+#include "simTime.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define WAIT_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WAIT_NEON 1
+#endif
+
+enum WAIT_SIMD {
+    WAIT_SIMD_NONE,
+    WAIT_SIMD_SSE2,
+    WAIT_SIMD_AVX2,
+    WAIT_SIMD_NEON
+};
+
+// owners[i] has remaining[i] ms left to wait, expired holds the owners whose timer ran out at the last advance
+// minimum is the smallest of the remaining timers, INT_MAX when nothing is waiting
+struct wait_timers {
+    int *remaining;
+    void **owners;
+    int count;
+    int capacity;
+    int minimum;
+    void **expired;
+    int expired_count;
+    enum WAIT_SIMD simd;
+};
+
+typedef struct wait_timers *wait_t;
+
+/* FUNCTION DESCRIPTION: wait_sub_min_scalar
+* Subtracts step from the n timers and returns their new minimum, INT_MAX when n is 0
+*/
+static inline int wait_sub_min_scalar(int *remaining, int n, int step){
+    int low = INT_MAX;
+
+    for(int i = 0; i < n; i++){
+        remaining[i] -= step;
+        if(remaining[i] < low) low = remaining[i];
+    }
+    return low;
+}
+
+#ifdef WAIT_X86
+// SSE2 has no 32 bit minimum, it is a compare and a select
+static inline __m128i wait_min_sse2(__m128i a, __m128i b){
+    __m128i greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+}
+
+static inline int wait_sub_min_sse2(int *remaining, int n, int step){
+    __m128i low = _mm_set1_epi32(INT_MAX), by = _mm_set1_epi32(step), v;
+    int i = 0, lanes[4], result;
+
+    for(; i + 4 <= n; i += 4){
+        v = _mm_sub_epi32(_mm_loadu_si128((__m128i *) (remaining + i)), by);
+        _mm_storeu_si128((__m128i *) (remaining + i), v);
+        low = wait_min_sse2(low, v);
+    }
+    low = wait_min_sse2(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+    low = wait_min_sse2(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+    _mm_storeu_si128((__m128i *) lanes, low);
+    result = wait_sub_min_scalar(remaining + i, n - i, step);
+    return (lanes[0] < result) ? lanes[0] : result;
+}
+
+// Compiled for AVX2 whatever the build flags, it only runs when the CPU has it
+__attribute__((target("avx2")))
+static inline int wait_sub_min_avx2(int *remaining, int n, int step){
+    __m256i low = _mm256_set1_epi32(INT_MAX), by = _mm256_set1_epi32(step), v;
+    __m128i half;
+    int i = 0, result;
+
+    for(; i + 8 <= n; i += 8){
+        v = _mm256_sub_epi32(_mm256_loadu_si256((__m256i *) (remaining + i)), by);
+        _mm256_storeu_si256((__m256i *) (remaining + i), v);
+        low = _mm256_min_epi32(low, v);
+    }
+    half = _mm_min_epi32(_mm256_castsi256_si128(low), _mm256_extracti128_si256(low, 1));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_min_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    result = wait_sub_min_scalar(remaining + i, n - i, step);
+    return (_mm_cvtsi128_si32(half) < result) ? _mm_cvtsi128_si32(half) : result;
+}
+#endif
+
+#ifdef WAIT_NEON
+static inline int wait_sub_min_neon(int *remaining, int n, int step){
+    int32x4_t low = vdupq_n_s32(INT_MAX), by = vdupq_n_s32(step), v;
+    int i = 0, result, lane;
+
+    for(; i + 4 <= n; i += 4){
+        v = vsubq_s32(vld1q_s32(remaining + i), by);
+        vst1q_s32(remaining + i, v);
+        low = vminq_s32(low, v);
+    }
+    lane = vminvq_s32(low);
+    result = wait_sub_min_scalar(remaining + i, n - i, step);
+    return (lane < result) ? lane : result;
+}
+#endif
+
+// The widest instructions this CPU runs
+static inline enum WAIT_SIMD wait_detect_simd(void){
+#if defined(WAIT_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? WAIT_SIMD_AVX2 : WAIT_SIMD_SSE2;
+#elif defined(WAIT_NEON)
+    return WAIT_SIMD_NEON;
+#else
+    return WAIT_SIMD_NONE;
+#endif
+}
+
+// The name of the instructions, for the reports
+static inline const char *wait_simd_name(enum WAIT_SIMD simd){
+    static const char *names[] = { "scalar", "sse2", "avx2", "neon" };
+    return names[simd];
+}
+
+/* FUNCTION DESCRIPTION: wait_sub_min
+* Subtracts step from every timer with the instructions selected in w->simd
+* The return value is the smallest timer left, INT_MAX when nothing is waiting
+*/
+static inline int wait_sub_min(wait_t w, int step){
+    switch(w->simd){
+#if defined(WAIT_X86)
+    case WAIT_SIMD_AVX2:
+        return wait_sub_min_avx2(w->remaining, w->count, step);
+    case WAIT_SIMD_SSE2:
+        return wait_sub_min_sse2(w->remaining, w->count, step);
+#elif defined(WAIT_NEON)
+    case WAIT_SIMD_NEON:
+        return wait_sub_min_neon(w->remaining, w->count, step);
+#endif
+    default:
+        return wait_sub_min_scalar(w->remaining, w->count, step);
+    }
+}
+
+/* FUNCTION DESCRIPTION: wait_create
+* This function creates an empty set of timers.
+* The parameters are:
+*    -capacity, the initial number of timers; the arrays grow as needed
+* The return value is a pointer to the new set
+*/
+static inline wait_t wait_create(int capacity){
+    wait_t w = (wait_t) calloc(1, sizeof(struct wait_timers));
+    assert(w != NULL);
+    if(capacity < 16) capacity = 16;
+    w->capacity = capacity;
+    w->remaining = (int *) malloc(capacity * sizeof(int));
+    w->owners = (void **) malloc(capacity * sizeof(void *));
+    w->expired = (void **) malloc(capacity * sizeof(void *));
+    assert(w->remaining != NULL && w->owners != NULL && w->expired != NULL);
+    w->minimum = INT_MAX;
+    w->simd = wait_detect_simd();
+    return w;
+}
+
+/* FUNCTION DESCRIPTION: wait_add
+* Starts the timer of owner, it expires after duration ms
+*/
+static inline void wait_add(wait_t w, void *owner, int duration){
+    if(w->count == w->capacity){
+        w->capacity *= 2;
+        w->remaining = (int *) realloc(w->remaining, w->capacity * sizeof(int));
+        w->owners = (void **) realloc(w->owners, w->capacity * sizeof(void *));
+        w->expired = (void **) realloc(w->expired, w->capacity * sizeof(void *));
+        assert(w->remaining != NULL && w->owners != NULL && w->expired != NULL);
+    }
+    w->remaining[w->count] = duration;
+    w->owners[w->count] = owner;
+    w->count++;
+    if(duration < w->minimum) w->minimum = duration;
+}
+
+/* FUNCTION DESCRIPTION: wait_advance
+* Advances every timer by step ms. The owners whose timer ran out are moved, in the order they
+* started waiting, to w->expired; the others keep their order.
+* The timers are at most INT_MAX ms, so a longer step is cut to INT_MAX and still expires them all
+* The minimum comes from the pass that subtracts the step, or from the compaction when timers expired
+* The return value is the number of expired owners
+*/
+static inline int wait_advance(wait_t w, sim_time_t step){
+    int kept = 0;
+
+    w->expired_count = 0;
+    w->minimum = wait_sub_min(w, (step > INT_MAX) ? INT_MAX : (int) step);
+    if(w->minimum > 0) return 0;
+    w->minimum = INT_MAX;
+    for(int i = 0; i < w->count; i++){
+        if(w->remaining[i] <= 0){
+            w->expired[w->expired_count++] = w->owners[i];
+        } else {
+            w->remaining[kept] = w->remaining[i];
+            w->owners[kept] = w->owners[i];
+            if(w->remaining[i] < w->minimum) w->minimum = w->remaining[i];
+            kept++;
+        }
+    }
+    w->count = kept;
+    return w->expired_count;
+}
+
+/* FUNCTION DESCRIPTION: wait_next
+* The return value is the time until the next timer expires, SIM_TIME_MAX when nothing is waiting
+*/
+static inline sim_time_t wait_next(wait_t w){
+    return (w->count == 0) ? SIM_TIME_MAX : w->minimum;
+}
+
+// The number of running timers
+static inline int wait_count(wait_t w){
+    return w->count;
+}
+
+static inline void wait_free(wait_t w){
+    if(w == NULL) return;
+    free(w->remaining);
+    free(w->owners);
+    free(w->expired);
+    free(w);
+}
+
+#endif
@@ -0,0 +1,452 @@
+/*****************************************************
+* Streaming workload input shared by the simulators  *
+******************************************************
+* Reads the process CSV one row at a time instead of *
+* loading it up front. The rows must be sorted by    *
+* arrival time: the simulators take the rows that    *
+* arrive by the current time plus the next one, so   *
+* only the processes that arrived and did not        *
+* terminate are in memory. The metrics of the        *
+* processes that terminate are folded into a summary *
+* before they are freed.                             *
+* The input is either the CSV or a binary file of    *
+* fixed size rows (see stream_write_binary), rows of *
+* 32 bit integers in KSIMWL01 files and with a 64    *
+* bit PID and arrival time in KSIMWL02 files. When   *
+* pipelined, a parser thread decodes the rows into   *
+* batches and hands them to the simulation through a *
+* single producer single consumer queue; the batches *
+* come back through a second queue to be refilled,   *
+* so the memory stays bounded. The burst sequences   *
+* of a row (see burstPool.h) belong to it until the  *
+* simulation takes it, the rows that are never taken *
+* free them when the stream closes.                  *
+******************************************************/
+
+#ifndef WORKLOAD_STREAM_H
+#define WORKLOAD_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "spscQueue.h"
+#include "burstPool.h"
+#include "simTime.h"
+
+// Binary workloads start with one of these, followed by the rows as 5 native 32 bit integers for the first
+// version, or as the native 64 bit PID and arrival time then 4 native 32 bit integers (the other columns and 0)
+#define STREAM_MAGIC_V1 "KSIMWL01"
+#define STREAM_MAGIC "KSIMWL02"
+#define STREAM_BUFFER_SIZE (1 << 20)
+#define STREAM_LINE_SIZE 4096
+// Rows per batch and batches in flight between the parser and the simulation
+#define STREAM_BATCH_ROWS 4096
+#define STREAM_BATCHES 8
+
+// One row of the input, in the order of the columns
+// io_frequency and io_duration are the first bursts of the sequences, which are only set by CSV rows
+struct workload_row {
+    sim_pid_t pid;
+    sim_time_t arrival_time;
+    int total_cpu_time;
+    int io_frequency;
+    int io_duration;
+    struct burst_seq cpu_bursts;
+    struct burst_seq io_bursts;
+};
+
+// The rows the parser thread decoded, last is set on the batch that ends the input
+struct row_batch {
+    int count;
+    int last;
+    struct workload_row rows[STREAM_BATCH_ROWS];
+};
+
+struct workload_stream {
+    FILE *f;
+    // 0 for a CSV, else the version of the binary format
+    int binary;
+    struct workload_row next;
+    int has_next;
+    long long rows;
+    sim_time_t last_arrival;
+    int unsorted;
+    sim_time_t taken_arrival;
+    // pipelined input: full carries decoded batches to the simulation, empty brings them back
+    int pipelined;
+    pthread_t parser;
+    spsc_t full;
+    spsc_t empty;
+    atomic_int stop;
+    struct row_batch *batches[STREAM_BATCHES];
+    struct row_batch *batch;
+    int batch_position;
+    // statistics
+    long long loaded;
+    long long retired;
+    long long max_live;
+    long long total_turnaround;
+    long long max_turnaround;
+    sim_pid_t max_turnaround_pid;
+    int has_max_turnaround;
+};
+
+typedef struct workload_stream *stream_t;
+
+/* FUNCTION DESCRIPTION: stream_rest_of_line
+* Completes a line that did not fit in the buffer of stream_read_row, long burst sequences can make one
+* The return value is the whole line, which the caller frees
+*/
+static inline char *stream_rest_of_line(FILE *f, const char *start, size_t length){
+    char *rest = NULL, *whole;
+    size_t size = 0;
+    ssize_t n = getline(&rest, &size, f);
+
+    if(n < 0) n = 0;
+    whole = (char *) malloc(length + n + 1);
+    assert(whole != NULL);
+    memcpy(whole, start, length);
+    memcpy(whole + length, rest, n);
+    whole[length + n] = '\0';
+    free(rest);
+    return whole;
+}
+
+/* FUNCTION DESCRIPTION: stream_decode_line
+* Decodes a CSV line into row, see stream_read_row
+* The return value is 1 for a row, 0 for a line that is skipped and -1 for a row with sequences when bursts is not set
+*/
+static inline int stream_decode_line(char *line, int bursts, struct workload_row *row){
+    char *fields[5], *rest;
+    int n = 0;
+
+    if(strlen(line) < 10) return 0;
+    for(char *field = strtok_r(line, ",", &rest); field != NULL && n < 5; field = strtok_r(NULL, ",", &rest)){
+        fields[n++] = field;
+    }
+    if(n < 5) return 0;
+    if(!bursts && (strchr(fields[3], BURST_SEPARATOR) != NULL || strchr(fields[4], BURST_SEPARATOR) != NULL)) return -1;
+    if(sim_parse_columns(fields, &row->pid, &row->arrival_time, &row->total_cpu_time) != 0) return 0;
+    row->io_frequency = burst_parse(fields[3], &row->cpu_bursts);
+    row->io_duration = burst_parse(fields[4], &row->io_bursts);
+    if(sim_check_columns(row->pid, row->arrival_time, row->total_cpu_time, row->io_frequency, row->io_duration) != 0){
+        burst_free(&row->cpu_bursts);
+        burst_free(&row->io_bursts);
+        return 0;
+    }
+    return 1;
+}
+
+/* FUNCTION DESCRIPTION: stream_read_row
+* Decodes the next row of the file. In a CSV, short or incomplete rows are skipped like read_proc_from_file does,
+* and so are the rows with a column out of range (see simTime.h), in any format.
+* The burst sequences of a CSV row are parsed when bursts is set, the caller frees them with the row
+* A CSV line is one row whatever its length, like ks_load_csv reads them
+* The return value is 1 for a row, 0 at the end of the file and -1 for a row with sequences when bursts is not set
+*/
+static inline int stream_read_row(FILE *f, int binary, int bursts, struct workload_row *row){
+    char line[STREAM_LINE_SIZE], *text;
+    size_t length;
+    int32_t values[5];
+    int64_t wide[2];
+    int n;
+
+    row->cpu_bursts.chunk = row->io_bursts.chunk = NULL;
+    row->cpu_bursts.count = row->io_bursts.count = 1;
+    if(binary == 2){
+        while(fread(wide, sizeof(int64_t), 2, f) == 2 && fread(values + 1, sizeof(int32_t), 4, f) == 4){
+            if(sim_check_columns(wide[0], wide[1], values[1], values[2], values[3]) != 0) continue;
+            row->pid = wide[0];
+            row->arrival_time = wide[1];
+            row->total_cpu_time = values[1];
+            row->io_frequency = values[2];
+            row->io_duration = values[3];
+            return 1;
+        }
+        return 0;
+    }
+    if(binary){
+        while(fread(values, sizeof(int32_t), 5, f) == 5){
+            if(sim_check_columns(values[0], values[1], values[2], values[3], values[4]) != 0) continue;
+            row->pid = values[0];
+            row->arrival_time = values[1];
+            row->total_cpu_time = values[2];
+            row->io_frequency = values[3];
+            row->io_duration = values[4];
+            return 1;
+        }
+        return 0;
+    }
+    while(fgets(line, sizeof(line), f) != NULL){
+        // Most lines fit in the buffer, a longer one is completed on the heap instead of being split into rows
+        text = line;
+        length = strlen(line);
+        if(length == sizeof(line) - 1 && line[length - 1] != '\n') text = stream_rest_of_line(f, line, length);
+        n = stream_decode_line(text, bursts, row);
+        if(text != line) free(text);
+        if(n != 0) return n;
+    }
+    return 0;
+}
+
+// The parser thread, it fills the batches the simulation gave back until the input or the stream ends
+static inline void *stream_parse(void *arg){
+    stream_t s = (stream_t) arg;
+    struct row_batch *b;
+    int n;
+
+    do {
+        b = (struct row_batch *) spsc_pop(s->empty);
+        b->count = 0;
+        b->last = atomic_load(&s->stop);
+        while(!b->last && b->count < STREAM_BATCH_ROWS){
+            n = stream_read_row(s->f, s->binary, 1, &b->rows[b->count]);
+            if(n <= 0){
+                b->last = 1;
+                break;
+            }
+            b->count++;
+        }
+        spsc_push(s->full, b);
+    } while(!b->last);
+    // The parser is the only thread adding sequences, the chunk it was filling goes with its last sequence
+    burst_pool_free();
+    return NULL;
+}
+
+// The next decoded row, from the file or from the batches of the parser thread
+static inline int stream_next_row(stream_t s, struct workload_row *row){
+    if(!s->pipelined) return stream_read_row(s->f, s->binary, 1, row) > 0;
+
+    for(;;){
+        if(s->batch != NULL && s->batch_position < s->batch->count){
+            *row = s->batch->rows[s->batch_position++];
+            return 1;
+        }
+        // The last batch stays with the simulation, the parser is done
+        if(s->batch != NULL && s->batch->last) return 0;
+        if(s->batch != NULL) spsc_push(s->empty, s->batch);
+        s->batch = (struct row_batch *) spsc_pop(s->full);
+        s->batch_position = 0;
+    }
+}
+
+// Frees the burst sequences of a row no process was created from
+static inline void stream_free_row(struct workload_row *row){
+    burst_free(&row->cpu_bursts);
+    burst_free(&row->io_bursts);
+}
+
+// Frees the rows of a batch from position on, which the simulation did not take
+static inline void stream_free_batch(struct row_batch *b, int position){
+    for(int i = position; i < b->count; i++) stream_free_row(&b->rows[i]);
+}
+
+/* FUNCTION DESCRIPTION: stream_advance
+* Reads the next row into s->next. A row arriving before the previous one stops the stream,
+* the simulation could not go back in time to let it arrive.
+*/
+static inline void stream_advance(stream_t s){
+    s->has_next = 0;
+    if(s->unsorted || !stream_next_row(s, &s->next)) return;
+    if(s->rows > 0 && s->next.arrival_time < s->last_arrival){
+        fprintf(stderr, "Row %lld arrives at %lldms, before the previous row (%lldms): "
+            "streaming needs the input sorted by arrival time\n", s->rows + 1, s->next.arrival_time, s->last_arrival);
+        stream_free_row(&s->next);
+        s->unsorted = 1;
+        return;
+    }
+    s->last_arrival = s->next.arrival_time;
+    s->rows++;
+    s->has_next = 1;
+}
+
+/* FUNCTION DESCRIPTION: stream_open
+* Opens the process CSV or binary workload and reads its first row
+* The parameters are:
+*    -input_file, the workload
+*    -pipelined, decode the rows on a parser thread
+* The return value is the stream, or NULL if the file cannot be opened
+*/
+static inline stream_t stream_open(const char *input_file, int pipelined){
+    char header[256];
+    size_t magic = strlen(STREAM_MAGIC), got;
+    stream_t s;
+
+    FILE *f = fopen(input_file, "rb");
+    if(f == NULL){
+        perror("Cannot open the input file");
+        return NULL;
+    }
+    s = (stream_t) calloc(1, sizeof(struct workload_stream));
+    assert(s != NULL);
+    s->f = f;
+    setvbuf(f, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+
+    // A binary workload starts with the magic of its version, a CSV with its header row
+    // A file shorter than the magic is a CSV, the bytes past what fread got are not compared
+    got = fread(header, 1, magic, f);
+    if(got == magic && memcmp(header, STREAM_MAGIC, magic) == 0){
+        s->binary = 2;
+    } else if(got == magic && memcmp(header, STREAM_MAGIC_V1, magic) == 0){
+        s->binary = 1;
+    } else {
+        rewind(f);
+        if(fgets(header, sizeof(header), f) == NULL) header[0] = '\0';
+    }
+
+    if(pipelined){
+        s->full = spsc_create(STREAM_BATCHES);
+        s->empty = spsc_create(STREAM_BATCHES);
+        atomic_init(&s->stop, 0);
+        for(int i = 0; i < STREAM_BATCHES; i++){
+            s->batches[i] = (struct row_batch *) malloc(sizeof(struct row_batch));
+            assert(s->batches[i] != NULL);
+            spsc_push(s->empty, s->batches[i]);
+        }
+        s->pipelined = pthread_create(&s->parser, NULL, stream_parse, s) == 0;
+        if(!s->pipelined){
+            // No thread, read the rows on this one
+            for(int i = 0; i < STREAM_BATCHES; i++) free(s->batches[i]);
+            spsc_free(s->full);
+            spsc_free(s->empty);
+        }
+    }
+    stream_advance(s);
+    return s;
+}
+
+// The next row, or NULL once the input is exhausted
+static inline const struct workload_row *stream_peek(stream_t s){
+    return (s != NULL && s->has_next) ? &s->next : NULL;
+}
+
+/* FUNCTION DESCRIPTION: stream_take
+* Takes the next row, the caller creates its process from it
+* The return value is false once the input is exhausted
+*/
+static inline int stream_take(stream_t s, struct workload_row *row){
+    if(!s->has_next) return 0;
+    *row = s->next;
+    s->taken_arrival = row->arrival_time;
+    s->loaded++;
+    if(s->loaded - s->retired > s->max_live) s->max_live = s->loaded - s->retired;
+    stream_advance(s);
+    return 1;
+}
+
+// True when every row was taken, always true without a stream
+static inline int stream_done(stream_t s){
+    return s == NULL || !s->has_next;
+}
+
+/* FUNCTION DESCRIPTION: stream_due
+* True while the simulators must take the next row at time now: it arrives by now, or every row taken so far
+* already arrived and the next arrival must be known to compute the time to the next event
+*/
+static inline int stream_due(stream_t s, sim_time_t now){
+    return stream_peek(s) != NULL && (s->loaded == 0 || s->taken_arrival <= now || s->next.arrival_time <= now);
+}
+
+/* FUNCTION DESCRIPTION: stream_retire
+* Folds the metrics of a terminated process into the summary, the caller frees it afterwards
+*/
+static inline void stream_retire(stream_t s, sim_pid_t pid, sim_time_t arrival_time, sim_time_t finish_time){
+    long long turnaround = finish_time - arrival_time;
+
+    s->retired++;
+    s->total_turnaround += turnaround;
+    if(turnaround > s->max_turnaround || !s->has_max_turnaround){
+        s->max_turnaround = turnaround;
+        s->max_turnaround_pid = pid;
+        s->has_max_turnaround = 1;
+    }
+}
+
+/* FUNCTION DESCRIPTION: stream_print_report
+* Prints how many processes went through and the most that were in memory at once
+*/
+static inline void stream_print_report(stream_t s, FILE *out){
+    if(s == NULL) return;
+    fprintf(out, "Streamed %lld processes, at most %lld in memory at once\n", s->loaded, s->max_live);
+    if(s->unsorted) fprintf(out, "The input stopped after %lld rows, it is not sorted by arrival time\n", s->rows);
+    if(s->retired > 0){
+        fprintf(out, "Mean turnaround %.2fms, maximum %lldms (PID %lld)\n",
+            (double) s->total_turnaround / s->retired, s->max_turnaround, s->max_turnaround_pid);
+    }
+}
+
+/* FUNCTION DESCRIPTION: stream_write_binary
+* Converts a CSV workload to the binary format, which is decoded without any text parsing
+* The rows have fixed size, so a CSV with burst sequences cannot be converted
+* The return value is the number of rows written, or -1 if a file cannot be opened or a row has burst sequences
+*/
+static inline long long stream_write_binary(const char *csv_file, const char *binary_file){
+    struct workload_row row;
+    int64_t wide[2];
+    int32_t fields[4] = { 0, 0, 0, 0 };
+    long long count = 0;
+    char header[256];
+    int n;
+
+    FILE *in = fopen(csv_file, "r");
+    if(in == NULL) return -1;
+    FILE *out = fopen(binary_file, "wb");
+    if(out == NULL){
+        fclose(in);
+        return -1;
+    }
+    if(fgets(header, sizeof(header), in) == NULL) header[0] = '\0';
+    fwrite(STREAM_MAGIC, 1, strlen(STREAM_MAGIC), out);
+    while((n = stream_read_row(in, 0, 0, &row)) > 0){
+        wide[0] = row.pid;
+        wide[1] = row.arrival_time;
+        fields[0] = row.total_cpu_time;
+        fields[1] = row.io_frequency;
+        fields[2] = row.io_duration;
+        fwrite(wide, sizeof(int64_t), 2, out);
+        fwrite(fields, sizeof(int32_t), 4, out);
+        count++;
+    }
+    fclose(in);
+    fclose(out);
+    return (n < 0) ? -1 : count;
+}
+
+/* FUNCTION DESCRIPTION: stream_close
+* Stops the parser thread if there is one, then closes the input and frees the rows that were not taken
+*/
+static inline void stream_close(stream_t s){
+    struct row_batch *b;
+    int position;
+
+    if(s == NULL) return;
+    if(s->has_next) stream_free_row(&s->next);
+    if(s->pipelined){
+        // Give the batches back until the parser sees the stop and sends its last one
+        atomic_store(&s->stop, 1);
+        b = s->batch;
+        position = s->batch_position;
+        while(b == NULL || !b->last){
+            if(b != NULL){
+                stream_free_batch(b, position);
+                spsc_push(s->empty, b);
+            }
+            b = (struct row_batch *) spsc_pop(s->full);
+            position = 0;
+        }
+        stream_free_batch(b, position);
+        pthread_join(s->parser, NULL);
+        for(int i = 0; i < STREAM_BATCHES; i++) free(s->batches[i]);
+        spsc_free(s->full);
+        spsc_free(s->empty);
+    }
+    burst_pool_free();
+    fclose(s->f);
+    free(s);
+}
+
+#endif